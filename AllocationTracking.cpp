@@ -0,0 +1,62 @@
+#include "TransportCore.h"
+
+#include <cstdlib>
+#include <new>
+
+// Замена глобальных операторов new/delete для AllocationTracker: размер блока хранится в заголовке.
+// Файл не входит в библиотеку kursach_core и подключается только к исполняемому файлу
+// (объектная библиотека kursach_alloc_tracking), чтобы библиотека не меняла аллокатор программы
+
+// Выполняется при статической инициализации, до запросов к счетчикам
+[[maybe_unused]] static const bool trackingInstalled = (AllocationTracker::markInstalled(), true);
+
+void* operator new(std::size_t size) {
+    void* block = std::malloc(size + AllocationTracker::HEADER_SIZE);
+    if (!block) throw std::bad_alloc();
+    *static_cast<std::size_t*>(block) = size;
+    AllocationTracker::onAllocate(size);
+    return static_cast<char*>(block) + AllocationTracker::HEADER_SIZE;
+}
+
+void* operator new[](std::size_t size) {
+    return operator new(size);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+    try {
+        return operator new(size);
+    } catch (const std::bad_alloc&) {
+        return nullptr;
+    }
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t& tag) noexcept {
+    return operator new(size, tag);
+}
+
+void operator delete(void* ptr) noexcept {
+    if (!ptr) return;
+    char* block = static_cast<char*>(ptr) - AllocationTracker::HEADER_SIZE;
+    AllocationTracker::onDeallocate(*reinterpret_cast<std::size_t*>(block));
+    std::free(block);
+}
+
+void operator delete[](void* ptr) noexcept {
+    operator delete(ptr);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept {
+    operator delete(ptr);
+}
+
+void operator delete[](void* ptr, std::size_t) noexcept {
+    operator delete(ptr);
+}
+
+void operator delete(void* ptr, const std::nothrow_t&) noexcept {
+    operator delete(ptr);
+}
+
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept {
+    operator delete(ptr);
+}
@@ -0,0 +1,1056 @@
+#include "TransportCore.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+
+// Реализация Trip::deserialize после определения TransportSystem
+std::shared_ptr<Trip> Trip::deserialize(const std::string& data, TransportSystem* system) {
+    std::istringstream ss(data);
+    std::string token;
+    std::vector<std::string> tokens;
+
+    while (std::getline(ss, token, '|')) {
+        tokens.push_back(token);
+    }
+
+    // Поля маршрута, транспорта и водителя сами разделены '|':
+    // id | номер|тип|остановки | тип|модель|номер ТС | имя|фамилия|отчество | отправление | расписание [| календарь]
+    if (tokens.size() < 11) {
+        throw TransportException("Некорректные данные рейса");
+    }
+    if (!system) {
+        throw TransportException("Для загрузки рейса нужна транспортная система");
+    }
+
+    int tripId = std::stoi(tokens[0]);
+
+    // Маршрут, транспорт и водитель берутся из уже загруженных данных
+    auto route = system->findRouteByNumber(std::stoi(tokens[1]));
+    if (!route) {
+        throw TransportException("Маршрут " + tokens[1] + " не найден в системе");
+    }
+
+    auto vehicle = system->findVehicleByLicensePlate(tokens[6]);
+    if (!vehicle) {
+        throw TransportException("Транспортное средство не найдено в системе");
+    }
+
+    auto driver = system->findDriverByName(tokens[7], tokens[8], tokens[9]);
+    if (!driver) {
+        throw TransportException("Водитель " + tokens[8] + " " + tokens[7] + " не найден в системе");
+    }
+
+    Time startTime = Time::deserialize(tokens[10]);
+    auto trip = makePooled<Trip>(tripId, route, vehicle, driver, startTime);
+
+    // Десериализация расписания
+    if (tokens.size() > 11 && !tokens[11].empty()) {
+        // Записи идут в порядке маршрута, поэтому позиция ищется после предыдущей
+        // (повторные остановки кольцевых маршрутов не сливаются)
+        const auto& stops = route->getAllStops();
+        std::vector<int> offsets(stops.size(), TripPattern::NO_STOP);
+        std::size_t cursor = 0;
+        std::istringstream scheduleStream(tokens[11]);
+        std::string scheduleItem;
+        while (std::getline(scheduleStream, scheduleItem, ';')) {
+            size_t eqPos = scheduleItem.find('=');
+            if (eqPos != std::string::npos) {
+                std::string stop = scheduleItem.substr(0, eqPos);
+                Time time = Time::deserialize(scheduleItem.substr(eqPos + 1));
+                auto found = std::find(stops.begin() + cursor, stops.end(), stop);
+                if (found == stops.end()) {
+                    found = std::find(stops.begin(), stops.end(), stop);
+                }
+                if (found == stops.end()) {
+                    throw TransportException("Остановка '" + stop + "' не входит в маршрут рейса");
+                }
+                cursor = static_cast<std::size_t>(found - stops.begin());
+                offsets[cursor++] = trip->offsetOf(time);
+            }
+        }
+        trip->setArrivalOffsets(std::move(offsets));
+    }
+
+    if (tokens.size() > 12) {
+        trip->setCalendarId(std::stoi(tokens[12]));
+    }
+
+    return trip;
+}
+
+std::shared_ptr<TripTemplate> TripTemplate::deserialize(const std::string& data, const TransportSystem& system) {
+    std::istringstream ss(data);
+    std::string token;
+    std::vector<std::string> tokens;
+
+    while (std::getline(ss, token, '|')) {
+        tokens.push_back(token);
+    }
+
+    if (tokens.size() != 8 && tokens.size() != 9) {
+        throw TransportException("Некорректные данные шаблона рейсов");
+    }
+
+    auto route = system.findRouteByNumber(std::stoi(tokens[1]));
+    if (!route) {
+        throw TransportException("Маршрут " + tokens[1] + " не найден");
+    }
+
+    std::vector<int> offsets;
+    std::istringstream offsetsStream(tokens[5]);
+    while (std::getline(offsetsStream, token, ';')) {
+        offsets.push_back(std::stoi(token));
+    }
+
+    std::vector<std::shared_ptr<Vehicle>> vehiclePool;
+    std::istringstream vehiclesStream(tokens[6]);
+    while (std::getline(vehiclesStream, token, ';')) {
+        auto vehicle = system.findVehicleByLicensePlate(token);
+        if (!vehicle) {
+            throw TransportException("Транспортное средство " + token + " не найдено в системе");
+        }
+        vehiclePool.push_back(std::move(vehicle));
+    }
+
+    std::vector<std::shared_ptr<Driver>> driverPool;
+    std::istringstream driversStream(tokens[7]);
+    while (std::getline(driversStream, token, ';')) {
+        std::istringstream nameStream(token);
+        std::string firstName, lastName, middleName;
+        std::getline(nameStream, firstName, ',');
+        std::getline(nameStream, lastName, ',');
+        std::getline(nameStream, middleName);
+        auto driver = system.findDriverByName(firstName, lastName, middleName);
+        if (!driver) {
+            throw TransportException("Водитель " + lastName + " " + firstName + " не найден в системе");
+        }
+        driverPool.push_back(std::move(driver));
+    }
+
+    auto pattern = makePooled<TripTemplate>(std::stoi(tokens[0]), route, Time::deserialize(tokens[2]),
+                                            Time::deserialize(tokens[3]), std::stoi(tokens[4]), std::move(offsets),
+                                            std::move(vehiclePool), std::move(driverPool));
+    if (tokens.size() == 9) {
+        pattern->setCalendarId(std::stoi(tokens[8]));
+    }
+    return pattern;
+}
+
+// Реализация LiveEventSource
+#ifdef _WIN32
+LiveEventSource::LiveEventSource(const std::string& path) {
+    // Клиент канала открывается сразу: если сервер канала не создан, открытие завершается ошибкой
+    HANDLE opened = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE,
+                                nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (opened == INVALID_HANDLE_VALUE) {
+        throw TransportException("Не удалось открыть источник событий: " + path);
+    }
+    handle = opened;
+    isPipe = GetFileType(opened) == FILE_TYPE_PIPE;
+}
+
+LiveEventSource::~LiveEventSource() {
+    CloseHandle(static_cast<HANDLE>(handle));
+}
+
+// ReadFile на канале блокируется до прихода данных, поэтому сначала проверяется PeekNamedPipe
+bool LiveEventSource::fill(int timeoutMs) {
+    char chunk[64 * 1024];
+    DWORD toRead = sizeof(chunk);
+    if (isPipe) {
+        DWORD available = 0;
+        for (int waited = 0;; waited += 10) {
+            if (!PeekNamedPipe(static_cast<HANDLE>(handle), nullptr, 0, nullptr, &available, nullptr)) {
+                endOfInput = true; // писатель закрыл канал
+                return true;
+            }
+            if (available > 0) break;
+            if (waited >= timeoutMs) return false;
+            Sleep(10);
+        }
+        toRead = std::min<DWORD>(available, toRead);
+    }
+    DWORD received = 0;
+    if (!ReadFile(static_cast<HANDLE>(handle), chunk, toRead, &received, nullptr) || received == 0) {
+        endOfInput = true;
+        return true;
+    }
+    buffer.append(chunk, received);
+    return true;
+}
+#else
+LiveEventSource::LiveEventSource(const std::string& path) {
+    // O_NONBLOCK: открытие канала на чтение не ждет появления писателя
+    fd = ::open(path.c_str(), O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+    if (fd < 0) {
+        throw TransportException("Не удалось открыть источник событий: " + path);
+    }
+}
+
+LiveEventSource::~LiveEventSource() {
+    ::close(fd);
+}
+
+// Канал без писателя (еще не подключился) не готов к чтению, закрытый писателем - дает конец ввода
+bool LiveEventSource::fill(int timeoutMs) {
+    pollfd request{fd, POLLIN, 0};
+    int ready = ::poll(&request, 1, timeoutMs);
+    if (ready < 0 && errno != EINTR) {
+        endOfInput = true;
+        return true;
+    }
+    if (ready <= 0) return false;
+
+    char chunk[64 * 1024];
+    ssize_t received = ::read(fd, chunk, sizeof(chunk));
+    if (received < 0) {
+        if (errno == EAGAIN || errno == EINTR) return false;
+        endOfInput = true;
+        return true;
+    }
+    if (received == 0) {
+        endOfInput = true;
+        return true;
+    }
+    buffer.append(chunk, static_cast<std::size_t>(received));
+    return true;
+}
+#endif
+
+LiveEventSource::Status LiveEventSource::next(std::string& line, int timeoutMs) {
+    while (true) {
+        std::size_t newline = buffer.find('\n', scanned);
+        if (newline != std::string::npos) {
+            line.assign(buffer, consumed, newline - consumed);
+            consumed = scanned = newline + 1;
+            return Status::Line;
+        }
+        if (endOfInput) {
+            if (consumed == buffer.size()) return Status::End;
+            line.assign(buffer, consumed); // последняя строка без перевода строки
+            consumed = scanned = buffer.size();
+            return Status::Line;
+        }
+        // Прочитанные строки удаляются из буфера один раз перед дочитыванием
+        buffer.erase(0, consumed);
+        consumed = 0;
+        scanned = buffer.size();
+        if (!fill(timeoutMs)) return Status::Timeout;
+    }
+}
+
+// Реализация методов DataManager
+void DataManager::saveAllData(TransportSystem& system) {
+    try {
+        *output << "Сохранение данных в текстовые файлы...\n";
+
+        saveStops(system);
+        saveVehicles(system);
+        saveDrivers(system);
+        saveRoutes(system);
+        saveCalendars(system);
+        saveTrips(system);
+        saveTripTemplates(system);
+        saveFootpaths(system);
+        saveTripLoading(system);
+        saveAdminCredentials(system);
+        saveIndexCache(system, hashSourceFiles());
+
+        *output << "Данные успешно сохранены!\n";
+    } catch (const std::exception& e) {
+        *output << "Ошибка при сохранении данных: " << e.what() << "\n";
+    }
+}
+
+bool DataManager::loadAllData(TransportSystem& system) {
+    try {
+        *output << "Загрузка данных из текстовых файлов...\n";
+
+        loadTripLoading(system);
+
+        // Файлы без зависимостей и кэш индексов читаются и разбираются одновременно,
+        // регистрация идет в одном потоке в порядке зависимостей
+        auto cache = std::async(std::launch::async, [this] { return readIndexCache(); });
+        auto stops = std::async(std::launch::async, [this] { return parseFile("stops.txt", Stop::deserialize); });
+        auto vehicles = std::async(std::launch::async, [this] { return parseFile("vehicles.txt", parseVehicle); });
+        auto drivers = std::async(std::launch::async, [this] { return parseFile("drivers.txt", Driver::deserialize); });
+        auto routes = std::async(std::launch::async, [this] { return parseFile("routes.txt", Route::deserialize); });
+        auto calendars = std::async(std::launch::async, [this] {
+            return parseFile("calendars.txt", ServiceCalendar::deserialize);
+        });
+        auto footpaths = std::async(std::launch::async, [this] { return parseFile("footpaths.txt", parseFootpath); });
+        auto credentials = std::async(std::launch::async, [this] {
+            return parseFile("admins.txt", parseAdminCredentials);
+        });
+
+        loadStops(system, stops.get());
+        loadVehicles(system, vehicles.get());
+        loadDrivers(system, drivers.get());
+        loadRoutes(system, routes.get());
+        loadCalendars(system, calendars.get());
+
+        // Рейсы и шаблоны ссылаются на уже зарегистрированные маршруты, транспорт и водителей
+        DerivedIndexCache indexes = cache.get();
+        bool tripIndexesCached = loadTrips(system, indexes);
+        loadTripTemplates(system);
+        loadFootpaths(system, footpaths.get());
+        loadAdminCredentials(system, credentials.get());
+
+        bool footpathsCached = system.hasExplicitFootpaths() || indexes.footpaths;
+        if (indexes.footpaths) {
+            system.restoreDerivedFootpaths(std::move(*indexes.footpaths));
+        }
+        if (tripIndexesCached && footpathsCached) {
+            *output << "Индексы загружены из кэша\n";
+        } else {
+            saveIndexCache(system, indexes.sourceHash);
+        }
+
+        *output << "Данные успешно загружены!\n";
+        return true;
+    } catch (const std::exception& e) {
+        *output << "Ошибка при загрузке данных: " << e.what() << "\n";
+        *output << "Используются тестовые данные.\n";
+        return false;
+    }
+}
+
+void DataManager::saveStops(TransportSystem& system) {
+    std::ofstream file(dataDirectory + "stops.txt");
+    if (!file.is_open()) throw TransportException("Не удалось открыть файл stops.txt");
+
+    const auto& stops = system.getStops();
+    for (const auto& stop : stops) {
+        file << stop.serialize() << "\n";
+    }
+    file.close();
+}
+
+void DataManager::saveVehicles(TransportSystem& system) {
+    std::ofstream file(dataDirectory + "vehicles.txt");
+    if (!file.is_open()) throw TransportException("Не удалось открыть файл vehicles.txt");
+
+    const auto& vehicles = system.getVehicles();
+    for (const auto& vehicle : vehicles) {
+        file << vehicle->serialize() << "\n";
+    }
+    file.close();
+}
+
+void DataManager::saveDrivers(TransportSystem& system) {
+    std::ofstream file(dataDirectory + "drivers.txt");
+    if (!file.is_open()) throw TransportException("Не удалось открыть файл drivers.txt");
+
+    const auto& drivers = system.getDrivers();
+    for (const auto& driver : drivers) {
+        file << driver->serialize() << "\n";
+    }
+    file.close();
+}
+
+void DataManager::saveRoutes(TransportSystem& system) {
+    std::ofstream file(dataDirectory + "routes.txt");
+    if (!file.is_open()) throw TransportException("Не удалось открыть файл routes.txt");
+
+    const auto& routes = system.getRoutes();
+    for (const auto& route : routes) {
+        file << route->serialize() << "\n";
+    }
+    file.close();
+}
+
+void DataManager::saveCalendars(TransportSystem& system) {
+    std::ofstream file(dataDirectory + "calendars.txt");
+    if (!file.is_open()) throw TransportException("Не удалось открыть файл calendars.txt");
+
+    for (const auto& [id, calendar] : system.getCalendars()) {
+        file << calendar.serialize() << "\n";
+    }
+    file.close();
+}
+
+// При загрузке по требованию незагруженные рейсы переписываются из прежнего файла без разбора,
+// поэтому новый файл пишется рядом и заменяет прежний после записи
+void DataManager::saveTrips(TransportSystem& system) {
+    const LazyTripStore* lazyTrips = system.getLazyTrips();
+    std::string path = dataDirectory + "trips.txt";
+    std::ofstream file(lazyTrips ? path + ".tmp" : path);
+    if (!file.is_open()) throw TransportException("Не удалось открыть файл trips.txt");
+
+    const auto& trips = system.getTrips();
+    for (const auto& trip : trips) {
+        file << trip->serialize() << "\n";
+    }
+    if (lazyTrips) {
+        lazyTrips->copyPendingLines(file);
+    }
+    file.close();
+
+    if (lazyTrips) {
+        std::filesystem::rename(path + ".tmp", path);
+        system.reindexLazyTrips(path);
+    }
+}
+
+void DataManager::saveTripTemplates(TransportSystem& system) {
+    std::ofstream file(dataDirectory + "templates.txt");
+    if (!file.is_open()) throw TransportException("Не удалось открыть файл templates.txt");
+
+    for (const auto& pattern : system.getTripTemplates()) {
+        file << pattern->serialize() << "\n";
+    }
+    file.close();
+}
+
+// Сохраняются только переходы из файла: построенные по координатам пересчитываются при загрузке
+void DataManager::saveFootpaths(TransportSystem& system) {
+    if (!system.hasExplicitFootpaths()) return;
+
+    std::ofstream file(dataDirectory + "footpaths.txt");
+    if (!file.is_open()) throw TransportException("Не удалось открыть файл footpaths.txt");
+
+    for (const auto& footpath : system.getFootpaths().getFootpaths()) {
+        if (footpath.from < footpath.to) {
+            file << footpath.from << "|" << footpath.to << "|" << footpath.minutes << "\n";
+        }
+    }
+    file.close();
+}
+
+void DataManager::saveTripLoading(TransportSystem& system) {
+    std::ofstream file(dataDirectory + "loading.txt");
+    if (!file.is_open()) throw TransportException("Не удалось открыть файл loading.txt");
+
+    const TripLoadingOptions& options = system.getTripLoadingOptions();
+    file << (options.onDemand ? 1 : 0) << "|" << options.memoryLimit / (1024 * 1024) << "\n";
+    file.close();
+}
+
+void DataManager::saveAdminCredentials(TransportSystem& system) {
+    std::ofstream file(dataDirectory + "admins.txt");
+    if (!file.is_open()) throw TransportException("Не удалось открыть файл admins.txt");
+
+    file << "admin|admin123\n";
+    file << "manager|manager123\n";
+    file.close();
+}
+
+void DataManager::loadStops(TransportSystem& system, ParsedFile<Stop> stops) {
+    for (auto& stop : stops) {
+        system.addStop(stop.take());
+    }
+}
+
+std::shared_ptr<Vehicle> DataManager::parseVehicle(const std::string& line) {
+    std::istringstream ss(line);
+    std::string type, model, licensePlate;
+    std::getline(ss, type, '|');
+    std::getline(ss, model, '|');
+    std::getline(ss, licensePlate);
+
+    if (type == "Автобус") {
+        return makePooled<Bus>(model, licensePlate);
+    } else if (type == "Трамвай") {
+        return makePooled<Tram>(model, licensePlate);
+    } else if (type == "Троллейбус") {
+        return makePooled<Trolleybus>(model, licensePlate);
+    }
+    throw TransportException("Неизвестный тип транспорта: " + type);
+}
+
+void DataManager::loadVehicles(TransportSystem& system, ParsedFile<std::shared_ptr<Vehicle>> vehicles) {
+    for (auto& vehicle : vehicles) {
+        try {
+            system.addVehicle(vehicle.take());
+        } catch (const std::exception& e) {
+            *output << "Ошибка загрузки транспортного средства: " << e.what() << "\n";
+        }
+    }
+}
+
+void DataManager::loadDrivers(TransportSystem& system, ParsedFile<std::shared_ptr<Driver>> drivers) {
+    for (auto& driver : drivers) {
+        system.addDriver(driver.take());
+    }
+}
+
+void DataManager::loadRoutes(TransportSystem& system, ParsedFile<std::shared_ptr<Route>> routes) {
+    for (auto& route : routes) {
+        try {
+            system.addRoute(route.take());
+        } catch (const std::exception& e) {
+            *output << "Ошибка загрузки маршрута: " << e.what() << "\n";
+        }
+    }
+}
+
+void DataManager::loadCalendars(TransportSystem& system, ParsedFile<ServiceCalendar> calendars) {
+    for (auto& calendar : calendars) {
+        try {
+            system.addServiceCalendar(calendar.take());
+        } catch (const std::exception& e) {
+            *output << "Ошибка загрузки календаря: " << e.what() << "\n";
+        }
+    }
+}
+
+// Самый большой файл: строки разбираются по частям параллельно, рейсы регистрируются по порядку
+// Возвращает true, если индекс рейсов (расписание по остановкам или индекс строк файла) взят из кэша
+bool DataManager::loadTrips(TransportSystem& system, DerivedIndexCache& indexes) {
+    if (!std::filesystem::exists(dataDirectory + "trips.txt")) return indexes.stopTimetable.has_value();
+
+    // По требованию рейсы читаются при первом обращении к их маршрутам
+    if (system.getTripLoadingOptions().onDemand) {
+        bool cached = indexes.lazyTrips != nullptr;
+        system.enableLazyTrips(dataDirectory + "trips.txt", std::move(indexes.lazyTrips));
+        *output << "Рейсы загружаются по требованию (маршрутов в индексе: "
+                  << system.getLazyTrips()->getRouteCount() << ")\n";
+        return cached;
+    }
+
+    if (indexes.stopTimetable) {
+        system.deferStopTimetable();
+    }
+    try {
+        if (indexes.trips) {
+            // Файл не менялся с записи кэша: рейсы восстанавливаются без разбора строк.
+            // Строки с ошибками в кэш не попали, сообщения о них выводятся только при разборе
+            for (const CachedTrip& cached : *indexes.trips) {
+                try {
+                    system.addTrip(restoreTrip(cached, system));
+                } catch (const std::exception& e) {
+                    *output << "Ошибка загрузки рейса: " << e.what() << "\n";
+                }
+            }
+        } else {
+            auto trips = parseFile("trips.txt", [&system](const std::string& line) {
+                return Trip::deserialize(line, &system);
+            });
+            for (auto& trip : trips) {
+                try {
+                    system.addTrip(trip.take());
+                } catch (const std::exception& e) {
+                    *output << "Ошибка загрузки рейса: " << e.what() << "\n";
+                }
+            }
+        }
+    } catch (...) {
+        system.restoreStopTimetable(std::nullopt);
+        throw;
+    }
+    return system.restoreStopTimetable(std::move(indexes.stopTimetable));
+}
+
+// Строки нового файла сопоставляются с сериализованными рейсами системы. Рейс, изменявшийся
+// после загрузки, тоже перечитывается: источником считается файл
+DataManager::TripReloadCounts DataManager::reloadTrips(TransportSystem& system) {
+    auto lines = parseFile("trips.txt", [](const std::string& line) { return line; });
+    std::unordered_map<std::string_view, std::size_t> lineIndex;
+    lineIndex.reserve(lines.size());
+    for (std::size_t i = 0; i < lines.size(); ++i) {
+        lineIndex.emplace(*lines[i].value, i);
+    }
+
+    TripReloadCounts counts;
+    std::vector<bool> unchanged(lines.size(), false);
+    std::unordered_set<int> stale; // рейсы, строк которых в файле больше нет
+    for (const auto& trip : system.getTrips()) {
+        auto it = lineIndex.find(trip->serialize());
+        if (it != lineIndex.end() && !unchanged[it->second]) {
+            unchanged[it->second] = true;
+            ++counts.kept;
+        } else {
+            stale.insert(trip->getTripId());
+        }
+    }
+
+    // Новые строки разбираются до каких-либо изменений. Рейс, строка которого не разобрана,
+    // остается прежним, чтобы ошибка в файле не удалила его
+    std::vector<std::shared_ptr<Trip>> parsed;
+    for (std::size_t i = 0; i < lines.size(); ++i) {
+        if (unchanged[i]) continue;
+        const std::string& line = *lines[i].value;
+        try {
+            parsed.push_back(Trip::deserialize(line, &system));
+        } catch (const std::exception& e) {
+            *output << "Ошибка загрузки рейса: " << e.what() << "\n";
+            try {
+                if (stale.erase(std::stoi(line.substr(0, line.find('|'))))) {
+                    *output << "Рейс " << line.substr(0, line.find('|')) << " оставлен без изменений\n";
+                }
+            } catch (const std::exception&) {
+            }
+        }
+    }
+
+    // Рейсы, удаленные из файла без замены, снимаются сразу: это не может завершиться ошибкой
+    std::vector<int> removed;
+    std::unordered_set<int> replaced;
+    for (const auto& trip : parsed) {
+        if (stale.count(trip->getTripId())) replaced.insert(trip->getTripId());
+    }
+    for (int tripId : stale) {
+        if (!replaced.count(tripId)) removed.push_back(tripId);
+    }
+    counts.removed = system.removeTrips(removed);
+
+    // Замены и новые рейсы применяются одним пакетом: пакет проверяется целиком до изменений.
+    // Если он отклонен, каждый рейс заменяется своим пакетом, и при ошибке прежний рейс остается
+    TimetableBatch batch;
+    for (const auto& trip : parsed) {
+        if (replaced.count(trip->getTripId())) batch.removeTrip(trip->getTripId());
+        batch.addTrip(trip);
+    }
+    try {
+        TimetableBatchResult result = system.commit(batch);
+        counts.removed += result.tripsRemoved;
+        counts.added = result.tripsAdded;
+        return counts;
+    } catch (const std::exception&) {
+        batch.clear();
+    }
+
+    for (const auto& trip : parsed) {
+        bool replacing = replaced.erase(trip->getTripId()) > 0;
+        if (replacing) batch.removeTrip(trip->getTripId());
+        batch.addTrip(trip);
+        try {
+            TimetableBatchResult result = system.commit(batch);
+            counts.removed += result.tripsRemoved;
+            counts.added += result.tripsAdded;
+        } catch (const std::exception& e) {
+            batch.clear();
+            *output << "Ошибка загрузки рейса: " << e.what() << "\n";
+            if (replacing) {
+                *output << "Рейс " << trip->getTripId() << " оставлен без изменений\n";
+            }
+        }
+    }
+    return counts;
+}
+
+// Хеш содержимого исходных файлов: FNV-1a по 8-байтовым словам. Отсутствующий файл
+// отличается от пустого
+std::uint64_t DataManager::hashSourceFiles() const {
+    std::uint64_t hash = 14695981039346656037ull;
+    auto mix = [&hash](std::uint64_t word) { hash = (hash ^ word) * 1099511628211ull; };
+    std::vector<char> buffer(1 << 20);
+    for (const char* name : SOURCE_FILES) {
+        std::ifstream file(dataDirectory + name, std::ios::binary);
+        mix(file.is_open() ? 1 : 0);
+        std::uint64_t size = 0;
+        while (file.read(buffer.data(), static_cast<std::streamsize>(buffer.size())) || file.gcount() > 0) {
+            std::size_t count = static_cast<std::size_t>(file.gcount());
+            for (std::size_t i = 0; i < count; i += sizeof(std::uint64_t)) {
+                std::uint64_t word = 0;
+                std::memcpy(&word, buffer.data() + i, std::min(sizeof(word), count - i));
+                mix(word);
+            }
+            size += count;
+        }
+        mix(size);
+    }
+    return hash;
+}
+
+// Разделы кэша берутся, только если совпал хеш исходных файлов. Испорченный кэш
+// считается отсутствующим: индексы строятся заново и кэш перезаписывается
+DerivedIndexCache DataManager::readIndexCache() const {
+    DerivedIndexCache cache;
+    cache.sourceHash = hashSourceFiles();
+    std::string path = dataDirectory + "index.cache";
+    if (!std::filesystem::exists(path)) return cache;
+
+    try {
+        BinaryReader in(path);
+        if (in.value<std::uint32_t>() != INDEX_CACHE_MAGIC || in.value<std::uint32_t>() != INDEX_CACHE_VERSION ||
+            in.value<std::uint64_t>() != cache.sourceHash) {
+            return cache;
+        }
+
+        DerivedIndexCache result;
+        result.sourceHash = cache.sourceHash;
+        auto sections = in.value<std::uint8_t>();
+        if (sections & CACHE_TRIPS) {
+            auto count = in.value<std::uint64_t>();
+            result.trips.emplace();
+            for (std::uint64_t i = 0; i < count; ++i) {
+                result.trips->push_back(CachedTrip::read(in));
+            }
+        }
+        if (sections & CACHE_STOP_TIMETABLE) {
+            result.stopTimetable = StopTimetableIndex::read(in);
+        }
+        if (sections & CACHE_FOOTPATHS) {
+            result.footpaths = FootpathGraph::read(in);
+        }
+        if (sections & CACHE_LAZY_TRIPS) {
+            result.lazyTrips = std::make_unique<LazyTripStore>();
+            result.lazyTrips->readIndex(in, dataDirectory + "trips.txt");
+        }
+        if (!in.atEnd()) {
+            throw TransportException("Кэш индексов поврежден");
+        }
+        return result;
+    } catch (const std::exception&) {
+        return cache;
+    }
+}
+
+// Кэш пишется во временный файл и заменяет старый только целиком.
+// Ошибка записи не мешает работе: индексы будут построены при следующем запуске
+void DataManager::saveIndexCache(TransportSystem& system, std::uint64_t sourceHash) {
+    std::string path = dataDirectory + "index.cache";
+    try {
+        const LazyTripStore* lazyTrips = system.getLazyTrips();
+        std::uint8_t sections = lazyTrips ? CACHE_LAZY_TRIPS : CACHE_TRIPS | CACHE_STOP_TIMETABLE;
+        if (!system.hasExplicitFootpaths()) {
+            sections |= CACHE_FOOTPATHS;
+        }
+
+        BinaryWriter out(path + ".tmp");
+        out.value(INDEX_CACHE_MAGIC);
+        out.value(INDEX_CACHE_VERSION);
+        out.value(sourceHash);
+        out.value(sections);
+        if (sections & CACHE_TRIPS) {
+            const auto& trips = system.getTrips();
+            out.value<std::uint64_t>(trips.size());
+            for (const auto& trip : trips) {
+                CachedTrip::of(*trip).write(out);
+            }
+        }
+        if (sections & CACHE_STOP_TIMETABLE) {
+            system.writeStopTimetable(out);
+        }
+        if (sections & CACHE_FOOTPATHS) {
+            system.getFootpaths().write(out);
+        }
+        if (lazyTrips) {
+            lazyTrips->writeIndex(out);
+        }
+        out.close();
+        std::filesystem::rename(path + ".tmp", path);
+    } catch (const std::exception& e) {
+        *output << "Не удалось записать кэш индексов: " << e.what() << "\n";
+    }
+}
+
+// Ссылки разрешаются так же, как при разборе строки (Trip::deserialize)
+std::shared_ptr<Trip> DataManager::restoreTrip(const CachedTrip& cached, TransportSystem& system) {
+    auto route = system.findRouteByNumber(cached.routeNumber);
+    if (!route) {
+        throw TransportException("Маршрут " + std::to_string(cached.routeNumber) + " не найден в системе");
+    }
+    auto vehicle = system.findVehicleByLicensePlate(cached.licensePlate);
+    if (!vehicle) {
+        throw TransportException("Транспортное средство не найдено в системе");
+    }
+    auto driver = system.findDriverByName(cached.firstName, cached.lastName, cached.middleName);
+    if (!driver) {
+        throw TransportException("Водитель " + cached.lastName + " " + cached.firstName + " не найден в системе");
+    }
+
+    auto trip = makePooled<Trip>(cached.tripId, route, vehicle, driver,
+                                 Time(cached.startMinutes / 60, cached.startMinutes % 60));
+    if (!cached.offsets.empty()) {
+        trip->setArrivalOffsets(cached.offsets);
+    }
+    trip->setCalendarId(cached.calendarId);
+    return trip;
+}
+
+void DataManager::loadTripTemplates(TransportSystem& system) {
+    auto templates = parseFile("templates.txt", [&system](const std::string& line) {
+        return TripTemplate::deserialize(line, system);
+    });
+    for (auto& pattern : templates) {
+        try {
+            system.addTripTemplate(pattern.take());
+        } catch (const std::exception& e) {
+            *output << "Ошибка загрузки шаблона рейсов: " << e.what() << "\n";
+        }
+    }
+}
+
+// Формат строки: остановка|остановка|минуты. Без файла или без единого перехода в нем
+// переходы строятся по координатам
+FootpathGraph::Footpath DataManager::parseFootpath(const std::string& line) {
+    std::istringstream ss(line);
+    std::string from, to, minutes;
+    std::getline(ss, from, '|');
+    std::getline(ss, to, '|');
+    std::getline(ss, minutes);
+    return {from, to, std::stoi(minutes)};
+}
+
+void DataManager::loadFootpaths(TransportSystem& system, ParsedFile<FootpathGraph::Footpath> parsed) {
+    if (!std::filesystem::exists(dataDirectory + "footpaths.txt")) return;
+
+    std::vector<FootpathGraph::Footpath> footpaths;
+    for (auto& line : parsed) {
+        try {
+            FootpathGraph::Footpath footpath = line.take();
+            if (!system.hasStopNamed(footpath.from) || !system.hasStopNamed(footpath.to)) {
+                throw TransportException("Неизвестная остановка: " + footpath.from + " - " + footpath.to);
+            }
+            if (footpath.minutes <= 0) {
+                throw TransportException("Время перехода должно быть положительным");
+            }
+            footpaths.push_back(std::move(footpath));
+        } catch (const std::exception& e) {
+            *output << "Ошибка загрузки пешего перехода: " << e.what() << "\n";
+        }
+    }
+    // Пустой файл (или файл только с ошибочными строками) не отключает переходы по координатам
+    if (!footpaths.empty()) {
+        system.setFootpaths(footpaths);
+    }
+}
+
+void DataManager::loadTripLoading(TransportSystem& system) {
+    std::ifstream file(dataDirectory + "loading.txt");
+    if (!file.is_open()) return;
+
+    std::string line;
+    if (std::getline(file, line) && !line.empty()) {
+        try {
+            std::istringstream ss(line);
+            std::string onDemand, limit;
+            std::getline(ss, onDemand, '|');
+            std::getline(ss, limit);
+            TripLoadingOptions options;
+            options.onDemand = onDemand == "1";
+            if (!limit.empty()) {
+                options.memoryLimit = static_cast<std::size_t>(std::stoul(limit)) * 1024 * 1024;
+            }
+            system.setTripLoadingOptions(options);
+        } catch (const std::exception& e) {
+            *output << "Ошибка чтения настроек загрузки рейсов: " << e.what() << "\n";
+        }
+    }
+    file.close();
+}
+
+std::pair<std::string, std::string> DataManager::parseAdminCredentials(const std::string& line) {
+    std::istringstream ss(line);
+    std::string username, password;
+    std::getline(ss, username, '|');
+    std::getline(ss, password);
+    return {username, password};
+}
+
+void DataManager::loadAdminCredentials(TransportSystem& system,
+                                       ParsedFile<std::pair<std::string, std::string>> credentials) {
+    for (auto& line : credentials) {
+        auto [username, password] = line.take();
+        system.addAdmin(username, password);
+    }
+}
+
+// Реализация методов JourneyPlanner
+std::vector<Journey> JourneyPlanner::findJourneysWithTransfers(
+    const std::string& startStop,
+    const std::string& endStop,
+    const Time& departureTime,
+    int maxTransfers,
+    std::optional<ServiceDate> date) const {
+
+    const std::size_t allocationsBefore = AllocationTracker::getTotalAllocations();
+    const std::size_t bytesBefore = AllocationTracker::getTotalBytes();
+
+    // Метка BFS: путь восстанавливается по ссылкам на родителя,
+    // поэтому узлы не копируют списки рейсов и точек пересадок
+    struct SearchLabel {
+        const std::string* stop;
+        Time time;
+        EntityHandle trip;  // дескриптор рейса или шаблона, NO_TRIP для стартовой метки
+        std::size_t parent;
+        int transfers;
+        int run;            // номер отправления шаблона, NO_RUN для обычного рейса
+        bool walk;          // пеший переход; trip и run - последнего рейса до него
+    };
+    static constexpr EntityHandle NO_TRIP = INVALID_HANDLE;
+    static constexpr std::size_t NO_PARENT = std::numeric_limits<std::size_t>::max();
+    static constexpr int NO_RUN = -1;
+
+    // Рабочая память переиспользуется между запросами одного потока:
+    // после прогрева раскрытие узла не выделяет память в куче
+    thread_local std::vector<SearchLabel> labels;
+    thread_local std::vector<std::size_t> reached;
+    labels.clear();
+    reached.clear();
+
+    // Рейсы загружаются по мере обхода остановок, вытеснение - только до начала поиска.
+    // Для даты - индекс только с действующими в этот день рейсами; загрузка его дополняет
+    system->trimLoadedTrips();
+    const auto& timetable = system->getStopTimetableIndex(date);
+    const FootpathGraph& footpaths = system->getFootpaths();
+    labels.push_back({&startStop, departureTime, NO_TRIP, NO_PARENT, 0, NO_RUN, false});
+
+    // Вектор меток одновременно служит очередью BFS
+    std::size_t head = 0;
+    for (; head < labels.size(); ++head) {
+        const SearchLabel node = labels[head];
+
+        // Если достигли конечной остановки
+        if (*node.stop == endStop) {
+            reached.push_back(head);
+            continue;
+        }
+
+        // Пешие переходы только после поездки или от начальной остановки и не два подряд,
+        // поэтому на каждую метку поездки приходится не больше переходов, чем соседей в графе
+        if (!node.walk) {
+            auto [firstArc, lastArc] = footpaths.from(*node.stop);
+            for (const FootpathGraph::Arc* arc = firstArc; arc != lastArc; ++arc) {
+                const std::string& target = footpaths.getStopName(arc->target);
+                if (node.parent == NO_PARENT && target == endStop) continue; // поездка без транспорта
+                labels.push_back({&target, node.time + arc->minutes, node.trip, head,
+                                  node.transfers, node.run, true});
+            }
+        }
+
+        // Если превысили лимит пересадок
+        if (node.transfers >= maxTransfers) {
+            continue;
+        }
+
+        // Рейсы через текущую остановку, которые еще не ушли (индекс упорядочен по времени)
+        system->loadTripsAtStop(*node.stop);
+        auto [first, last] = timetable.departuresFrom(*node.stop, node.time.getTotalMinutes());
+        for (const StopEvent* event = first; event != last; ++event) {
+            // Пропускаем, если этот рейс уже в пути
+            if (node.trip == event->trip && node.run == NO_RUN) {
+                continue;
+            }
+
+            const Trip& trip = *system->getTripByHandle(event->trip);
+
+            // Получаем все остановки после текущей
+            const Route& route = *trip.getRoute();
+            const auto& routeStops = route.getAllStops();
+            int currentPos = route.getStopPosition(*node.stop);
+
+            if (currentPos == -1) continue;
+
+            // Если это пересадка (не первый рейс в пути)
+            int transfers = node.transfers + (node.trip != NO_TRIP ? 1 : 0);
+
+            // Проверяем все возможные точки выхода
+            for (std::size_t i = currentPos + 1; i < routeStops.size(); ++i) {
+                if (auto arrival = trip.getArrivalAt(i)) {
+                    labels.push_back({&routeStops[i], *arrival, event->trip, head, transfers, NO_RUN, false});
+                }
+            }
+        }
+
+        // По шаблону достаточно ближайшего отправления: следующие прибывают везде позже
+        if (const auto* templates = system->getTemplatesAtStop(*node.stop)) {
+            for (const TemplateStop& entry : *templates) {
+                if (node.trip == entry.pattern && node.run != NO_RUN) {
+                    continue;
+                }
+
+                const TripTemplate& pattern = *system->getTemplateByHandle(entry.pattern);
+                if (!system->isServiceActive(pattern.getCalendarId(), date)) continue;
+                int run = pattern.firstRunFrom(entry.stopPosition, node.time.getTotalMinutes());
+                if (run < 0) continue;
+
+                int transfers = node.transfers + (node.trip != NO_TRIP ? 1 : 0);
+                const auto& routeStops = pattern.getRoute()->getAllStops();
+                for (std::size_t i = entry.stopPosition + 1; i < routeStops.size(); ++i) {
+                    labels.push_back({&routeStops[i], Time(0, pattern.getArrivalMinutes(run, i)),
+                                      entry.pattern, head, transfers, run, false});
+                }
+            }
+        }
+    }
+
+    // Полные объекты Journey создаются только для найденных вариантов
+    std::vector<Journey> journeys;
+    journeys.reserve(reached.size());
+    for (std::size_t labelIndex : reached) {
+        std::vector<std::shared_ptr<Trip>> pathTrips;
+        std::vector<std::string> transferPoints;
+        std::vector<WalkingLeg> walks;
+
+        for (std::size_t i = labelIndex; labels[i].parent != NO_PARENT; i = labels[i].parent) {
+            const SearchLabel& previous = labels[labels[i].parent];
+            if (labels[i].walk) {
+                // Пока здесь число рейсов после перехода; индекс рейса - после разворота
+                walks.push_back({*previous.stop, *labels[i].stop,
+                                 (labels[i].time - previous.time + 1440) % 1440, pathTrips.size()});
+                continue;
+            }
+            pathTrips.push_back(labels[i].run == NO_RUN
+                                    ? system->getTripSharedByHandle(labels[i].trip)
+                                    : system->getTemplateByHandle(labels[i].trip)->instantiate(labels[i].run));
+            if (previous.trip != NO_TRIP) {
+                transferPoints.push_back(*previous.stop);
+            }
+        }
+        std::reverse(pathTrips.begin(), pathTrips.end());
+        std::reverse(transferPoints.begin(), transferPoints.end());
+        std::reverse(walks.begin(), walks.end());
+        for (auto& walk : walks) {
+            walk.beforeTrip = pathTrips.size() - walk.beforeTrip;
+        }
+
+        journeys.emplace_back(pathTrips, transferPoints, departureTime, labels[labelIndex].time,
+                              std::move(walks));
+    }
+
+    // Сортируем по времени в пути
+    std::sort(journeys.begin(), journeys.end(),
+              [](const Journey& a, const Journey& b) {
+                  return a.getTotalDuration() < b.getTotalDuration();
+              });
+
+    lastQueryStats.allocations = AllocationTracker::getTotalAllocations() - allocationsBefore;
+    lastQueryStats.allocatedBytes = AllocationTracker::getTotalBytes() - bytesBefore;
+    lastQueryStats.expandedNodes = head;
+
+    return journeys;
+}
+
+Journey JourneyPlanner::findFastestJourney(const std::string& startStop,
+                                          const std::string& endStop,
+                                          const Time& departureTime,
+                                          std::optional<ServiceDate> date) {
+    auto journeys = findJourneysWithTransfers(startStop, endStop, departureTime, 2, date);
+
+    if (journeys.empty()) {
+        throw TransportException("Маршрут не найден");
+    }
+
+    // Первый в списке самый быстрый (после сортировки)
+    return journeys[0];
+}
+
+Journey JourneyPlanner::findJourneyWithLeastTransfers(const std::string& startStop,
+                                                     const std::string& endStop,
+                                                     const Time& departureTime,
+                                                     std::optional<ServiceDate> date) {
+    auto journeys = findJourneysWithTransfers(startStop, endStop, departureTime, 2, date);
+
+    if (journeys.empty()) {
+        throw TransportException("Маршрут не найден");
+    }
+
+    // Ищем с минимальным количеством пересадок
+    auto it = std::min_element(journeys.begin(), journeys.end(),
+                               [](const Journey& a, const Journey& b) {
+                                   return a.getTransferCount() < b.getTransferCount();
+                               });
+
+    return *it;
+}
@@ -0,0 +1,7655 @@
+#pragma once
+
+// Ядро системы расписания: сущности, индексы, планировщик, загрузка данных и GTFS.
+// Запросы возвращают значения, а меню и вывод результатов находятся в main.cpp.
+// Собирается отдельной статической библиотекой kursach_core для сервисов и замеров
+
+#include <iostream>
+#include <utility>
+#include <vector>
+#include <string>
+#include <memory>
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <map>
+#include <ctime>
+#include <limits>
+#include <unordered_map>
+#include <unordered_set>
+#include <set>
+#include <queue>
+#include <filesystem>
+#include <iomanip>
+#include <atomic>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+#include <mutex>
+#include <cstdint>
+#include <thread>
+#include <chrono>
+#include <optional>
+#include <cmath>
+#include <string_view>
+#include <charconv>
+#include <cstring>
+#include <list>
+#include <array>
+#include <future>
+#include <type_traits>
+
+class TransportSystem;
+
+// Учет выделений памяти на уровне глобального аллокатора. Счетчики ведет замена operator new/delete
+// из AllocationTracking.cpp; без нее (библиотека в чужой программе) учет выключен и счетчики нулевые
+class AllocationTracker {
+private:
+    static inline std::atomic<bool> installed{false};
+    static inline std::atomic<std::size_t> liveBytes{0};
+    static inline std::atomic<std::size_t> liveBlocks{0};
+    static inline std::atomic<std::size_t> peakBytes{0};
+    static inline std::atomic<std::size_t> totalBytes{0};
+    static inline std::atomic<std::size_t> totalAllocations{0};
+
+public:
+    // Размер служебного заголовка перед блоком (сохраняет выравнивание max_align_t)
+    static constexpr std::size_t HEADER_SIZE = alignof(std::max_align_t);
+
+    static void onAllocate(std::size_t size) noexcept {
+        std::size_t current = liveBytes.fetch_add(size, std::memory_order_relaxed) + size;
+        liveBlocks.fetch_add(1, std::memory_order_relaxed);
+        totalBytes.fetch_add(size, std::memory_order_relaxed);
+        totalAllocations.fetch_add(1, std::memory_order_relaxed);
+
+        std::size_t peak = peakBytes.load(std::memory_order_relaxed);
+        while (current > peak &&
+               !peakBytes.compare_exchange_weak(peak, current, std::memory_order_relaxed)) {
+        }
+    }
+
+    static void onDeallocate(std::size_t size) noexcept {
+        liveBytes.fetch_sub(size, std::memory_order_relaxed);
+        liveBlocks.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    static void markInstalled() noexcept { installed.store(true, std::memory_order_relaxed); }
+    static bool isInstalled() { return installed.load(std::memory_order_relaxed); }
+
+    static std::size_t getLiveBytes() { return liveBytes.load(std::memory_order_relaxed); }
+    static std::size_t getLiveBlocks() { return liveBlocks.load(std::memory_order_relaxed); }
+    static std::size_t getPeakBytes() { return peakBytes.load(std::memory_order_relaxed); }
+    static std::size_t getTotalBytes() { return totalBytes.load(std::memory_order_relaxed); }
+    static std::size_t getTotalAllocations() { return totalAllocations.load(std::memory_order_relaxed); }
+};
+
+// Компоненты отчета о памяти: выделения их контейнеров и сущностей считаются раздельно
+enum class MemoryComponent : std::size_t {
+    Routes, Trips, TripPatterns, LazyTrips, Vehicles, Drivers, StopIds, DriverSchedule,
+    VehicleIntervals, StopTimetable, TripIds, StopNames, Footpaths, Calendars, Templates,
+    RouteIndex, VehiclePlates, DriverNames, Count
+};
+
+// Байты, занятые сейчас каждым компонентом (по всем экземплярам структур в процессе)
+class ComponentMemory {
+private:
+    static inline std::array<std::atomic<std::size_t>, static_cast<std::size_t>(MemoryComponent::Count)> live{};
+
+public:
+    static void onAllocate(MemoryComponent component, std::size_t size) noexcept {
+        live[static_cast<std::size_t>(component)].fetch_add(size, std::memory_order_relaxed);
+    }
+
+    static void onDeallocate(MemoryComponent component, std::size_t size) noexcept {
+        live[static_cast<std::size_t>(component)].fetch_sub(size, std::memory_order_relaxed);
+    }
+
+    static std::size_t getLiveBytes(MemoryComponent component) {
+        return live[static_cast<std::size_t>(component)].load(std::memory_order_relaxed);
+    }
+
+    // Буфер строки в куче: capacity() + 1 символ; короткие строки лежат внутри объекта
+    template<typename Char>
+    static std::size_t stringBytes(const std::basic_string<Char>& s) {
+        static const std::size_t inlineCapacity = std::basic_string<Char>().capacity();
+        return s.capacity() > inlineCapacity ? (s.capacity() + 1) * sizeof(Char) : 0;
+    }
+};
+
+// Базовый класс для исключений транспортной системы
+class TransportException : public std::exception {
+private:
+    std::string message;
+public:
+    explicit TransportException(std::string  msg) : message(std::move(msg)) {}
+    const char* what() const noexcept override { return message.c_str(); }
+};
+
+// Дескриптор сущности: 32-битный индекс в таблице TransportSystem
+using EntityHandle = std::uint32_t;
+constexpr EntityHandle INVALID_HANDLE = std::numeric_limits<EntityHandle>::max();
+
+// Базовый класс для сущностей, зарегистрированных в системе под дескриптором
+class RegisteredEntity {
+private:
+    EntityHandle handle = INVALID_HANDLE;
+public:
+    EntityHandle getHandle() const { return handle; }
+    void setHandle(EntityHandle h) { handle = h; }
+    bool isRegistered() const { return handle != INVALID_HANDLE; }
+};
+
+// Общая статистика всех пулов (для отчета о памяти)
+class SlabPoolBase {
+private:
+    static std::vector<const SlabPoolBase*>& registry() {
+        static auto* pools = new std::vector<const SlabPoolBase*>();
+        return *pools;
+    }
+
+    // Пулы разных типов могут впервые понадобиться одновременно в разных потоках
+    static std::mutex& registryMutex() {
+        static auto* mutex = new std::mutex();
+        return *mutex;
+    }
+
+protected:
+    SlabPoolBase() {
+        std::lock_guard<std::mutex> lock(registryMutex());
+        registry().push_back(this);
+    }
+
+public:
+    virtual ~SlabPoolBase() = default;
+    virtual std::size_t getReservedBytes() const = 0;
+    virtual std::size_t getLiveBytes() const = 0;
+    virtual std::size_t getLiveBlocks() const = 0;
+
+    static const std::vector<const SlabPoolBase*>& getAllPools() { return registry(); }
+};
+
+// Пул блоков одного размера: объекты одного типа лежат подряд в слябах,
+// освобожденные блоки возвращаются в список свободных
+template<std::size_t BlockSize, std::size_t BlockAlign>
+class SlabPool : public SlabPoolBase {
+private:
+    struct FreeBlock {
+        FreeBlock* next;
+    };
+
+    // Слябы растут геометрически: малые наборы данных не резервируют лишнего
+    static constexpr std::size_t FIRST_SLAB_BLOCKS = 16;
+    static constexpr std::size_t MAX_SLAB_BLOCKS = 1024;
+    static constexpr std::size_t STRIDE =
+        ((BlockSize > sizeof(FreeBlock) ? BlockSize : sizeof(FreeBlock)) + BlockAlign - 1) /
+        BlockAlign * BlockAlign;
+    static_assert(BlockAlign <= alignof(std::max_align_t), "Слишком строгое выравнивание для пула");
+
+    std::vector<std::unique_ptr<std::byte[]>> slabs;
+    FreeBlock* freeList = nullptr;
+    std::size_t liveBlocks = 0;
+    std::size_t reservedBlocks = 0;
+    mutable std::mutex mutex;
+
+    void addSlab() {
+        std::size_t blocks = std::min(FIRST_SLAB_BLOCKS << std::min<std::size_t>(slabs.size(), 6),
+                                      MAX_SLAB_BLOCKS);
+        slabs.push_back(std::make_unique<std::byte[]>(STRIDE * blocks));
+        reservedBlocks += blocks;
+        std::byte* slab = slabs.back().get();
+        for (std::size_t i = blocks; i-- > 0; ) {
+            auto* block = reinterpret_cast<FreeBlock*>(slab + i * STRIDE);
+            block->next = freeList;
+            freeList = block;
+        }
+    }
+
+    SlabPool() = default;
+
+public:
+    // Размер блока с выравниванием: столько занимает в пуле один объект
+    static constexpr std::size_t BLOCK_BYTES = STRIDE;
+
+    // Пул живет до конца процесса, чтобы пережить любые статические shared_ptr
+    static SlabPool& instance() {
+        static auto* pool = new SlabPool();
+        return *pool;
+    }
+
+    void* allocate() {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!freeList) addSlab();
+        FreeBlock* block = freeList;
+        freeList = block->next;
+        ++liveBlocks;
+        return block;
+    }
+
+    void deallocate(void* ptr) noexcept {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto* block = static_cast<FreeBlock*>(ptr);
+        block->next = freeList;
+        freeList = block;
+        --liveBlocks;
+    }
+
+    std::size_t getReservedBytes() const override {
+        std::lock_guard<std::mutex> lock(mutex);
+        return reservedBlocks * STRIDE;
+    }
+
+    std::size_t getLiveBytes() const override {
+        std::lock_guard<std::mutex> lock(mutex);
+        return liveBlocks * STRIDE;
+    }
+
+    std::size_t getLiveBlocks() const override {
+        std::lock_guard<std::mutex> lock(mutex);
+        return liveBlocks;
+    }
+};
+
+// Аллокатор для allocate_shared: объект и счетчик ссылок берутся из пула своего типа,
+// занятые блоки учитываются за компонентом сущности
+template<typename T, MemoryComponent Component>
+class PoolAllocator {
+private:
+    using Pool = SlabPool<sizeof(T), alignof(T)>;
+
+public:
+    using value_type = T;
+
+    template<typename U>
+    struct rebind {
+        using other = PoolAllocator<U, Component>;
+    };
+
+    PoolAllocator() = default;
+    template<typename U>
+    PoolAllocator(const PoolAllocator<U, Component>&) noexcept {}
+
+    T* allocate(std::size_t n) {
+        if (n != 1) {
+            T* ptr = static_cast<T*>(::operator new(n * sizeof(T)));
+            ComponentMemory::onAllocate(Component, n * sizeof(T));
+            return ptr;
+        }
+        T* ptr = static_cast<T*>(Pool::instance().allocate());
+        ComponentMemory::onAllocate(Component, Pool::BLOCK_BYTES);
+        return ptr;
+    }
+
+    void deallocate(T* ptr, std::size_t n) noexcept {
+        if (n != 1) {
+            ComponentMemory::onDeallocate(Component, n * sizeof(T));
+            ::operator delete(ptr);
+            return;
+        }
+        ComponentMemory::onDeallocate(Component, Pool::BLOCK_BYTES);
+        Pool::instance().deallocate(ptr);
+    }
+
+    template<typename U>
+    bool operator==(const PoolAllocator<U, Component>&) const noexcept { return true; }
+};
+
+// Создание сущности в пуле (замена std::make_shared); компонент задает T::MEMORY_COMPONENT
+template<typename T, typename... Args>
+std::shared_ptr<T> makePooled(Args&&... args) {
+    return std::allocate_shared<T>(PoolAllocator<T, T::MEMORY_COMPONENT>(), std::forward<Args>(args)...);
+}
+
+// Аллокатор контейнеров с учетом выделенных байт за компонентом-владельцем
+template<typename T, MemoryComponent Component>
+class CountingAllocator {
+public:
+    using value_type = T;
+
+    template<typename U>
+    struct rebind {
+        using other = CountingAllocator<U, Component>;
+    };
+
+    CountingAllocator() = default;
+    template<typename U>
+    CountingAllocator(const CountingAllocator<U, Component>&) noexcept {}
+
+    T* allocate(std::size_t n) {
+        T* ptr = std::allocator<T>().allocate(n);
+        ComponentMemory::onAllocate(Component, n * sizeof(T));
+        return ptr;
+    }
+
+    void deallocate(T* ptr, std::size_t n) noexcept {
+        ComponentMemory::onDeallocate(Component, n * sizeof(T));
+        std::allocator<T>().deallocate(ptr, n);
+    }
+
+    template<typename U>
+    bool operator==(const CountingAllocator<U, Component>&) const noexcept { return true; }
+};
+
+// Узловые контейнеры с учетом памяти: размер узлов и корзин зависит от реализации библиотеки,
+// поэтому он измеряется аллокатором, а не вычисляется. getMemoryBytes() структур возвращает
+// остальное - буферы векторов (ровно capacity() элементов) и длинных строк
+template<typename Key, typename Value, MemoryComponent Component>
+using CountedHashMap = std::unordered_map<Key, Value, std::hash<Key>, std::equal_to<Key>,
+                                          CountingAllocator<std::pair<const Key, Value>, Component>>;
+
+template<typename Key, typename Value, MemoryComponent Component>
+using CountedMap = std::map<Key, Value, std::less<Key>, CountingAllocator<std::pair<const Key, Value>, Component>>;
+
+template<typename Key, MemoryComponent Component>
+using CountedSet = std::set<Key, std::less<Key>, CountingAllocator<Key, Component>>;
+
+template<typename T, MemoryComponent Component>
+using CountedList = std::list<T, CountingAllocator<T, Component>>;
+
+// Таблица дескрипторов: индекс -> сущность, освобожденные индексы переиспользуются
+template<typename T>
+class HandleTable {
+private:
+    std::vector<std::shared_ptr<T>> slots;
+    std::vector<EntityHandle> freeSlots;
+
+public:
+    EntityHandle acquire(const std::shared_ptr<T>& entity) {
+        EntityHandle handle;
+        if (!freeSlots.empty()) {
+            handle = freeSlots.back();
+            freeSlots.pop_back();
+            slots[handle] = entity;
+        } else {
+            if (slots.size() >= INVALID_HANDLE) {
+                throw TransportException("Превышено максимальное количество сущностей");
+            }
+            handle = static_cast<EntityHandle>(slots.size());
+            slots.push_back(entity);
+        }
+        entity->setHandle(handle);
+        return handle;
+    }
+
+    void release(T* entity) {
+        EntityHandle handle = entity->getHandle();
+        if (handle < slots.size() && slots[handle].get() == entity) {
+            slots[handle].reset();
+            freeSlots.push_back(handle);
+        }
+        entity->setHandle(INVALID_HANDLE);
+    }
+
+    T* get(EntityHandle handle) const {
+        return handle < slots.size() ? slots[handle].get() : nullptr;
+    }
+
+    // Владеющая ссылка (нужна, когда сущность передается дальше как shared_ptr)
+    std::shared_ptr<T> getShared(EntityHandle handle) const {
+        return handle < slots.size() ? slots[handle] : nullptr;
+    }
+
+    bool contains(const T* entity) const {
+        return entity && get(entity->getHandle()) == entity;
+    }
+
+    std::size_t getSlotCount() const { return slots.size(); }
+
+    std::size_t getMemoryBytes() const {
+        return slots.capacity() * sizeof(std::shared_ptr<T>) + freeSlots.capacity() * sizeof(EntityHandle);
+    }
+};
+
+// Множество дескрипторов в виде битовой маски (для пакетных операций)
+class HandleSet {
+private:
+    std::vector<bool> bits;
+    std::size_t count = 0;
+
+public:
+    void insert(EntityHandle handle) {
+        if (handle >= bits.size()) bits.resize(handle + 1);
+        if (!bits[handle]) {
+            bits[handle] = true;
+            ++count;
+        }
+    }
+
+    bool contains(EntityHandle handle) const {
+        return handle < bits.size() && bits[handle];
+    }
+
+    std::size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+};
+
+// Удаление из плотного массива перестановкой последнего элемента на место удаляемого.
+// position[handle] - индекс сущности в items
+template<typename T>
+void swapAndPop(std::vector<std::shared_ptr<T>>& items, std::vector<std::size_t>& position, EntityHandle handle) {
+    std::size_t index = position[handle];
+    if (index + 1 != items.size()) {
+        items[index] = std::move(items.back());
+        position[items[index]->getHandle()] = index;
+    }
+    items.pop_back();
+}
+
+// Двоичная запись кэша индексов: числа в порядке байтов машины, строки и массивы - с длиной
+class BinaryWriter {
+private:
+    std::ofstream file;
+
+public:
+    explicit BinaryWriter(const std::string& path) : file(path, std::ios::binary | std::ios::trunc) {
+        if (!file.is_open()) {
+            throw TransportException("Не удалось открыть файл " + path);
+        }
+    }
+
+    template<typename T>
+    void value(const T& item) {
+        static_assert(std::is_trivially_copyable_v<T>);
+        file.write(reinterpret_cast<const char*>(&item), sizeof(T));
+    }
+
+    template<typename T>
+    void array(const std::vector<T>& items) {
+        static_assert(std::is_trivially_copyable_v<T>);
+        value<std::uint64_t>(items.size());
+        file.write(reinterpret_cast<const char*>(items.data()),
+                   static_cast<std::streamsize>(items.size() * sizeof(T)));
+    }
+
+    void string(std::string_view text) {
+        value(static_cast<std::uint32_t>(text.size()));
+        file.write(text.data(), static_cast<std::streamsize>(text.size()));
+    }
+
+    void close() {
+        file.close();
+        if (!file) {
+            throw TransportException("Ошибка записи кэша индексов");
+        }
+    }
+};
+
+// Чтение файла, записанного BinaryWriter. Файл читается целиком одним блоком,
+// выход за его конец (обрезанный или испорченный файл) - исключение
+class BinaryReader {
+private:
+    std::vector<char> data;
+    std::size_t position = 0;
+
+    const char* take(std::size_t size) {
+        if (size > data.size() - position) {
+            throw TransportException("Кэш индексов поврежден");
+        }
+        const char* result = data.data() + position;
+        position += size;
+        return result;
+    }
+
+public:
+    explicit BinaryReader(const std::string& path) {
+        std::ifstream file(path, std::ios::binary | std::ios::ate);
+        if (!file.is_open()) {
+            throw TransportException("Не удалось открыть файл " + path);
+        }
+        data.resize(static_cast<std::size_t>(file.tellg()));
+        file.seekg(0);
+        if (!file.read(data.data(), static_cast<std::streamsize>(data.size()))) {
+            throw TransportException("Ошибка чтения файла " + path);
+        }
+    }
+
+    template<typename T>
+    T value() {
+        static_assert(std::is_trivially_copyable_v<T>);
+        T item;
+        std::memcpy(&item, take(sizeof(T)), sizeof(T));
+        return item;
+    }
+
+    template<typename T>
+    std::vector<T> array() {
+        static_assert(std::is_trivially_copyable_v<T>);
+        auto count = value<std::uint64_t>();
+        if (count > (data.size() - position) / sizeof(T)) {
+            throw TransportException("Кэш индексов поврежден");
+        }
+        std::vector<T> items(static_cast<std::size_t>(count));
+        if (!items.empty()) {
+            std::memcpy(items.data(), take(items.size() * sizeof(T)), items.size() * sizeof(T));
+        }
+        return items;
+    }
+
+    std::string string() {
+        auto size = value<std::uint32_t>();
+        return std::string(take(size), size);
+    }
+
+    bool atEnd() const { return position == data.size(); }
+};
+
+class Stop {
+private:
+    int id;
+    std::string name;
+    double latitude = 0.0;   // градусы
+    double longitude = 0.0;  // градусы
+    bool located = false;    // координаты заданы
+public:
+    Stop(int stopId, std::string  stopName) : id(stopId), name(std::move(stopName)) {}
+
+    Stop(int stopId, std::string stopName, double lat, double lon) : id(stopId), name(std::move(stopName)) {
+        setCoordinates(lat, lon);
+    }
+
+    int getId() const { return id; }
+    std::string getName() const { return name; }
+    double getLatitude() const { return latitude; }
+    double getLongitude() const { return longitude; }
+    bool hasCoordinates() const { return located; }
+
+    void setCoordinates(double lat, double lon) {
+        if (lat < -90.0 || lat > 90.0 || lon < -180.0 || lon > 180.0) {
+            throw TransportException("Некорректные координаты остановки");
+        }
+        latitude = lat;
+        longitude = lon;
+        located = true;
+    }
+
+    bool operator==(const Stop& other) const {
+        return id == other.id;
+    }
+
+    // Координаты дописываются только если заданы: старые файлы читаются без изменений
+    std::string serialize() const {
+        std::string result = std::to_string(id) + "|" + name;
+        if (located) {
+            std::ostringstream coordinates;
+            coordinates << std::setprecision(9) << "|" << latitude << "|" << longitude;
+            result += coordinates.str();
+        }
+        return result;
+    }
+
+    static Stop deserialize(const std::string& data) {
+        std::istringstream ss(data);
+        std::string idStr, name, latStr, lonStr;
+        std::getline(ss, idStr, '|');
+        std::getline(ss, name, '|');
+        Stop stop(std::stoi(idStr), name);
+        if (std::getline(ss, latStr, '|') && std::getline(ss, lonStr)) {
+            stop.setCoordinates(std::stod(latStr), std::stod(lonStr));
+        }
+        return stop;
+    }
+};
+
+// Пространственный индекс остановок: k-d дерево по точкам на сфере в трехмерных
+// координатах. Длина хорды монотонна по расстоянию на поверхности, поэтому
+// поиск ближайших по евклидовой метрике дает точный результат
+class StopSpatialIndex {
+public:
+    struct Neighbor {
+        int stopId;
+        double distanceMeters;
+    };
+
+private:
+    static constexpr double EARTH_RADIUS = 6371000.0; // м
+
+    struct Point {
+        double xyz[3];
+        int stopId;
+    };
+
+    // Неявное сбалансированное дерево: корень поддиапазона [first, last) - его середина
+    std::vector<Point> points;
+
+    static Point toPoint(double lat, double lon, int stopId) {
+        const double toRadians = 3.14159265358979323846 / 180.0;
+        double phi = lat * toRadians, lambda = lon * toRadians;
+        return {{EARTH_RADIUS * std::cos(phi) * std::cos(lambda),
+                 EARTH_RADIUS * std::cos(phi) * std::sin(lambda),
+                 EARTH_RADIUS * std::sin(phi)}, stopId};
+    }
+
+    static double squaredDistance(const Point& a, const Point& b) {
+        double sum = 0.0;
+        for (int axis = 0; axis < 3; ++axis) {
+            double delta = a.xyz[axis] - b.xyz[axis];
+            sum += delta * delta;
+        }
+        return sum;
+    }
+
+    // Хорда -> расстояние по поверхности
+    static double surfaceDistance(double chord) {
+        return 2.0 * EARTH_RADIUS * std::asin(std::min(1.0, chord / (2.0 * EARTH_RADIUS)));
+    }
+
+    void build(std::size_t first, std::size_t last, int axis) {
+        if (last - first <= 1) return;
+        std::size_t middle = first + (last - first) / 2;
+        std::nth_element(points.begin() + first, points.begin() + middle, points.begin() + last,
+                         [axis](const Point& a, const Point& b) { return a.xyz[axis] < b.xyz[axis]; });
+        build(first, middle, (axis + 1) % 3);
+        build(middle + 1, last, (axis + 1) % 3);
+    }
+
+    // Обход с отсечением поддеревьев, которые не могут содержать точку ближе bound()
+    template<typename Visit, typename Bound>
+    void search(const Point& target, std::size_t first, std::size_t last, int axis,
+                Visit visit, Bound bound) const {
+        if (first >= last) return;
+        std::size_t middle = first + (last - first) / 2;
+        const Point& node = points[middle];
+        visit(node, squaredDistance(node, target));
+
+        double delta = target.xyz[axis] - node.xyz[axis];
+        int nextAxis = (axis + 1) % 3;
+        std::size_t nearFirst = delta < 0 ? first : middle + 1, nearLast = delta < 0 ? middle : last;
+        std::size_t farFirst = delta < 0 ? middle + 1 : first, farLast = delta < 0 ? last : middle;
+
+        search(target, nearFirst, nearLast, nextAxis, visit, bound);
+        if (delta * delta <= bound()) {
+            search(target, farFirst, farLast, nextAxis, visit, bound);
+        }
+    }
+
+public:
+    // Построение по остановкам с заданными координатами, O(n log n)
+    void build(const std::vector<Stop>& stops) {
+        points.clear();
+        for (const auto& stop : stops) {
+            if (stop.hasCoordinates()) {
+                points.push_back(toPoint(stop.getLatitude(), stop.getLongitude(), stop.getId()));
+            }
+        }
+        build(0, points.size(), 0);
+    }
+
+    // k ближайших остановок, по возрастанию расстояния
+    std::vector<Neighbor> kNearest(double lat, double lon, std::size_t k) const {
+        std::vector<std::pair<double, int>> heap; // max-куча по квадрату хорды
+        if (k == 0) return {};
+        Point target = toPoint(lat, lon, -1);
+
+        search(target, 0, points.size(), 0,
+            [&](const Point& point, double distance) {
+                if (heap.size() < k) {
+                    heap.push_back({distance, point.stopId});
+                    std::push_heap(heap.begin(), heap.end());
+                } else if (distance < heap.front().first) {
+                    std::pop_heap(heap.begin(), heap.end());
+                    heap.back() = {distance, point.stopId};
+                    std::push_heap(heap.begin(), heap.end());
+                }
+            },
+            [&]() { return heap.size() < k ? std::numeric_limits<double>::max() : heap.front().first; });
+
+        std::sort_heap(heap.begin(), heap.end());
+        std::vector<Neighbor> result;
+        result.reserve(heap.size());
+        for (const auto& [distance, stopId] : heap) {
+            result.push_back({stopId, surfaceDistance(std::sqrt(distance))});
+        }
+        return result;
+    }
+
+    // Все остановки в радиусе radiusMeters, по возрастанию расстояния
+    std::vector<Neighbor> withinRadius(double lat, double lon, double radiusMeters) const {
+        double chord = 2.0 * EARTH_RADIUS * std::sin(std::min(radiusMeters / (2.0 * EARTH_RADIUS),
+                                                             3.14159265358979323846 / 2.0));
+        double limit = chord * chord;
+        Point target = toPoint(lat, lon, -1);
+
+        std::vector<Neighbor> result;
+        search(target, 0, points.size(), 0,
+            [&](const Point& point, double distance) {
+                if (distance <= limit) {
+                    result.push_back({point.stopId, surfaceDistance(std::sqrt(distance))});
+                }
+            },
+            [limit]() { return limit; });
+
+        std::sort(result.begin(), result.end(), [](const Neighbor& a, const Neighbor& b) {
+            return a.distanceMeters < b.distanceMeters;
+        });
+        return result;
+    }
+
+    std::size_t size() const { return points.size(); }
+
+    std::size_t getMemoryBytes() const {
+        return points.capacity() * sizeof(Point);
+    }
+};
+
+// Граф пешеходных переходов между остановками в компактном виде (CSR):
+// переходы остановки i занимают arcs[offsets[i], offsets[i + 1]) и упорядочены по времени
+class FootpathGraph {
+public:
+    struct Footpath {
+        std::string from;
+        std::string to;
+        int minutes;
+    };
+
+    struct Arc {
+        std::uint32_t target;
+        int minutes;
+    };
+
+private:
+    CountedHashMap<std::string, std::uint32_t, MemoryComponent::Footpaths> nodeIndex;
+    std::vector<std::string> nodeNames;
+    std::vector<std::uint32_t> offsets;
+    std::vector<Arc> arcs;
+
+    std::uint32_t node(const std::string& stop) {
+        auto [it, inserted] = nodeIndex.try_emplace(stop, static_cast<std::uint32_t>(nodeNames.size()));
+        if (inserted) {
+            nodeNames.push_back(stop);
+        }
+        return it->second;
+    }
+
+public:
+    // Построение подсчетом: два прохода по списку переходов, без промежуточных списков смежности
+    void build(const std::vector<Footpath>& footpaths) {
+        nodeIndex.clear();
+        nodeNames.clear();
+
+        std::vector<std::pair<std::uint32_t, Arc>> resolved;
+        resolved.reserve(footpaths.size());
+        for (const auto& footpath : footpaths) {
+            if (footpath.from == footpath.to) continue;
+            if (footpath.minutes <= 0) {
+                throw TransportException("Время пешего перехода должно быть положительным");
+            }
+            std::uint32_t from = node(footpath.from);
+            resolved.push_back({from, {node(footpath.to), footpath.minutes}});
+        }
+
+        offsets.assign(nodeNames.size() + 1, 0);
+        for (const auto& [from, arc] : resolved) {
+            ++offsets[from + 1];
+        }
+        for (std::size_t i = 1; i < offsets.size(); ++i) {
+            offsets[i] += offsets[i - 1];
+        }
+
+        arcs.assign(resolved.size(), Arc{0, 0});
+        std::vector<std::uint32_t> cursor(offsets.begin(), offsets.end() - 1);
+        for (const auto& [from, arc] : resolved) {
+            arcs[cursor[from]++] = arc;
+        }
+        for (std::size_t i = 0; i + 1 < offsets.size(); ++i) {
+            std::sort(arcs.begin() + offsets[i], arcs.begin() + offsets[i + 1],
+                      [](const Arc& a, const Arc& b) { return a.minutes < b.minutes; });
+        }
+
+        arcs.shrink_to_fit();
+        nodeNames.shrink_to_fit();
+    }
+
+    // Переходы от остановки; пустой диапазон, если их нет
+    std::pair<const Arc*, const Arc*> from(const std::string& stop) const {
+        auto it = nodeIndex.find(stop);
+        if (it == nodeIndex.end()) {
+            return {nullptr, nullptr};
+        }
+        return {arcs.data() + offsets[it->second], arcs.data() + offsets[it->second + 1]};
+    }
+
+    const std::string& getStopName(std::uint32_t index) const { return nodeNames[index]; }
+
+    // Все переходы в исходном виде (для сохранения в файл)
+    std::vector<Footpath> getFootpaths() const {
+        std::vector<Footpath> result;
+        result.reserve(arcs.size());
+        for (std::size_t i = 0; i + 1 < offsets.size(); ++i) {
+            for (std::uint32_t a = offsets[i]; a < offsets[i + 1]; ++a) {
+                result.push_back({nodeNames[i], nodeNames[arcs[a].target], arcs[a].minutes});
+            }
+        }
+        return result;
+    }
+
+    // Граф в кэше индексов хранится готовым CSR, без повторного построения
+    void write(BinaryWriter& out) const {
+        out.value(static_cast<std::uint32_t>(nodeNames.size()));
+        for (const auto& name : nodeNames) {
+            out.string(name);
+        }
+        out.array(offsets.empty() ? std::vector<std::uint32_t>{0} : offsets); // граф еще не строился
+        out.array(arcs);
+    }
+
+    static FootpathGraph read(BinaryReader& in) {
+        FootpathGraph graph;
+        auto nodeCount = in.value<std::uint32_t>();
+        for (std::uint32_t i = 0; i < nodeCount; ++i) {
+            if (graph.node(in.string()) != i) {
+                throw TransportException("Кэш индексов поврежден: повтор остановки в графе переходов");
+            }
+        }
+        graph.offsets = in.array<std::uint32_t>();
+        graph.arcs = in.array<Arc>();
+
+        bool consistent = graph.offsets.size() == nodeCount + std::size_t{1} && graph.offsets.front() == 0 &&
+                          graph.offsets.back() == graph.arcs.size() &&
+                          std::is_sorted(graph.offsets.begin(), graph.offsets.end()) &&
+                          std::all_of(graph.arcs.begin(), graph.arcs.end(),
+                                      [&](const Arc& arc) { return arc.target < nodeCount && arc.minutes > 0; });
+        if (!consistent) {
+            throw TransportException("Кэш индексов поврежден: граф переходов");
+        }
+        return graph;
+    }
+
+    std::size_t getStopCount() const { return nodeNames.size(); }
+    std::size_t size() const { return arcs.size(); }
+
+    std::size_t getMemoryBytes() const {
+        std::size_t bytes = arcs.capacity() * sizeof(Arc) + offsets.capacity() * sizeof(std::uint32_t) +
+                            nodeNames.capacity() * sizeof(std::string);
+        for (const auto& name : nodeNames) {
+            bytes += ComponentMemory::stringBytes(name);
+        }
+        for (const auto& [name, node] : nodeIndex) {
+            bytes += ComponentMemory::stringBytes(name);
+        }
+        return bytes;
+    }
+};
+
+// Класс для времени
+class Time {
+private:
+    int hours;
+    int minutes;
+
+    // Вспомогательная функция для нормализации
+    void normalize(int totalMinutes) {
+        totalMinutes = ((totalMinutes % 1440) + 1440) % 1440; // [0, 1439]
+        hours = totalMinutes / 60;
+        minutes = totalMinutes % 60;
+    }
+
+public:
+    explicit Time(int h = 0, int m = 0) {
+        normalize(h * 60 + m);
+    }
+
+    explicit Time(const std::string& timeStr) {
+        std::stringstream ss(timeStr);
+        char colon;
+        int h, m;
+        if (!(ss >> h >> colon >> m) || colon != ':' || ss.fail() || !ss.eof()) {
+            throw TransportException("Неверный формат времени: " + timeStr);
+        }
+        if (h < 0 || h > 23 || m < 0 || m > 59) {
+            throw TransportException("Некорректное время: " + timeStr);
+        }
+        hours = h;
+        minutes = m;
+    }
+
+    int getTotalMinutes() const { return hours * 60 + minutes; }
+    int getHours() const { return hours; }
+    int getMinutes() const { return minutes; }
+
+    // Числа 0..99 парами цифр: время форматируется копированием, без потоков и выделений памяти
+    static constexpr std::array<char, 200> DIGIT_PAIRS = [] {
+        std::array<char, 200> table{};
+        for (int i = 0; i < 100; ++i) {
+            table[2 * i] = static_cast<char>('0' + i / 10);
+            table[2 * i + 1] = static_cast<char>('0' + i % 10);
+        }
+        return table;
+    }();
+
+    // Запись ЧЧ:ММ по минутам от начала суток (часы могут быть больше 23 для рейсов
+    // после полуночи) в буфер не короче 16 символов. Возвращает конец записи
+    static char* formatMinutes(char* out, int totalMinutes) {
+        int hours = totalMinutes / 60;
+        int minutes = totalMinutes % 60;
+        if (totalMinutes >= 0 && hours < 100) {
+            std::memcpy(out, DIGIT_PAIRS.data() + 2 * hours, 2);
+            out += 2;
+        } else {
+            out = std::to_chars(out, out + 12, hours).ptr;
+            minutes = std::abs(minutes);
+        }
+        *out++ = ':';
+        std::memcpy(out, DIGIT_PAIRS.data() + 2 * minutes, 2);
+        return out + 2;
+    }
+
+    bool operator<(const Time& other) const {
+        return getTotalMinutes() < other.getTotalMinutes();
+    }
+
+    bool operator<=(const Time& other) const {
+        return getTotalMinutes() <= other.getTotalMinutes();
+    }
+
+    bool operator>(const Time& other) const {
+        return getTotalMinutes() > other.getTotalMinutes();
+    }
+
+    bool operator>=(const Time& other) const {
+        return getTotalMinutes() >= other.getTotalMinutes();
+    }
+
+    bool operator==(const Time& other) const {
+        return getTotalMinutes() == other.getTotalMinutes();
+    }
+
+    bool operator!=(const Time& other) const {
+        return getTotalMinutes() != other.getTotalMinutes();
+    }
+
+    Time operator+(int minutesToAdd) const {
+        return Time(0, getTotalMinutes() + minutesToAdd);
+    }
+
+    Time operator-(int minutesToSubtract) const {
+        return Time(0, getTotalMinutes() - minutesToSubtract);
+    }
+
+    int operator-(const Time& other) const {
+        return getTotalMinutes() - other.getTotalMinutes();
+    }
+
+    friend std::ostream& operator<<(std::ostream& os, const Time& time) {
+        os << (time.hours < 10 ? "0" : "") << time.hours << ":"
+           << (time.minutes < 10 ? "0" : "") << time.minutes;
+        return os;
+    }
+
+    friend std::istream& operator>>(std::istream& is, Time& time) {
+        std::string timeStr;
+        is >> timeStr;
+        time = Time(timeStr);
+        return is;
+    }
+
+    std::string serialize() const {
+        return (hours < 10 ? "0" : "") + std::to_string(hours) + ":" +
+               (minutes < 10 ? "0" : "") + std::to_string(minutes);
+    }
+
+    static Time deserialize(const std::string& data) {
+        return Time(data);
+    }
+};
+
+// Вперед объявления для транспортных средств
+class Bus;
+class Tram;
+class Trolleybus;
+
+// Базовый класс для транспортного средства
+class Vehicle : public RegisteredEntity {
+protected:
+    std::string type;
+    std::string model;
+    std::string licensePlate;
+public:
+    static constexpr MemoryComponent MEMORY_COMPONENT = MemoryComponent::Vehicles; // для makePooled
+
+    Vehicle(const std::string& t, const std::string& m, const std::string& lp)
+        : type(t), model(m), licensePlate(lp) {}
+
+    virtual ~Vehicle() = default;
+
+    std::string getInfo() const {
+        return type + " " + model + " " + licensePlate;
+    }
+
+    const std::string& getType() const { return type; }
+    const std::string& getModel() const { return model; }
+    const std::string& getLicensePlate() const { return licensePlate; }
+
+    virtual std::string serialize() const {
+        return type + "|" + model + "|" + licensePlate;
+    }
+
+    static std::shared_ptr<Vehicle> deserialize(const std::string& data) {
+        std::istringstream ss(data);
+        std::string type, model, licensePlate;
+        std::getline(ss, type, '|');
+        std::getline(ss, model, '|');
+        std::getline(ss, licensePlate);
+
+        // Используем фабричный метод для создания объектов
+        // Создание объектов будет выполнено в DataManager
+        throw TransportException("Используйте DataManager для создания транспортных средств");
+    }
+};
+
+// Классы конкретных транспортных средств
+class Bus : public Vehicle {
+public:
+    Bus(const std::string& m, const std::string& lp)
+        : Vehicle("Автобус", m, lp) {}
+};
+
+class Tram : public Vehicle {
+public:
+    Tram(const std::string& m, const std::string& lp)
+        : Vehicle("Трамвай", m, lp) {}
+};
+
+class Trolleybus : public Vehicle {
+public:
+    Trolleybus(const std::string& m, const std::string& lp)
+        : Vehicle("Троллейбус", m, lp) {}
+};
+
+// Класс водителя
+class Driver : public RegisteredEntity {
+private:
+    std::string firstName;
+    std::string lastName;
+    std::string middleName;
+public:
+    static constexpr MemoryComponent MEMORY_COMPONENT = MemoryComponent::Drivers; // для makePooled
+
+    Driver(const std::string& fname, const std::string& lname, const std::string& mname = "")
+        : firstName(fname), lastName(lname), middleName(mname) {}
+
+    std::string getFullName() const {
+        return lastName + " " + firstName + (middleName.empty() ? "" : " " + middleName);
+    }
+
+    std::string getFirstName() const { return firstName; }
+    std::string getLastName() const { return lastName; }
+    std::string getMiddleName() const { return middleName; }
+
+    bool operator==(const Driver& other) const {
+        return firstName == other.firstName &&
+               lastName == other.lastName &&
+               middleName == other.middleName;
+    }
+
+    std::string serialize() const {
+        return firstName + "|" + lastName + "|" + middleName;
+    }
+
+    static std::shared_ptr<Driver> deserialize(const std::string& data) {
+        std::istringstream ss(data);
+        std::string firstName, lastName, middleName;
+        std::getline(ss, firstName, '|');
+        std::getline(ss, lastName, '|');
+        std::getline(ss, middleName);
+        return makePooled<Driver>(firstName, lastName, middleName);
+    }
+};
+
+class Route : public RegisteredEntity {
+private:
+    int number;
+    std::string vehicleType;
+    std::string startStop;
+    std::string endStop;
+    std::vector<std::string> allStops;
+
+public:
+    static constexpr MemoryComponent MEMORY_COMPONENT = MemoryComponent::Routes; // для makePooled
+
+    Route(int num, const std::string& vType, const std::vector<std::string>& stops)
+        : number(num), vehicleType(vType), allStops(stops) {
+        if (stops.empty()) {
+            throw TransportException("Маршрут не может быть пустым");
+        }
+        startStop = stops.front();
+        endStop = stops.back();
+    }
+
+    bool containsStop(const std::string& stop) const {
+        return std::find(allStops.begin(), allStops.end(), stop) != allStops.end();
+    }
+
+    int getStopPosition(const std::string& stop) const {
+        auto it = std::find(allStops.begin(), allStops.end(), stop);
+        if (it != allStops.end()) {
+            return static_cast<int>(std::distance(allStops.begin(), it));
+        }
+        return -1;
+    }
+
+    bool isStopBefore(const std::string& stopA, const std::string& stopB) const {
+        int posA = getStopPosition(stopA);
+        int posB = getStopPosition(stopB);
+        return posA != -1 && posB != -1 && posA < posB;
+    }
+
+    int getNumber() const { return number; }
+    const std::string& getVehicleType() const { return vehicleType; }
+    const std::string& getStartStop() const { return startStop; }
+    const std::string& getEndStop() const { return endStop; }
+    const std::vector<std::string>& getAllStops() const { return allStops; }
+
+    std::string serialize() const {
+        std::string result = std::to_string(number) + "|" + vehicleType + "|";
+        for (size_t i = 0; i < allStops.size(); ++i) {
+            result += allStops[i];
+            if (i < allStops.size() - 1) result += ";";
+        }
+        return result;
+    }
+
+    static std::shared_ptr<Route> deserialize(const std::string& data) {
+        std::istringstream ss(data);
+        std::string numberStr, vehicleType, stopsStr;
+        std::getline(ss, numberStr, '|');
+        std::getline(ss, vehicleType, '|');
+        std::getline(ss, stopsStr);
+
+        std::vector<std::string> stops;
+        std::istringstream stopsStream(stopsStr);
+        std::string stop;
+        while (std::getline(stopsStream, stop, ';')) {
+            stops.push_back(stop);
+        }
+
+        return makePooled<Route>(std::stoi(numberStr), vehicleType, stops);
+    }
+};
+
+// Дата обслуживания (число дней от эпохи)
+using ServiceDate = std::chrono::sys_days;
+
+// Календарь обслуживания: дни недели в пределах периода плюс отдельные даты-исключения.
+// Действующие дни периода хранятся битовой маской, проверка дня - один битовый тест
+class ServiceCalendar {
+private:
+    int calendarId;
+    std::string name;
+    std::uint8_t weekdayMask;  // бит 0 - понедельник, ..., бит 6 - воскресенье
+    ServiceDate startDate;
+    ServiceDate endDate;
+    CountedSet<ServiceDate, MemoryComponent::Calendars> addedDates;    // дополнительные дни обслуживания
+    CountedSet<ServiceDate, MemoryComponent::Calendars> removedDates;  // отмененные дни
+    std::vector<std::uint64_t> activeDays; // бит на каждый день периода
+
+    std::size_t dayIndex(ServiceDate date) const {
+        return static_cast<std::size_t>((date - startDate).count());
+    }
+
+    void setDay(ServiceDate date, bool active) {
+        std::size_t index = dayIndex(date);
+        std::uint64_t bit = std::uint64_t{1} << (index % 64);
+        if (active) {
+            activeDays[index / 64] |= bit;
+        } else {
+            activeDays[index / 64] &= ~bit;
+        }
+    }
+
+    void rebuild() {
+        std::size_t dayCount = dayIndex(endDate) + 1;
+        activeDays.assign((dayCount + 63) / 64, 0);
+        for (ServiceDate date = startDate; date <= endDate; date += std::chrono::days(1)) {
+            unsigned weekday = std::chrono::weekday(date).iso_encoding() - 1;
+            if (weekdayMask & (1u << weekday)) {
+                setDay(date, true);
+            }
+        }
+        for (ServiceDate date : addedDates) setDay(date, true);
+        for (ServiceDate date : removedDates) setDay(date, false);
+    }
+
+public:
+    ServiceCalendar(int id, std::string calendarName, std::uint8_t mask, ServiceDate start, ServiceDate end)
+        : calendarId(id), name(std::move(calendarName)), weekdayMask(mask), startDate(start), endDate(end) {
+        if (id <= 0) {
+            throw TransportException("ID календаря должен быть положительным");
+        }
+        if (end < start) {
+            throw TransportException("Дата окончания календаря раньше даты начала");
+        }
+        rebuild();
+    }
+
+    // Исключение: active = true добавляет день обслуживания, false - отменяет
+    void addException(ServiceDate date, bool active) {
+        if (date < startDate || date > endDate) {
+            throw TransportException("Дата " + formatDate(date) + " вне периода календаря");
+        }
+        (active ? addedDates : removedDates).insert(date);
+        (active ? removedDates : addedDates).erase(date);
+        setDay(date, active);
+    }
+
+    bool isActive(ServiceDate date) const {
+        if (date < startDate || date > endDate) return false;
+        std::size_t index = dayIndex(date);
+        return (activeDays[index / 64] >> (index % 64)) & 1;
+    }
+
+    // Есть ли день, в который действуют оба календаря (проверяется общая часть периодов)
+    bool sharesDayWith(const ServiceCalendar& other) const {
+        ServiceDate first = std::max(startDate, other.startDate);
+        ServiceDate last = std::min(endDate, other.endDate);
+        for (ServiceDate date = first; date <= last; date += std::chrono::days(1)) {
+            if (isActive(date) && other.isActive(date)) return true;
+        }
+        return false;
+    }
+
+    int getCalendarId() const { return calendarId; }
+    const std::string& getName() const { return name; }
+    std::uint8_t getWeekdayMask() const { return weekdayMask; }
+    ServiceDate getStartDate() const { return startDate; }
+    ServiceDate getEndDate() const { return endDate; }
+    std::size_t getExceptionCount() const { return addedDates.size() + removedDates.size(); }
+    const CountedSet<ServiceDate, MemoryComponent::Calendars>& getAddedDates() const { return addedDates; }
+    const CountedSet<ServiceDate, MemoryComponent::Calendars>& getRemovedDates() const { return removedDates; }
+
+    std::size_t getMemoryBytes() const {
+        return ComponentMemory::stringBytes(name) + activeDays.capacity() * sizeof(std::uint64_t);
+    }
+
+    // Формат даты: ГГГГ-ММ-ДД
+    static ServiceDate parseDate(const std::string& text) {
+        std::istringstream ss(text);
+        int year;
+        unsigned month, day;
+        char firstDash, secondDash;
+        if (!(ss >> year >> firstDash >> month >> secondDash >> day) ||
+            firstDash != '-' || secondDash != '-' || !ss.eof()) {
+            throw TransportException("Неверный формат даты: " + text);
+        }
+        std::chrono::year_month_day date{std::chrono::year(year), std::chrono::month(month), std::chrono::day(day)};
+        if (!date.ok()) {
+            throw TransportException("Несуществующая дата: " + text);
+        }
+        return ServiceDate(date);
+    }
+
+    static std::string formatDate(ServiceDate date) {
+        std::chrono::year_month_day ymd(date);
+        std::ostringstream ss;
+        ss << std::setfill('0') << std::setw(4) << static_cast<int>(ymd.year()) << '-'
+           << std::setw(2) << static_cast<unsigned>(ymd.month()) << '-'
+           << std::setw(2) << static_cast<unsigned>(ymd.day());
+        return ss.str();
+    }
+
+    // То же в буфер не короче 16 символов, без потоков и выделений памяти; возвращает конец записи
+    static char* formatDate(char* out, ServiceDate date) {
+        std::chrono::year_month_day ymd(date);
+        int year = static_cast<int>(ymd.year());
+        if (year >= 0 && year <= 9999) {
+            std::memcpy(out, Time::DIGIT_PAIRS.data() + 2 * (year / 100), 2);
+            std::memcpy(out + 2, Time::DIGIT_PAIRS.data() + 2 * (year % 100), 2);
+            out += 4;
+        } else {
+            out = std::to_chars(out, out + 8, year).ptr;
+        }
+        for (unsigned part : {static_cast<unsigned>(ymd.month()), static_cast<unsigned>(ymd.day())}) {
+            *out++ = '-';
+            std::memcpy(out, Time::DIGIT_PAIRS.data() + 2 * part, 2);
+            out += 2;
+        }
+        return out;
+    }
+
+    // Маска дней недели строкой из семи символов 0/1, начиная с понедельника
+    static std::uint8_t parseWeekdayMask(const std::string& text) {
+        if (text.size() != 7 || text.find_first_not_of("01") != std::string::npos) {
+            throw TransportException("Маска дней недели должна состоять из 7 символов 0/1: " + text);
+        }
+        std::uint8_t mask = 0;
+        for (std::size_t i = 0; i < 7; ++i) {
+            if (text[i] == '1') mask |= static_cast<std::uint8_t>(1u << i);
+        }
+        return mask;
+    }
+
+    std::string formatWeekdayMask() const {
+        std::string result;
+        for (unsigned i = 0; i < 7; ++i) {
+            result += (weekdayMask & (1u << i)) ? '1' : '0';
+        }
+        return result;
+    }
+
+    // id|название|маска|начало|конец|добавленные даты через ;|отмененные даты через ;
+    std::string serialize() const {
+        std::string result = std::to_string(calendarId) + "|" + name + "|" + formatWeekdayMask() + "|" +
+                             formatDate(startDate) + "|" + formatDate(endDate) + "|";
+        for (auto it = addedDates.begin(); it != addedDates.end(); ++it) {
+            result += (it != addedDates.begin() ? ";" : "") + formatDate(*it);
+        }
+        result += "|";
+        for (auto it = removedDates.begin(); it != removedDates.end(); ++it) {
+            result += (it != removedDates.begin() ? ";" : "") + formatDate(*it);
+        }
+        return result;
+    }
+
+    static ServiceCalendar deserialize(const std::string& data) {
+        std::istringstream ss(data);
+        std::string idStr, calendarName, maskStr, startStr, endStr, addedStr, removedStr;
+        std::getline(ss, idStr, '|');
+        std::getline(ss, calendarName, '|');
+        std::getline(ss, maskStr, '|');
+        std::getline(ss, startStr, '|');
+        std::getline(ss, endStr, '|');
+        std::getline(ss, addedStr, '|');
+        std::getline(ss, removedStr);
+
+        ServiceCalendar calendar(std::stoi(idStr), calendarName, parseWeekdayMask(maskStr),
+                                 parseDate(startStr), parseDate(endStr));
+        std::string date;
+        std::istringstream addedStream(addedStr);
+        while (std::getline(addedStream, date, ';')) {
+            calendar.addException(parseDate(date), true);
+        }
+        std::istringstream removedStream(removedStr);
+        while (std::getline(removedStream, date, ';')) {
+            calendar.addException(parseDate(date), false);
+        }
+        return calendar;
+    }
+};
+
+// Интервал занятости в минутах от начала суток (конец может выходить за 24:00).
+// Интервалы пересекаются, только если их календари действуют хотя бы в один общий день
+struct BusyInterval {
+    int start;
+    int end;
+    int tripId;
+    int calendarId = 0; // 0 - рейс выполняется ежедневно
+};
+
+// Вперед объявление для TransportSystem
+class TransportSystem;
+
+// Профиль хода рейса: смещения прибытий от отправления по позициям остановок маршрута.
+// Рейсы одного маршрута с одинаковыми смещениями делят один профиль, а сами хранят
+// только время отправления
+class TripPattern {
+public:
+    static constexpr int NO_STOP = -1; // остановка не обслуживается рейсом
+
+private:
+    std::shared_ptr<Route> route;
+    std::vector<int> offsets;
+
+public:
+    TripPattern(std::shared_ptr<Route> r, std::vector<int> stopOffsets)
+        : route(std::move(r)), offsets(std::move(stopOffsets)) {}
+
+    const std::shared_ptr<Route>& getRoute() const { return route; }
+    const std::vector<int>& getOffsets() const { return offsets; }
+    int getOffset(std::size_t position) const { return offsets[position]; }
+
+    int getDuration() const {
+        int duration = 0;
+        for (int offset : offsets) duration = std::max(duration, offset);
+        return duration;
+    }
+
+    bool sameProfile(const TripPattern& other) const {
+        return route == other.route && offsets == other.offsets;
+    }
+
+    std::size_t hash() const {
+        std::size_t result = std::hash<const Route*>()(route.get());
+        for (int offset : offsets) {
+            result = result * 1000003u ^ static_cast<std::size_t>(offset + 1);
+        }
+        return result;
+    }
+
+    // Сам профиль со счетчиками ссылок учитывает аллокатор компонента TripPatterns
+    std::size_t getMemoryBytes() const {
+        return offsets.capacity() * sizeof(int);
+    }
+};
+
+// Класс рейса
+class Trip : public RegisteredEntity {
+private:
+    int tripId;
+    std::shared_ptr<Route> route;
+    std::shared_ptr<Vehicle> vehicle;
+    std::shared_ptr<Driver> driver;
+    Time startTime;
+    std::shared_ptr<const TripPattern> pattern; // профиль хода, nullptr - расписание не рассчитано
+    int calendarId = 0; // календарь обслуживания, 0 - рейс выполняется ежедневно
+
+    static int offsetFrom(const Time& start, const Time& time) {
+        return ((time - start) % 1440 + 1440) % 1440;
+    }
+
+public:
+    static constexpr MemoryComponent MEMORY_COMPONENT = MemoryComponent::Trips; // для makePooled
+
+    Trip(int id, std::shared_ptr<Route> r, std::shared_ptr<Vehicle> v,
+         std::shared_ptr<Driver> d, const Time& start)
+        : tripId(id), route(std::move(r)), vehicle(std::move(v)),
+          driver(std::move(d)), startTime(start) {}
+
+    // Смещение прибытия от отправления рейса
+    int offsetOf(const Time& time) const { return offsetFrom(startTime, time); }
+
+    // Профиль общий для нескольких рейсов, поэтому изменение расписания создает новый.
+    // Смещения по позициям остановок маршрута, NO_STOP - остановка пропускается
+    void setArrivalOffsets(std::vector<int> offsets) {
+        if (offsets.size() != route->getAllStops().size()) {
+            throw TransportException("Число смещений прибытия не совпадает с числом остановок маршрута");
+        }
+        pattern = std::allocate_shared<const TripPattern>(CountingAllocator<TripPattern, MemoryComponent::TripPatterns>(),
+                                                          route, std::move(offsets));
+    }
+
+    // Прибытия на все остановки маршрута по порядку
+    void setArrivalTimes(const std::vector<Time>& arrivals) {
+        if (arrivals.size() != route->getAllStops().size()) {
+            throw TransportException("Число времен прибытия не совпадает с числом остановок маршрута");
+        }
+        std::vector<int> offsets;
+        offsets.reserve(arrivals.size());
+        for (const Time& time : arrivals) {
+            offsets.push_back(offsetFrom(startTime, time));
+        }
+        setArrivalOffsets(std::move(offsets));
+    }
+
+    // Замена профиля равным ему общим экземпляром (см. TripPatternIndex)
+    void sharePattern(std::shared_ptr<const TripPattern> shared) {
+        if (!pattern || !shared || !pattern->sameProfile(*shared)) {
+            throw TransportException("Профиль хода не совпадает с расписанием рейса");
+        }
+        pattern = std::move(shared);
+    }
+
+    const std::shared_ptr<const TripPattern>& getPattern() const { return pattern; }
+
+    std::optional<Time> getArrivalAt(std::size_t position) const {
+        if (!pattern || pattern->getOffset(position) == TripPattern::NO_STOP) {
+            return std::nullopt;
+        }
+        return startTime + pattern->getOffset(position);
+    }
+
+    Time getArrivalTime(const std::string& stop) const {
+        int position = route->getStopPosition(stop);
+        if (position != -1) {
+            if (auto time = getArrivalAt(position)) {
+                return *time;
+            }
+        }
+        throw TransportException("Остановка не найдена в расписании рейса");
+    }
+
+    bool hasStop(const std::string& stop) const {
+        int position = route->getStopPosition(stop);
+        return position != -1 && getArrivalAt(position).has_value();
+    }
+
+    // Обход прибытий в порядке маршрута: callback(остановка, время)
+    template<typename Callback>
+    void forEachArrival(Callback callback) const {
+        if (!pattern) return;
+        const auto& stopsList = route->getAllStops();
+        for (std::size_t i = 0; i < stopsList.size(); ++i) {
+            if (pattern->getOffset(i) != TripPattern::NO_STOP) {
+                callback(stopsList[i], startTime + pattern->getOffset(i));
+            }
+        }
+    }
+
+    int getTripId() const { return tripId; }
+    const std::shared_ptr<Route>& getRoute() const { return route; }
+    const std::shared_ptr<Vehicle>& getVehicle() const { return vehicle; }
+    const std::shared_ptr<Driver>& getDriver() const { return driver; }
+    void setDriver(std::shared_ptr<Driver> d) { driver = std::move(d); }
+    int getCalendarId() const { return calendarId; }
+    void setCalendarId(int id) { calendarId = id; }
+    Time getStartTime() const { return startTime; }
+
+    // Фактическая длительность рейса: от отправления до последнего прибытия по расписанию
+    int getDurationMinutes() const {
+        if (!pattern) {
+            return 60; // Расписание еще не рассчитано - предполагаем 1 час
+        }
+        return pattern->getDuration();
+    }
+
+    Time getEstimatedEndTime() const {
+        return startTime + getDurationMinutes();
+    }
+
+    std::string serialize() const {
+        std::string result = std::to_string(tripId) + "|" + route->serialize() + "|" +
+                           vehicle->serialize() + "|" + driver->serialize() + "|" +
+                           startTime.serialize() + "|";
+
+        // Сериализация расписания
+        std::string scheduleStr;
+        forEachArrival([&scheduleStr](const std::string& stop, const Time& time) {
+            scheduleStr += stop + "=" + time.serialize() + ";";
+        });
+        if (!scheduleStr.empty()) scheduleStr.pop_back(); // Удаляем последнюю точку с запятой
+        result += scheduleStr + "|" + std::to_string(calendarId);
+
+        return result;
+    }
+
+    static std::shared_ptr<Trip> deserialize(const std::string& data, TransportSystem* system = nullptr);
+};
+
+// Шаблон рейсов с постоянным интервалом движения. Хранит только параметры
+// и смещения прибытий от отправления; отдельные рейсы вычисляются по запросу
+class TripTemplate : public RegisteredEntity {
+private:
+    int templateId;
+    std::shared_ptr<Route> route;
+    int firstDeparture;  // минуты от начала суток
+    int lastDeparture;   // может быть больше 1440, если движение идет через полночь
+    int headway;         // интервал движения, мин
+    std::vector<int> stopOffsets; // смещение прибытия на каждую остановку маршрута
+    std::vector<std::shared_ptr<Vehicle>> vehicles;
+    std::vector<std::shared_ptr<Driver>> drivers;
+    int calendarId = 0; // календарь обслуживания, 0 - ежедневно
+    int runIdBase = 0;  // начало диапазона номеров отправлений, назначает TransportSystem
+
+    // Номера отправлений, прибытие которых на остановку попадает в [from, to] (без учета суток)
+    std::pair<int, int> runRange(std::size_t stopPosition, int from, int to) const {
+        int base = firstDeparture + stopOffsets[stopPosition];
+        int firstRun = from <= base ? 0 : (from - base + headway - 1) / headway;
+        int lastRun = to < base ? -1 : std::min((to - base) / headway, getDepartureCount() - 1);
+        return {firstRun, lastRun};
+    }
+
+public:
+    static constexpr MemoryComponent MEMORY_COMPONENT = MemoryComponent::Templates; // для makePooled
+
+    TripTemplate(int id, std::shared_ptr<Route> r, const Time& first, const Time& last, int headwayMinutes,
+                 std::vector<int> offsets, std::vector<std::shared_ptr<Vehicle>> vehiclePool,
+                 std::vector<std::shared_ptr<Driver>> driverPool)
+        : templateId(id), route(std::move(r)), firstDeparture(first.getTotalMinutes()),
+          lastDeparture(last.getTotalMinutes()), headway(headwayMinutes), stopOffsets(std::move(offsets)),
+          vehicles(std::move(vehiclePool)), drivers(std::move(driverPool)) {
+        if (headway <= 0) {
+            throw TransportException("Интервал движения должен быть положительным");
+        }
+        if (!route || stopOffsets.size() != route->getAllStops().size()) {
+            throw TransportException("Смещения прибытий не соответствуют остановкам маршрута");
+        }
+        if (vehicles.empty() || drivers.empty()) {
+            throw TransportException("Шаблону нужен хотя бы один транспорт и один водитель");
+        }
+        if (lastDeparture < firstDeparture) {
+            lastDeparture += 1440; // движение через полночь
+        }
+    }
+
+    // Смещения прибытий по той же схеме, что и calculateArrivalTimes
+    static std::vector<int> makeOffsets(const Route& route, double averageSpeed) {
+        if (averageSpeed <= 0) {
+            throw TransportException("Средняя скорость должна быть положительной");
+        }
+        const double distanceBetweenStops = 1.5; // км
+        const int stopTime = 1; // минута
+        const int travel = static_cast<int>((distanceBetweenStops / averageSpeed) * 60 + 0.5);
+
+        std::vector<int> offsets(route.getAllStops().size(), 0);
+        for (std::size_t i = 1; i < offsets.size(); ++i) {
+            offsets[i] = offsets[i - 1] + (i > 1 ? stopTime : 0) + travel;
+        }
+        return offsets;
+    }
+
+    int getTemplateId() const { return templateId; }
+    const std::shared_ptr<Route>& getRoute() const { return route; }
+    Time getFirstDeparture() const { return Time(0, firstDeparture); }
+    Time getLastDeparture() const { return Time(0, lastDeparture); }
+    int getHeadway() const { return headway; }
+    int getCalendarId() const { return calendarId; }
+    void setCalendarId(int id) { calendarId = id; }
+    const std::vector<std::shared_ptr<Vehicle>>& getVehicles() const { return vehicles; }
+    const std::vector<std::shared_ptr<Driver>>& getDrivers() const { return drivers; }
+
+    int getDepartureCount() const {
+        return (lastDeparture - firstDeparture) / headway + 1;
+    }
+
+    // Номера рейсов шаблонов отрицательны: обычные рейсы имеют положительные номера,
+    // а диапазоны разных шаблонов не пересекаются
+    int getRunId(int run) const { return -(runIdBase + run) - 1; }
+    void setRunIdBase(int base) { runIdBase = base; }
+    bool ownsRunId(int tripId) const {
+        int run = -tripId - 1 - runIdBase;
+        return tripId < 0 && run >= 0 && run < getDepartureCount();
+    }
+
+    const std::shared_ptr<Vehicle>& getRunVehicle(int run) const { return vehicles[run % vehicles.size()]; }
+    const std::shared_ptr<Driver>& getRunDriver(int run) const { return drivers[run % drivers.size()]; }
+
+    // Интервал занятости отправления в той же форме, что и у обычного рейса
+    BusyInterval getRunInterval(int run) const {
+        int start = (firstDeparture + run * headway) % 1440;
+        int duration = *std::max_element(stopOffsets.begin(), stopOffsets.end());
+        return {start, start + duration, getRunId(run), calendarId};
+    }
+
+    // Прибытие отправления run на остановку (минуты без приведения к суткам)
+    int getArrivalMinutes(int run, std::size_t stopPosition) const {
+        return firstDeparture + run * headway + stopOffsets[stopPosition];
+    }
+
+    // Отправление с самым ранним прибытием на остановку не раньше from (время суток,
+    // как в индексе расписаний); -1, если таких нет
+    int firstRunFrom(std::size_t stopPosition, int from) const {
+        int best = -1;
+        for (int day = 0; day <= 1440; day += 1440) {
+            auto [firstRun, lastRun] = runRange(stopPosition, from + day, 1439 + day);
+            if (firstRun <= lastRun &&
+                (best < 0 || getArrivalMinutes(firstRun, stopPosition) % 1440 <
+                                 getArrivalMinutes(best, stopPosition) % 1440)) {
+                best = firstRun;
+            }
+        }
+        return best;
+    }
+
+    // Обход прибытий на остановку в интервале [from, to] суток, включая рейсы после полуночи
+    template<typename Callback>
+    void forEachArrival(std::size_t stopPosition, int from, int to, Callback callback) const {
+        for (int day = 0; day <= 1440; day += 1440) {
+            auto [firstRun, lastRun] = runRange(stopPosition, from + day, to + day);
+            for (int run = firstRun; run <= lastRun; ++run) {
+                callback(run, getArrivalMinutes(run, stopPosition) - day);
+            }
+        }
+    }
+
+    // Создание полноценного рейса для одного отправления (для результатов поиска)
+    std::shared_ptr<Trip> instantiate(int run) const {
+        auto trip = makePooled<Trip>(getRunId(run), route, getRunVehicle(run), getRunDriver(run),
+                                     Time(0, firstDeparture + run * headway));
+        trip->setCalendarId(calendarId);
+        std::vector<Time> arrivals;
+        arrivals.reserve(stopOffsets.size());
+        for (std::size_t i = 0; i < stopOffsets.size(); ++i) {
+            arrivals.push_back(Time(0, getArrivalMinutes(run, i)));
+        }
+        trip->setArrivalTimes(arrivals);
+        return trip;
+    }
+
+    std::size_t getMemoryBytes() const {
+        return stopOffsets.capacity() * sizeof(int) +
+               (vehicles.capacity() + drivers.capacity()) * sizeof(std::shared_ptr<void>);
+    }
+
+    // Одна строка на шаблон: id|маршрут|первое|последнее|интервал|смещения|номера ТС|водители|календарь
+    std::string serialize() const {
+        std::string result = std::to_string(templateId) + "|" + std::to_string(route->getNumber()) + "|" +
+                             getFirstDeparture().serialize() + "|" + getLastDeparture().serialize() + "|" +
+                             std::to_string(headway) + "|";
+        for (std::size_t i = 0; i < stopOffsets.size(); ++i) {
+            result += (i > 0 ? ";" : "") + std::to_string(stopOffsets[i]);
+        }
+        result += "|";
+        for (std::size_t i = 0; i < vehicles.size(); ++i) {
+            result += (i > 0 ? ";" : "") + vehicles[i]->getLicensePlate();
+        }
+        result += "|";
+        for (std::size_t i = 0; i < drivers.size(); ++i) {
+            result += (i > 0 ? ";" : "") + drivers[i]->getFirstName() + "," +
+                      drivers[i]->getLastName() + "," + drivers[i]->getMiddleName();
+        }
+        result += "|" + std::to_string(calendarId);
+        return result;
+    }
+
+    static std::shared_ptr<TripTemplate> deserialize(const std::string& data, const TransportSystem& system);
+};
+
+// Класс для хранения информации о поездке с пересадками
+// Пеший участок поездки: выполняется перед рейсом с индексом beforeTrip
+// (beforeTrip == число рейсов - после последнего рейса)
+struct WalkingLeg {
+    std::string from;
+    std::string to;
+    int minutes;
+    std::size_t beforeTrip;
+};
+
+class Journey {
+private:
+    std::vector<std::shared_ptr<Trip>> trips; // Рейсы, составляющие поездку
+    std::vector<std::string> transferPoints; // Точки пересадок
+    std::vector<WalkingLeg> walkingLegs; // Пешие переходы между остановками
+    Time startTime;
+    Time endTime;
+    int transferCount;
+
+public:
+    Journey(const std::vector<std::shared_ptr<Trip>>& tripList,
+            const std::vector<std::string>& transfers,
+            Time start, Time end,
+            std::vector<WalkingLeg> walks = {})
+        : trips(tripList), transferPoints(transfers), walkingLegs(std::move(walks)),
+          startTime(start), endTime(end),
+          transferCount(static_cast<int>(transfers.size())) {}
+
+    int getTotalDuration() const {
+        return endTime - startTime;
+    }
+
+    int getTransferCount() const { return transferCount; }
+    Time getStartTime() const { return startTime; }
+    Time getEndTime() const { return endTime; }
+    const std::vector<std::shared_ptr<Trip>>& getTrips() const { return trips; }
+    const std::vector<std::string>& getTransferPoints() const { return transferPoints; }
+    const std::vector<WalkingLeg>& getWalkingLegs() const { return walkingLegs; }
+};
+
+// Статистика выделений памяти последнего запроса планировщика
+struct PlannerQueryStats {
+    std::size_t allocations = 0;
+    std::size_t allocatedBytes = 0;
+    std::size_t expandedNodes = 0;
+};
+
+// Класс планировщика поездок
+class JourneyPlanner {
+private:
+    TransportSystem* system;
+    mutable PlannerQueryStats lastQueryStats;
+
+public:
+    JourneyPlanner(TransportSystem* sys) : system(sys) {}
+
+    // Без даты учитываются все рейсы, с датой - только действующие в этот день
+    std::vector<Journey> findJourneysWithTransfers(const std::string& startStop,
+                                                   const std::string& endStop,
+                                                   const Time& departureTime,
+                                                   int maxTransfers = 2,
+                                                   std::optional<ServiceDate> date = std::nullopt) const;
+
+    Journey findFastestJourney(const std::string& startStop,
+                               const std::string& endStop,
+                               const Time& departureTime,
+                               std::optional<ServiceDate> date = std::nullopt);
+
+    Journey findJourneyWithLeastTransfers(const std::string& startStop,
+                                          const std::string& endStop,
+                                          const Time& departureTime,
+                                          std::optional<ServiceDate> date = std::nullopt);
+
+    const PlannerQueryStats& getLastQueryStats() const { return lastQueryStats; }
+};
+
+// Интервалы, упорядоченные по началу, с префиксным максимумом концов:
+// проверка пересечения с отрезком выполняется за O(log n)
+class IntervalIndex {
+private:
+    std::vector<BusyInterval> intervals;
+    std::vector<int> prefixMaxEnd;
+    int totalMinutes = 0;
+
+    void rebuildPrefixFrom(std::size_t pos) {
+        prefixMaxEnd.resize(intervals.size());
+        for (std::size_t i = pos; i < intervals.size(); ++i) {
+            int previous = i > 0 ? prefixMaxEnd[i - 1] : std::numeric_limits<int>::min();
+            prefixMaxEnd[i] = std::max(previous, intervals[i].end);
+        }
+    }
+
+    // Число интервалов, начинающихся не позже time
+    std::size_t countStartingBy(int time) const {
+        return static_cast<std::size_t>(
+            std::upper_bound(intervals.begin(), intervals.end(), time,
+                             [](int t, const BusyInterval& interval) { return t < interval.start; }) -
+            intervals.begin());
+    }
+
+public:
+    void insert(const BusyInterval& interval) {
+        auto it = std::upper_bound(intervals.begin(), intervals.end(), interval.start,
+                                   [](int t, const BusyInterval& other) { return t < other.start; });
+        std::size_t pos = static_cast<std::size_t>(it - intervals.begin());
+        intervals.insert(it, interval);
+        totalMinutes += interval.end - interval.start;
+        rebuildPrefixFrom(pos);
+    }
+
+    // Пакетная вставка: новые интервалы сортируются и сливаются с имеющимися за один проход
+    void insertAll(std::vector<BusyInterval> added) {
+        if (added.empty()) return;
+        std::stable_sort(added.begin(), added.end(),
+                         [](const BusyInterval& a, const BusyInterval& b) { return a.start < b.start; });
+        std::size_t pos = countStartingBy(added.front().start);
+        std::size_t middle = intervals.size();
+        for (const auto& interval : added) {
+            totalMinutes += interval.end - interval.start;
+        }
+        intervals.insert(intervals.end(), added.begin(), added.end());
+        std::inplace_merge(intervals.begin() + static_cast<std::ptrdiff_t>(pos),
+                           intervals.begin() + static_cast<std::ptrdiff_t>(middle), intervals.end(),
+                           [](const BusyInterval& a, const BusyInterval& b) { return a.start < b.start; });
+        rebuildPrefixFrom(pos);
+    }
+
+    bool remove(int tripId) {
+        auto it = std::find_if(intervals.begin(), intervals.end(),
+                               [tripId](const BusyInterval& interval) { return interval.tripId == tripId; });
+        if (it == intervals.end()) return false;
+        std::size_t pos = static_cast<std::size_t>(it - intervals.begin());
+        totalMinutes -= it->end - it->start;
+        intervals.erase(it);
+        rebuildPrefixFrom(pos);
+        return true;
+    }
+
+    // Удаление всех подходящих интервалов за один проход
+    template<typename Predicate>
+    std::size_t removeIf(Predicate predicate) {
+        auto first = std::find_if(intervals.begin(), intervals.end(), predicate);
+        if (first == intervals.end()) return 0;
+        std::size_t pos = static_cast<std::size_t>(first - intervals.begin());
+        auto last = std::remove_if(first, intervals.end(), [&](const BusyInterval& interval) {
+            if (!predicate(interval)) return false;
+            totalMinutes -= interval.end - interval.start;
+            return true;
+        });
+        std::size_t removed = static_cast<std::size_t>(intervals.end() - last);
+        intervals.erase(last, intervals.end());
+        rebuildPrefixFrom(pos);
+        return removed;
+    }
+
+    // Первый найденный интервал, пересекающийся с [start, end] (границы включительно)
+    const BusyInterval* findOverlap(int start, int end, int ignoreTripId = -1) const {
+        return findOverlapExcept(start, end, [ignoreTripId](const BusyInterval& interval) {
+            return interval.tripId == ignoreTripId;
+        });
+    }
+
+    // То же с пропуском интервалов, для которых ignore(интервал) истинно
+    template<typename Predicate>
+    const BusyInterval* findOverlapExcept(int start, int end, Predicate ignore) const {
+        for (std::size_t i = countStartingBy(end); i-- > 0 && prefixMaxEnd[i] >= start; ) {
+            if (intervals[i].end >= start && !ignore(intervals[i])) {
+                return &intervals[i];
+            }
+        }
+        return nullptr;
+    }
+
+    bool overlaps(int start, int end) const {
+        std::size_t count = countStartingBy(end);
+        return count > 0 && prefixMaxEnd[count - 1] >= start;
+    }
+
+    // Все пары пересекающихся интервалов за один проход: каждый интервал сравнивается
+    // со всеми активными, которые еще не закончились к его началу (O(n + k), k - число пар)
+    std::vector<std::pair<const BusyInterval*, const BusyInterval*>> findAllOverlaps() const {
+        std::vector<std::pair<const BusyInterval*, const BusyInterval*>> result;
+        std::vector<const BusyInterval*> active;
+        for (const auto& interval : intervals) {
+            std::erase_if(active, [&interval](const BusyInterval* other) { return other->end < interval.start; });
+            for (const BusyInterval* other : active) {
+                result.push_back({other, &interval});
+            }
+            active.push_back(&interval);
+        }
+        return result;
+    }
+
+    int getTotalMinutes() const { return totalMinutes; }
+    std::size_t size() const { return intervals.size(); }
+    bool empty() const { return intervals.empty(); }
+    const std::vector<BusyInterval>& getIntervals() const { return intervals; }
+
+    std::size_t getMemoryBytes() const {
+        return intervals.capacity() * sizeof(BusyInterval) + prefixMaxEnd.capacity() * sizeof(int);
+    }
+};
+
+// Нарушение в графике водителя
+struct DriverViolation {
+    enum class Kind { Overlap, WorkingHours };
+
+    EntityHandle driver;
+    Kind kind;
+    int firstTripId;
+    int secondTripId;   // для пересечения рейсов
+    int minutes;        // суммарное рабочее время для нарушения нормы
+};
+
+// Класс для управления графиком водителей
+class DriverSchedule {
+private:
+    // Рейсы водителя и их интервалы занятости по фактическому расписанию
+    struct DriverTimeline {
+        std::vector<std::shared_ptr<Trip>> trips;
+        IntervalIndex busy;
+    };
+
+    // Ключ - дескриптор водителя, а не shared_ptr: без хеширования указателей и счетчиков ссылок
+    CountedHashMap<EntityHandle, DriverTimeline, MemoryComponent::DriverSchedule> driverTrips;
+    const int MAX_WORKING_HOURS = 12 * 60; // 12 часов в минутах
+
+    static EntityHandle requireHandle(const std::shared_ptr<Driver>& driver) {
+        if (!driver || !driver->isRegistered()) {
+            throw TransportException("Водитель не зарегистрирован в системе!");
+        }
+        return driver->getHandle();
+    }
+
+    static BusyInterval makeInterval(const Trip& trip) {
+        int start = trip.getStartTime().getTotalMinutes();
+        return {start, start + trip.getDurationMinutes(), trip.getTripId(), trip.getCalendarId()};
+    }
+
+    static int toMinutesRange(const Time& startTime, const Time& endTime, int& start) {
+        start = startTime.getTotalMinutes();
+        int end = endTime.getTotalMinutes();
+        return end < start ? end + 1440 : end; // интервал через полночь
+    }
+
+    void validateDriver(EntityHandle handle, const DriverTimeline& timeline,
+                        std::vector<DriverViolation>& out) const {
+        for (const auto& [first, second] : timeline.busy.findAllOverlaps()) {
+            out.push_back({handle, DriverViolation::Kind::Overlap,
+                           first->tripId, second->tripId, 0});
+        }
+        if (timeline.busy.getTotalMinutes() > MAX_WORKING_HOURS) {
+            out.push_back({handle, DriverViolation::Kind::WorkingHours,
+                           -1, -1, timeline.busy.getTotalMinutes()});
+        }
+    }
+
+public:
+    // Обмен графиками с другим экземпляром (при замене данных системы)
+    void swap(DriverSchedule& other) {
+        driverTrips.swap(other.driverTrips);
+    }
+
+    void assignTripToDriver(const std::shared_ptr<Driver>& driver,
+                           std::shared_ptr<Trip> trip) {
+        auto& timeline = driverTrips[requireHandle(driver)];
+        timeline.busy.insert(makeInterval(*trip));
+        timeline.trips.push_back(std::move(trip));
+    }
+
+    // Пакетное назначение: интервалы каждого водителя вставляются одним слиянием
+    void assignTrips(const std::vector<std::shared_ptr<Trip>>& added) {
+        std::unordered_map<EntityHandle, std::vector<BusyInterval>> incoming;
+        for (const auto& trip : added) {
+            EntityHandle handle = requireHandle(trip->getDriver());
+            driverTrips[handle].trips.push_back(trip);
+            incoming[handle].push_back(makeInterval(*trip));
+        }
+        for (auto& [handle, intervals] : incoming) {
+            driverTrips[handle].busy.insertAll(std::move(intervals));
+        }
+    }
+
+    void removeTripFromDriver(const std::shared_ptr<Driver>& driver, int tripId) {
+        auto it = driverTrips.find(requireHandle(driver));
+        if (it == driverTrips.end()) return;
+
+        auto& trips = it->second.trips;
+        auto found = std::find_if(trips.begin(), trips.end(),
+            [tripId](const auto& trip) {
+                return trip->getTripId() == tripId;
+            });
+        if (found != trips.end()) {
+            *found = std::move(trips.back());
+            trips.pop_back();
+        }
+        it->second.busy.remove(tripId);
+
+        if (trips.empty()) {
+            driverTrips.erase(it);
+        }
+    }
+
+    // Пакетное снятие рейсов: каждый затронутый водитель обрабатывается один раз
+    void removeTrips(const std::vector<std::shared_ptr<Trip>>& removed, const HandleSet& removedHandles) {
+        std::vector<EntityHandle> affected;
+        for (const auto& trip : removed) {
+            affected.push_back(trip->getDriver()->getHandle());
+        }
+        std::sort(affected.begin(), affected.end());
+        affected.erase(std::unique(affected.begin(), affected.end()), affected.end());
+
+        for (EntityHandle handle : affected) {
+            auto it = driverTrips.find(handle);
+            if (it == driverTrips.end()) continue;
+
+            auto& timeline = it->second;
+            std::unordered_set<int> removedIds;
+            timeline.trips.erase(std::remove_if(timeline.trips.begin(), timeline.trips.end(),
+                [&](const auto& trip) {
+                    if (!removedHandles.contains(trip->getHandle())) return false;
+                    removedIds.insert(trip->getTripId());
+                    return true;
+                }), timeline.trips.end());
+            timeline.busy.removeIf([&](const BusyInterval& interval) {
+                return removedIds.count(interval.tripId) > 0;
+            });
+
+            if (timeline.trips.empty()) {
+                driverTrips.erase(it);
+            }
+        }
+    }
+
+    // Пересчет интервала после изменения расписания рейса
+    void refreshTrip(const Trip& trip) {
+        auto it = driverTrips.find(trip.getDriver()->getHandle());
+        if (it == driverTrips.end()) return;
+        if (it->second.busy.remove(trip.getTripId())) {
+            it->second.busy.insert(makeInterval(trip));
+        }
+    }
+
+    // Рейс водителя, пересекающийся с [start, end], кроме пропускаемых ignore;
+    // nullptr, если водитель свободен
+    template<typename Predicate>
+    const BusyInterval* findOverlapExcept(EntityHandle driver, int start, int end, Predicate ignore) const {
+        auto it = driverTrips.find(driver);
+        return it != driverTrips.end() ? it->second.busy.findOverlapExcept(start, end, ignore) : nullptr;
+    }
+
+    bool isDriverAvailable(const std::shared_ptr<Driver>& driver,
+                          const Time& startTime,
+                          const Time& endTime) const {
+        auto it = driverTrips.find(driver->getHandle());
+        if (it == driverTrips.end()) return true;
+
+        int start;
+        int end = toMinutesRange(startTime, endTime, start);
+        return !it->second.busy.overlaps(start, end);
+    }
+
+    bool checkWorkingHoursCompliance(const std::shared_ptr<Driver>& driver) const {
+        return getTotalWorkingMinutes(driver) <= MAX_WORKING_HOURS;
+    }
+
+    std::vector<std::shared_ptr<Trip>> getDriverTrips(
+        const std::shared_ptr<Driver>& driver) const {
+        auto it = driverTrips.find(driver->getHandle());
+        if (it != driverTrips.end()) {
+            return it->second.trips;
+        }
+        return {};
+    }
+
+    int getTotalWorkingMinutes(const std::shared_ptr<Driver>& driver) const {
+        auto it = driverTrips.find(driver->getHandle());
+        return it != driverTrips.end() ? it->second.busy.getTotalMinutes() : 0;
+    }
+
+    // Проверка графиков всех водителей: пересечения рейсов и превышение 12 часов.
+    // Водители распределяются между потоками динамически
+    std::vector<DriverViolation> validateAllDrivers(
+        unsigned threadCount = std::thread::hardware_concurrency()) const {
+        std::vector<std::pair<EntityHandle, const DriverTimeline*>> work;
+        work.reserve(driverTrips.size());
+        for (const auto& [handle, timeline] : driverTrips) {
+            work.push_back({handle, &timeline});
+        }
+
+        threadCount = std::max(1u, std::min<unsigned>(threadCount, static_cast<unsigned>(work.size())));
+        std::vector<std::vector<DriverViolation>> partial(threadCount);
+        std::atomic<std::size_t> next{0};
+
+        auto worker = [&](unsigned index) {
+            for (std::size_t i = next.fetch_add(1); i < work.size(); i = next.fetch_add(1)) {
+                validateDriver(work[i].first, *work[i].second, partial[index]);
+            }
+        };
+
+        std::vector<std::thread> threads;
+        for (unsigned t = 1; t < threadCount; ++t) {
+            threads.emplace_back(worker, t);
+        }
+        worker(0);
+        for (auto& thread : threads) {
+            thread.join();
+        }
+
+        std::vector<DriverViolation> violations;
+        for (auto& part : partial) {
+            violations.insert(violations.end(), part.begin(), part.end());
+        }
+        std::sort(violations.begin(), violations.end(),
+                  [](const DriverViolation& a, const DriverViolation& b) {
+                      return a.driver != b.driver ? a.driver < b.driver : a.firstTripId < b.firstTripId;
+                  });
+        return violations;
+    }
+
+    int getMaxWorkingMinutes() const { return MAX_WORKING_HOURS; }
+
+    std::size_t getMemoryBytes() const {
+        std::size_t bytes = 0;
+        for (const auto& [handle, timeline] : driverTrips) {
+            bytes += timeline.trips.capacity() * sizeof(std::shared_ptr<Trip>) +
+                     timeline.busy.getMemoryBytes();
+        }
+        return bytes;
+    }
+
+    std::size_t getDriverCount() const { return driverTrips.size(); }
+};
+
+// Назначение водителя на рейс, предложенное автоматическим распределением
+struct RosterAssignment {
+    EntityHandle trip;
+    int tripId;
+    EntityHandle driver;
+};
+
+// Результат распределения водителей
+struct RosterResult {
+    std::vector<RosterAssignment> assignments;
+    std::vector<int> unassignedTrips;   // не хватило водителей или рейс длиннее нормы
+    int greedyDriversUsed = 0;
+    int driversUsed = 0;
+    int localSearchRounds = 0;
+};
+
+// Автоматическое распределение водителей по рейсам: без пересечений,
+// с учетом нормы рабочего времени и минимальным числом задействованных водителей
+class RosteringEngine {
+private:
+    // Рейс в терминах решателя: интервал [start, end] в минутах
+    struct Task {
+        int start;
+        int end;
+        std::size_t tripIndex;
+    };
+
+    // Смена одного водителя; в IntervalIndex поле tripId хранит индекс задачи
+    struct Duty {
+        IntervalIndex busy;
+        std::vector<int> tasks;
+        bool alive = true;
+    };
+
+    using Move = std::pair<int, std::size_t>; // задача -> смена
+
+    int maxWorkingMinutes;
+    std::chrono::milliseconds timeBudget;
+    unsigned threadCount;
+
+    // Можно ли переложить все рейсы смены victim в другие смены.
+    // Рейсы, уже перенесенные в рамках плана, учитываются в planned
+    bool planMoves(const std::vector<Task>& tasks, const std::vector<Duty>& duties,
+                   std::size_t victim, std::vector<Move>& moves) const {
+        moves.clear();
+        for (int taskIndex : duties[victim].tasks) {
+            const Task& task = tasks[taskIndex];
+            std::size_t best = duties.size();
+            int bestMinutes = -1;
+
+            for (std::size_t d = 0; d < duties.size(); ++d) {
+                const Duty& duty = duties[d];
+                if (d == victim || !duty.alive) continue;
+
+                int minutes = duty.busy.getTotalMinutes();
+                bool clash = false;
+                for (const auto& [movedTask, target] : moves) {
+                    if (target != d) continue;
+                    const Task& moved = tasks[movedTask];
+                    minutes += moved.end - moved.start;
+                    clash = clash || !(moved.end < task.start || task.end < moved.start);
+                }
+
+                // Лучшее размещение - в самую загруженную подходящую смену
+                if (clash || minutes + (task.end - task.start) > maxWorkingMinutes ||
+                    minutes <= bestMinutes || duty.busy.overlaps(task.start, task.end)) {
+                    continue;
+                }
+                best = d;
+                bestMinutes = minutes;
+            }
+
+            if (best == duties.size()) return false;
+            moves.push_back({taskIndex, best});
+        }
+        return true;
+    }
+
+    // Жадный проход: рейсы по времени начала, каждый - в смену, освободившуюся
+    // последней перед его началом (best fit), иначе новая смена
+    void greedyAssign(const std::vector<Task>& tasks, std::size_t driverLimit,
+                      std::vector<Duty>& duties, std::vector<int>& unassigned) const {
+        std::vector<int> order(tasks.size());
+        for (std::size_t i = 0; i < order.size(); ++i) order[i] = static_cast<int>(i);
+        std::sort(order.begin(), order.end(), [&tasks](int a, int b) {
+            return tasks[a].start != tasks[b].start ? tasks[a].start < tasks[b].start
+                                                    : tasks[a].end < tasks[b].end;
+        });
+
+        std::multimap<int, std::size_t> freeAt; // конец последнего рейса -> смена
+        for (int taskIndex : order) {
+            const Task& task = tasks[taskIndex];
+            int duration = task.end - task.start;
+            if (duration > maxWorkingMinutes) {
+                unassigned.push_back(taskIndex);
+                continue;
+            }
+
+            auto chosen = freeAt.end();
+            for (auto it = freeAt.lower_bound(task.start); it != freeAt.begin(); ) {
+                --it;
+                if (duties[it->second].busy.getTotalMinutes() + duration <= maxWorkingMinutes) {
+                    chosen = it;
+                    break;
+                }
+            }
+
+            std::size_t duty;
+            if (chosen != freeAt.end()) {
+                duty = chosen->second;
+                freeAt.erase(chosen);
+            } else if (duties.size() < driverLimit) {
+                duty = duties.size();
+                duties.emplace_back();
+            } else {
+                unassigned.push_back(taskIndex);
+                continue;
+            }
+
+            duties[duty].busy.insert({task.start, task.end, taskIndex});
+            duties[duty].tasks.push_back(taskIndex);
+            freeAt.insert({task.end, duty});
+        }
+    }
+
+    // Локальный поиск: попытки расформировать наименее загруженные смены.
+    // Планы строятся параллельно по неизменному снимку, применяются последовательно
+    // с повторной проверкой
+    int improve(const std::vector<Task>& tasks, std::vector<Duty>& duties,
+                std::chrono::steady_clock::time_point deadline) const {
+        int rounds = 0;
+        while (std::chrono::steady_clock::now() < deadline) {
+            ++rounds;
+
+            std::vector<std::size_t> victims;
+            for (std::size_t d = 0; d < duties.size(); ++d) {
+                if (duties[d].alive) victims.push_back(d);
+            }
+            std::sort(victims.begin(), victims.end(), [&duties](std::size_t a, std::size_t b) {
+                return duties[a].busy.getTotalMinutes() < duties[b].busy.getTotalMinutes();
+            });
+
+            std::vector<std::vector<Move>> plans(victims.size());
+            std::vector<char> feasible(victims.size(), 0);
+            std::atomic<std::size_t> next{0};
+
+            auto worker = [&]() {
+                std::vector<Move> moves;
+                for (std::size_t i = next.fetch_add(1); i < victims.size(); i = next.fetch_add(1)) {
+                    if (std::chrono::steady_clock::now() >= deadline) break;
+                    if (planMoves(tasks, duties, victims[i], moves)) {
+                        plans[i] = moves;
+                        feasible[i] = 1;
+                    }
+                }
+            };
+
+            unsigned workers = std::max(1u, std::min<unsigned>(threadCount, static_cast<unsigned>(victims.size())));
+            std::vector<std::thread> threads;
+            for (unsigned t = 1; t < workers; ++t) {
+                threads.emplace_back(worker);
+            }
+            worker();
+            for (auto& thread : threads) {
+                thread.join();
+            }
+
+            int eliminated = 0;
+            for (std::size_t i = 0; i < victims.size(); ++i) {
+                if (!feasible[i]) continue;
+                std::size_t victim = victims[i];
+
+                // Снимок мог устареть: план проверяется заново на текущем состоянии
+                bool valid = true;
+                std::vector<Move> accepted;
+                for (const auto& [taskIndex, target] : plans[i]) {
+                    const Task& task = tasks[taskIndex];
+                    const Duty& duty = duties[target];
+                    int minutes = duty.busy.getTotalMinutes();
+                    for (const auto& [movedTask, movedTarget] : accepted) {
+                        if (movedTarget == target) {
+                            const Task& moved = tasks[movedTask];
+                            minutes += moved.end - moved.start;
+                            valid = valid && (moved.end < task.start || task.end < moved.start);
+                        }
+                    }
+                    valid = valid && duty.alive && target != victim &&
+                            minutes + (task.end - task.start) <= maxWorkingMinutes &&
+                            !duty.busy.overlaps(task.start, task.end);
+                    if (!valid) break;
+                    accepted.push_back({taskIndex, target});
+                }
+                if (!valid) continue;
+
+                for (const auto& [taskIndex, target] : accepted) {
+                    const Task& task = tasks[taskIndex];
+                    duties[target].busy.insert({task.start, task.end, taskIndex});
+                    duties[target].tasks.push_back(taskIndex);
+                }
+                duties[victim] = Duty();
+                duties[victim].alive = false;
+                ++eliminated;
+            }
+
+            if (eliminated == 0) break;
+        }
+        return rounds;
+    }
+
+public:
+    RosteringEngine(int maxMinutes,
+                    std::chrono::milliseconds budget = std::chrono::milliseconds(2000),
+                    unsigned threads = std::thread::hardware_concurrency())
+        : maxWorkingMinutes(maxMinutes), timeBudget(budget), threadCount(std::max(1u, threads)) {}
+
+    RosterResult solve(const std::vector<std::shared_ptr<Trip>>& trips,
+                       const std::vector<std::shared_ptr<Driver>>& drivers) const {
+        auto deadline = std::chrono::steady_clock::now() + timeBudget;
+
+        std::vector<Task> tasks;
+        tasks.reserve(trips.size());
+        for (std::size_t i = 0; i < trips.size(); ++i) {
+            int start = trips[i]->getStartTime().getTotalMinutes();
+            tasks.push_back({start, start + trips[i]->getDurationMinutes(), i});
+        }
+
+        RosterResult result;
+        std::vector<Duty> duties;
+        std::vector<int> unassigned;
+        greedyAssign(tasks, drivers.size(), duties, unassigned);
+        result.greedyDriversUsed = static_cast<int>(duties.size());
+        result.localSearchRounds = improve(tasks, duties, deadline);
+
+        // Оставшиеся смены получают водителей в порядке их регистрации
+        std::size_t driverIndex = 0;
+        for (const auto& duty : duties) {
+            if (!duty.alive) continue;
+            EntityHandle driver = drivers[driverIndex++]->getHandle();
+            for (int taskIndex : duty.tasks) {
+                const Trip& trip = *trips[tasks[taskIndex].tripIndex];
+                result.assignments.push_back({trip.getHandle(), trip.getTripId(), driver});
+            }
+        }
+        result.driversUsed = static_cast<int>(driverIndex);
+
+        for (int taskIndex : unassigned) {
+            result.unassignedTrips.push_back(trips[tasks[taskIndex].tripIndex]->getTripId());
+        }
+        return result;
+    }
+};
+
+// Конфликт: одно транспортное средство назначено на пересекающиеся рейсы
+struct VehicleConflict {
+    std::string licensePlate;
+    int firstTripId;
+    int secondTripId;
+    Time overlapStart;
+    Time overlapEnd;
+};
+
+// Поиск двойного назначения транспорта по всему расписанию
+class VehicleConflictDetector {
+public:
+    // Интервалы сортируются один раз по (транспорт, начало), затем один проход
+    // с множеством активных интервалов выдает все пересекающиеся пары: O(n log n + k).
+    // Пара - конфликт, только если sharesDay(календарь, календарь) истинно
+    template<typename SharesDay>
+    static std::vector<VehicleConflict> findConflicts(const std::vector<std::shared_ptr<Trip>>& trips,
+                                                      SharesDay sharesDay) {
+        struct Entry {
+            const Vehicle* vehicle;
+            BusyInterval interval;
+        };
+
+        std::vector<Entry> entries;
+        entries.reserve(trips.size());
+        for (const auto& trip : trips) {
+            int start = trip->getStartTime().getTotalMinutes();
+            entries.push_back({trip->getVehicle().get(),
+                               {start, start + trip->getDurationMinutes(), trip->getTripId(), trip->getCalendarId()}});
+        }
+
+        // Один и тот же номерной знак считается одним транспортом
+        std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) {
+            if (a.vehicle != b.vehicle) {
+                int cmp = a.vehicle->getLicensePlate().compare(b.vehicle->getLicensePlate());
+                if (cmp != 0) return cmp < 0;
+            }
+            return a.interval.start < b.interval.start;
+        });
+
+        std::vector<VehicleConflict> conflicts;
+        std::vector<const Entry*> active;
+        for (std::size_t i = 0; i < entries.size(); ++i) {
+            const Entry& current = entries[i];
+            if (i > 0 && entries[i - 1].vehicle->getLicensePlate() != current.vehicle->getLicensePlate()) {
+                active.clear();
+            }
+
+            active.erase(std::remove_if(active.begin(), active.end(),
+                                        [&current](const Entry* e) {
+                                            return e->interval.end < current.interval.start;
+                                        }),
+                         active.end());
+
+            for (const Entry* other : active) {
+                if (!sharesDay(other->interval.calendarId, current.interval.calendarId)) continue;
+                conflicts.push_back({current.vehicle->getLicensePlate(),
+                                     other->interval.tripId, current.interval.tripId,
+                                     Time(0, current.interval.start),
+                                     Time(0, std::min(other->interval.end, current.interval.end))});
+            }
+            active.push_back(&current);
+        }
+        return conflicts;
+    }
+};
+
+// Выпуск: цепочка рейсов, которые одно транспортное средство выполняет подряд
+struct VehicleBlock {
+    std::string vehicleType;
+    std::vector<int> tripIds;
+    Time startTime;
+    Time endTime;
+};
+
+struct BlockingResult {
+    std::vector<VehicleBlock> blocks;
+    std::map<std::string, int> fleetByType;
+    int fleetSize = 0;
+};
+
+// Минимальный парк и выпуски: рейс j может следовать за рейсом i, если i заканчивается
+// на начальной остановке j не позже его отправления (с учетом отстоя) и тип транспорта совпадает.
+// Минимальный парк = число рейсов - максимальное паросочетание "конец i -> начало j"
+class VehicleBlockingOptimizer {
+private:
+    int minLayover;
+
+    struct Event {
+        int time;
+        bool isArrival;     // прибытие на конечную освобождает транспорт
+        std::size_t trip;
+    };
+
+public:
+    explicit VehicleBlockingOptimizer(int minLayoverMinutes = 0) : minLayover(minLayoverMinutes) {}
+
+    BlockingResult optimize(const std::vector<std::shared_ptr<Trip>>& trips) const {
+        const std::size_t none = trips.size();
+        std::vector<int> starts(trips.size()), ends(trips.size());
+
+        // Граф паросочетания распадается на независимые группы (остановка, тип транспорта):
+        // прибытия рейсов на остановку и отправления с нее.
+        // Интервалы занятости транспорта включают обе границы (IntervalIndex::findOverlap),
+        // поэтому рейс продолжает другой только при end + minLayover < start: прибытие
+        // освобождает транспорт на следующей минуте после отстоя
+        std::map<std::pair<std::string, std::string>, std::vector<Event>> groups;
+        for (std::size_t i = 0; i < trips.size(); ++i) {
+            const Trip& trip = *trips[i];
+            const std::string& type = trip.getVehicle()->getType();
+            starts[i] = trip.getStartTime().getTotalMinutes();
+            ends[i] = starts[i] + trip.getDurationMinutes();
+            groups[{trip.getRoute()->getEndStop(), type}].push_back({ends[i] + minLayover + 1, true, i});
+            groups[{trip.getRoute()->getStartStop(), type}].push_back({starts[i], false, i});
+        }
+
+        // В группе любое прибывшее к моменту отправления транспортное средство подходит
+        // любому более позднему отправлению, поэтому жадный проход по времени дает
+        // максимальное паросочетание за O(n log n)
+        std::vector<std::size_t> next(trips.size(), none);
+        std::vector<bool> hasPrevious(trips.size(), false);
+        // В один момент прибытия идут раньше отправлений. Прибытие рейса всегда позже
+        // его отправления, поэтому рейс не продолжает сам себя и цепочки не замыкаются
+        for (auto& [key, events] : groups) {
+            std::sort(events.begin(), events.end(), [](const Event& a, const Event& b) {
+                if (a.time != b.time) return a.time < b.time;
+                return a.isArrival > b.isArrival;
+            });
+
+            std::vector<std::size_t> waiting;
+            for (const auto& event : events) {
+                if (event.isArrival) {
+                    waiting.push_back(event.trip);
+                } else if (!waiting.empty()) {
+                    // Последний прибывший - минимальный отстой на конечной
+                    next[waiting.back()] = event.trip;
+                    hasPrevious[event.trip] = true;
+                    waiting.pop_back();
+                }
+            }
+        }
+
+        BlockingResult result;
+        for (std::size_t i = 0; i < trips.size(); ++i) {
+            if (hasPrevious[i]) continue;
+
+            VehicleBlock block;
+            block.vehicleType = trips[i]->getVehicle()->getType();
+            block.startTime = Time(0, starts[i]);
+            for (std::size_t j = i; j != none; j = next[j]) {
+                block.tripIds.push_back(trips[j]->getTripId());
+                block.endTime = Time(0, ends[j]);
+            }
+            result.fleetByType[block.vehicleType]++;
+            result.blocks.push_back(std::move(block));
+        }
+
+        std::sort(result.blocks.begin(), result.blocks.end(),
+                  [](const VehicleBlock& a, const VehicleBlock& b) { return a.startTime < b.startTime; });
+        result.fleetSize = static_cast<int>(result.blocks.size());
+        return result;
+    }
+};
+
+// Потоковое чтение CSV по RFC 4180: файл читается блоками фиксированного размера,
+// поля текущей записи хранятся в одном буфере, поэтому память не зависит от размера файла
+class CsvReader {
+private:
+    std::ifstream file;
+    std::vector<char> buffer;
+    std::size_t position = 0;
+    std::size_t filled = 0;
+    std::string record;                                   // поля записи без кавычек, подряд
+    std::vector<std::pair<std::size_t, std::size_t>> fields; // [начало, конец) в record
+    std::size_t recordNumber = 0;
+
+    bool refill() {
+        file.read(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+        filled = static_cast<std::size_t>(file.gcount());
+        position = 0;
+        return filled > 0;
+    }
+
+    bool atEnd() {
+        return position == filled && !refill();
+    }
+
+    // Участок без специальных символов копируется целиком
+    void copyRun(bool quoted) {
+        std::size_t start = position;
+        while (position < filled) {
+            char c = buffer[position];
+            if (c == '"' || (!quoted && (c == ',' || c == '\n' || c == '\r'))) break;
+            ++position;
+        }
+        record.append(buffer.data() + start, position - start);
+    }
+
+public:
+    explicit CsvReader(const std::string& path, std::size_t bufferSize = 1 << 20)
+        : file(path, std::ios::binary), buffer(bufferSize) {
+        if (!file.is_open()) {
+            throw TransportException("Не удалось открыть файл " + path);
+        }
+        // Метка порядка байтов UTF-8 в начале файла пропускается
+        if (refill() && filled >= 3 && buffer[0] == '\xEF' && buffer[1] == '\xBB' && buffer[2] == '\xBF') {
+            position = 3;
+        }
+    }
+
+    // Следующая запись; false в конце файла. Пустые строки пропускаются
+    bool next() {
+        do {
+            record.clear();
+            fields.clear();
+            if (atEnd()) return false;
+            ++recordNumber;
+
+            std::size_t fieldStart = 0;
+            bool quoted = false;
+            bool endOfRecord = false;
+            while (!endOfRecord) {
+                if (atEnd()) {
+                    if (quoted) {
+                        throw TransportException("CSV: незакрытые кавычки в записи " + std::to_string(recordNumber));
+                    }
+                    break;
+                }
+                char c = buffer[position];
+                if (quoted) {
+                    if (c != '"') {
+                        copyRun(true);
+                        continue;
+                    }
+                    ++position;
+                    // Удвоенная кавычка внутри поля - символ кавычки
+                    if (!atEnd() && buffer[position] == '"') {
+                        record += '"';
+                        ++position;
+                    } else {
+                        quoted = false;
+                    }
+                    continue;
+                }
+                switch (c) {
+                    case '"':
+                        if (record.size() == fieldStart) {
+                            quoted = true;
+                        } else {
+                            record += '"'; // кавычка внутри неэкранированного поля
+                        }
+                        ++position;
+                        break;
+                    case ',':
+                        fields.push_back({fieldStart, record.size()});
+                        fieldStart = record.size();
+                        ++position;
+                        break;
+                    case '\r':
+                        ++position;
+                        break;
+                    case '\n':
+                        ++position;
+                        endOfRecord = true;
+                        break;
+                    default:
+                        copyRun(false);
+                }
+            }
+            fields.push_back({fieldStart, record.size()});
+        } while (fields.size() == 1 && record.empty());
+        return true;
+    }
+
+    std::size_t size() const { return fields.size(); }
+
+    // Поле записи; отсутствующее поле - пустая строка
+    std::string_view operator[](int index) const {
+        if (index < 0 || static_cast<std::size_t>(index) >= fields.size()) return {};
+        const auto& [first, last] = fields[index];
+        return std::string_view(record).substr(first, last - first);
+    }
+
+    // Номер столбца по заголовку (текущая запись), -1 если столбца нет
+    int column(std::string_view name) const {
+        for (std::size_t i = 0; i < fields.size(); ++i) {
+            if ((*this)[static_cast<int>(i)] == name) return static_cast<int>(i);
+        }
+        return -1;
+    }
+
+    std::size_t getRecordNumber() const { return recordNumber; }
+};
+
+// Буферизованная запись CSV по RFC 4180: поля форматируются прямо в буфер
+// (числа - через to_chars), файл пишется крупными блоками. Вместо файла можно писать
+// в строку вызывающего: она переиспользуется между ответами без новых выделений памяти
+class CsvWriter {
+private:
+    std::ofstream file;
+    std::vector<char> buffer;
+    std::size_t used = 0;
+    bool recordStart = true;
+    std::string* target = nullptr;  // запись в строку вместо файла
+
+    void raw(const char* data, std::size_t size) {
+        if (target) {
+            target->append(data, size);
+            return;
+        }
+        if (used + size > buffer.size()) {
+            flush();
+            if (size > buffer.size()) {
+                file.write(data, static_cast<std::streamsize>(size));
+                return;
+            }
+        }
+        std::memcpy(buffer.data() + used, data, size);
+        used += size;
+    }
+
+    void separator() {
+        if (!recordStart) raw(",", 1);
+        recordStart = false;
+    }
+
+    static bool needsQuotes(std::string_view text) {
+        return text.find_first_of(",\"\r\n") != std::string_view::npos;
+    }
+
+    // Текст внутри поля в кавычках: кавычки удваиваются
+    void quotedText(std::string_view text) {
+        for (std::size_t start = 0;;) {
+            std::size_t quote = text.find('"', start);
+            raw(text.data() + start, (quote == std::string_view::npos ? text.size() : quote) - start);
+            if (quote == std::string_view::npos) break;
+            raw("\"\"", 2);
+            start = quote + 1;
+        }
+    }
+
+public:
+    explicit CsvWriter(const std::string& path, std::size_t bufferSize = 1 << 20)
+        : file(path, std::ios::binary | std::ios::trunc), buffer(bufferSize) {
+        if (!file.is_open()) {
+            throw TransportException("Не удалось открыть файл " + path);
+        }
+    }
+
+    // Поля дописываются в конец target
+    explicit CsvWriter(std::string& target) : target(&target) {}
+
+    ~CsvWriter() {
+        try {
+            flush();
+        } catch (...) {
+        }
+    }
+
+    CsvWriter(const CsvWriter&) = delete;
+    CsvWriter& operator=(const CsvWriter&) = delete;
+
+    // Поле в кавычках, только если оно содержит запятую, кавычку или перевод строки
+    CsvWriter& field(std::string_view text) {
+        separator();
+        if (!needsQuotes(text)) {
+            raw(text.data(), text.size());
+            return *this;
+        }
+        raw("\"", 1);
+        quotedText(text);
+        raw("\"", 1);
+        return *this;
+    }
+
+    // Список значений в одном поле через delimiter (как остановки в routes.txt)
+    CsvWriter& field(const std::vector<std::string>& items, char delimiter) {
+        separator();
+        bool quoted = needsQuotes(std::string_view(&delimiter, 1)) ||
+                      std::any_of(items.begin(), items.end(), [](const std::string& item) { return needsQuotes(item); });
+        if (quoted) raw("\"", 1);
+        for (std::size_t i = 0; i < items.size(); ++i) {
+            if (i > 0) raw(&delimiter, 1);
+            if (quoted) {
+                quotedText(items[i]);
+            } else {
+                raw(items[i].data(), items[i].size());
+            }
+        }
+        if (quoted) raw("\"", 1);
+        return *this;
+    }
+
+    CsvWriter& field(int value) {
+        separator();
+        char digits[16];
+        auto [end, error] = std::to_chars(digits, digits + sizeof(digits), value);
+        raw(digits, static_cast<std::size_t>(end - digits));
+        return *this;
+    }
+
+    CsvWriter& field(double value) {
+        separator();
+        char digits[32];
+        auto [end, error] = std::to_chars(digits, digits + sizeof(digits), value,
+                                          std::chars_format::general, 9);
+        raw(digits, static_cast<std::size_t>(end - digits));
+        return *this;
+    }
+
+    CsvWriter& field(std::size_t value) {
+        separator();
+        char digits[24];
+        auto [end, error] = std::to_chars(digits, digits + sizeof(digits), value);
+        raw(digits, static_cast<std::size_t>(end - digits));
+        return *this;
+    }
+
+    // Время ЧЧ:ММ:СС (или ЧЧ:ММ без секунд); часы могут быть больше 24 для рейсов после полуночи
+    CsvWriter& time(int minutes, bool withSeconds = true) {
+        separator();
+        char text[24];
+        char* end = Time::formatMinutes(text, minutes);
+        if (withSeconds) {
+            std::memcpy(end, ":00", 3);
+            end += 3;
+        }
+        raw(text, static_cast<std::size_t>(end - text));
+        return *this;
+    }
+
+    void endRecord() {
+        raw("\n", 1);
+        recordStart = true;
+    }
+
+    // Дописывание готового файла (части, записанной другим потоком)
+    void append(const std::filesystem::path& path) {
+        flush();
+        std::ifstream part(path, std::ios::binary);
+        if (!part.is_open()) {
+            throw TransportException("Не удалось открыть файл " + path.string());
+        }
+        if (target) {
+            target->append(std::istreambuf_iterator<char>(part), std::istreambuf_iterator<char>());
+            return;
+        }
+        while (part.read(buffer.data(), static_cast<std::streamsize>(buffer.size())) || part.gcount() > 0) {
+            file.write(buffer.data(), part.gcount());
+        }
+    }
+
+    void flush() {
+        if (target) return;
+        if (used > 0) {
+            file.write(buffer.data(), static_cast<std::streamsize>(used));
+            used = 0;
+        }
+        if (!file) {
+            throw TransportException("Ошибка записи CSV");
+        }
+    }
+};
+
+// Потоковая запись JSON в строку вызывающего; строку можно переиспользовать между ответами
+// (clear() сохраняет емкость). Текст UTF-8 пишется как есть: экранируются только кавычка,
+// обратная косая черта и управляющие символы, а некорректные последовательности байтов
+// заменяются на U+FFFD, чтобы результат всегда оставался корректным JSON
+class JsonWriter {
+private:
+    static constexpr int MAX_DEPTH = 32;
+
+    std::string& out;
+    std::array<bool, MAX_DEPTH> hasItems{};  // на уровне вложенности уже есть элементы
+    int depth = 0;
+    bool afterKey = false;
+
+    void beforeValue() {
+        if (afterKey) {
+            afterKey = false;
+            return;
+        }
+        if (depth > 0 && hasItems[depth]) out += ',';
+        hasItems[depth] = true;
+    }
+
+    void open(char bracket) {
+        beforeValue();
+        if (depth + 1 >= MAX_DEPTH) {
+            throw TransportException("Слишком глубокая вложенность JSON");
+        }
+        out += bracket;
+        hasItems[++depth] = false;
+    }
+
+    void close(char bracket) {
+        out += bracket;
+        --depth;
+    }
+
+    // Длина корректной последовательности UTF-8 с началом в pos или 0
+    static std::size_t sequenceLength(std::string_view text, std::size_t pos) {
+        unsigned char lead = static_cast<unsigned char>(text[pos]);
+        std::size_t length;
+        char32_t code;
+        char32_t minimum;
+        if ((lead & 0xE0) == 0xC0) {
+            length = 2, code = lead & 0x1F, minimum = 0x80;
+        } else if ((lead & 0xF0) == 0xE0) {
+            length = 3, code = lead & 0x0F, minimum = 0x800;
+        } else if ((lead & 0xF8) == 0xF0) {
+            length = 4, code = lead & 0x07, minimum = 0x10000;
+        } else {
+            return 0;
+        }
+        if (pos + length > text.size()) return 0;
+        for (std::size_t k = 1; k < length; ++k) {
+            unsigned char next = static_cast<unsigned char>(text[pos + k]);
+            if ((next & 0xC0) != 0x80) return 0;
+            code = (code << 6) | (next & 0x3F);
+        }
+        // Избыточная запись, суррогаты и значения вне Юникода некорректны
+        if (code < minimum || code > 0x10FFFF || (code >= 0xD800 && code <= 0xDFFF)) return 0;
+        return length;
+    }
+
+    // Строка в кавычках: куски без экранирования копируются целиком
+    void quoted(std::string_view text) {
+        static constexpr char HEX[] = "0123456789abcdef";
+        out += '"';
+        std::size_t copied = 0;
+        for (std::size_t i = 0; i < text.size(); ) {
+            unsigned char c = static_cast<unsigned char>(text[i]);
+            if (c >= 0x80) {
+                if (std::size_t length = sequenceLength(text, i)) {
+                    i += length;
+                    continue;
+                }
+            } else if (c >= 0x20 && c != '"' && c != '\\') {
+                ++i;
+                continue;
+            }
+
+            out.append(text.data() + copied, i - copied);
+            switch (c) {
+                case '"': out += "\\\""; break;
+                case '\\': out += "\\\\"; break;
+                case '\n': out += "\\n"; break;
+                case '\r': out += "\\r"; break;
+                case '\t': out += "\\t"; break;
+                case '\b': out += "\\b"; break;
+                case '\f': out += "\\f"; break;
+                default:
+                    if (c >= 0x80) {
+                        out += "\\ufffd";
+                    } else {
+                        char escape[6] = {'\\', 'u', '0', '0', HEX[c >> 4], HEX[c & 0xF]};
+                        out.append(escape, sizeof(escape));
+                    }
+            }
+            copied = ++i;
+        }
+        out.append(text.data() + copied, text.size() - copied);
+        out += '"';
+    }
+
+public:
+    // Значения дописываются в конец buffer
+    explicit JsonWriter(std::string& buffer) : out(buffer) {}
+
+    JsonWriter& beginObject() { open('{'); return *this; }
+    JsonWriter& endObject() { close('}'); return *this; }
+    JsonWriter& beginArray() { open('['); return *this; }
+    JsonWriter& endArray() { close(']'); return *this; }
+
+    JsonWriter& key(std::string_view name) {
+        beforeValue();
+        quoted(name);
+        out += ':';
+        afterKey = true;
+        return *this;
+    }
+
+    JsonWriter& string(std::string_view text) {
+        beforeValue();
+        quoted(text);
+        return *this;
+    }
+
+    JsonWriter& number(int value) {
+        beforeValue();
+        char digits[16];
+        auto [end, error] = std::to_chars(digits, digits + sizeof(digits), value);
+        out.append(digits, static_cast<std::size_t>(end - digits));
+        return *this;
+    }
+
+    JsonWriter& number(std::size_t value) {
+        beforeValue();
+        char digits[24];
+        auto [end, error] = std::to_chars(digits, digits + sizeof(digits), value);
+        out.append(digits, static_cast<std::size_t>(end - digits));
+        return *this;
+    }
+
+    // Нечисловые значения (NaN, бесконечность) в JSON не допускаются и пишутся как null
+    JsonWriter& number(double value) {
+        if (!std::isfinite(value)) return null();
+        beforeValue();
+        char digits[32];
+        auto [end, error] = std::to_chars(digits, digits + sizeof(digits), value,
+                                          std::chars_format::general, 9);
+        out.append(digits, static_cast<std::size_t>(end - digits));
+        return *this;
+    }
+
+    JsonWriter& boolean(bool value) {
+        beforeValue();
+        out += value ? "true" : "false";
+        return *this;
+    }
+
+    JsonWriter& null() {
+        beforeValue();
+        out += "null";
+        return *this;
+    }
+
+    // Время "ЧЧ:ММ" по минутам от начала суток
+    JsonWriter& time(int minutes) {
+        beforeValue();
+        char text[24];
+        text[0] = '"';
+        char* end = Time::formatMinutes(text + 1, minutes);
+        *end++ = '"';
+        out.append(text, static_cast<std::size_t>(end - text));
+        return *this;
+    }
+
+    // Дата "ГГГГ-ММ-ДД"
+    JsonWriter& date(ServiceDate value) {
+        beforeValue();
+        char text[24];
+        text[0] = '"';
+        char* end = ServiceCalendar::formatDate(text + 1, value);
+        *end++ = '"';
+        out.append(text, static_cast<std::size_t>(end - text));
+        return *this;
+    }
+};
+
+struct CachedTrip;
+struct DerivedIndexCache;
+
+// Поток, отбрасывающий вывод: библиотека ничего не печатает сама, пока программа
+// не подключит свой поток (DataManager::setOutput)
+inline std::ostream& discardedOutput() {
+    struct NullBuffer : std::streambuf {
+        int overflow(int c) override { return traits_type::not_eof(c); }
+        std::streamsize xsputn(const char*, std::streamsize count) override { return count; }
+    };
+    static NullBuffer buffer;
+    static std::ostream stream(&buffer);
+    return stream;
+}
+
+// Класс для управления данными (сохранение/загрузка в текстовые файлы)
+class DataManager {
+private:
+    std::string dataDirectory;
+    unsigned threadCount;
+    std::ostream* output = &discardedOutput();  // сообщения о загрузке и сохранении
+
+    // Рабочие потоки разбора, общие для всех файлов, разбираемых одновременно
+    // (задачи loadAllData): вместе они запускают не больше threadCount - 1 рабочих
+    mutable std::atomic<unsigned> spareWorkers;
+
+    // Файлы больше этого размера делятся на части и разбираются в нескольких потоках
+    static constexpr std::uint64_t MIN_CHUNK_BYTES = 1 << 20;
+
+    // Строка, разобранная в рабочем потоке. Ошибка разбора сохраняется и выбрасывается
+    // при регистрации, поэтому сообщения выводятся в порядке строк файла
+    template<typename T>
+    struct ParsedLine {
+        std::optional<T> value;
+        std::exception_ptr error;
+
+        T take() {
+            if (error) std::rethrow_exception(error);
+            return std::move(*value);
+        }
+    };
+
+    template<typename T>
+    using ParsedFile = std::vector<ParsedLine<T>>;
+
+    // Захват до wanted свободных рабочих потоков; возвращает число захваченных
+    unsigned acquireWorkers(unsigned wanted) const {
+        unsigned available = spareWorkers.load();
+        unsigned taken = std::min(wanted, available);
+        while (taken != 0 && !spareWorkers.compare_exchange_weak(available, available - taken)) {
+            taken = std::min(wanted, available);
+        }
+        return taken;
+    }
+
+    void releaseWorkers(unsigned count) const { spareWorkers += count; }
+
+    // Число частей файла при разборе в threadCount потоков (0 - файла нет)
+    std::uint64_t countParts(const std::string& path, std::uint64_t& size) const {
+        std::error_code error;
+        size = std::filesystem::file_size(path, error);
+        if (error) return 0;
+        return std::clamp<std::uint64_t>(size / MIN_CHUNK_BYTES, 1, threadCount);
+    }
+
+    // Границы parts частей файла: каждая часть начинается с начала строки
+    std::vector<std::uint64_t> splitOnLines(const std::string& path, std::uint64_t size,
+                                            std::uint64_t parts) const {
+        if (parts == 0) return {0, 0};
+
+        std::vector<std::uint64_t> bounds{0};
+        std::ifstream file(path, std::ios::binary);
+        std::string rest;
+        for (std::uint64_t i = 1; i < parts; ++i) {
+            file.clear();
+            file.seekg(static_cast<std::streamoff>(size * i / parts - 1));
+            std::getline(file, rest);
+            std::uint64_t bound = file ? static_cast<std::uint64_t>(file.tellg()) : size;
+            bounds.push_back(std::max(bound, bounds.back()));
+        }
+        bounds.push_back(size);
+        return bounds;
+    }
+
+    // Разбор строк, начинающихся в диапазоне [begin, end)
+    template<typename T, typename Parse>
+    static ParsedFile<T> parseRange(const std::string& path, std::uint64_t begin, std::uint64_t end,
+                                    const Parse& parse) {
+        ParsedFile<T> result;
+        std::ifstream file(path, std::ios::binary);
+        if (!file.is_open()) return result;
+        file.seekg(static_cast<std::streamoff>(begin));
+
+        std::string line;
+        std::uint64_t position = begin;
+        while (position < end && std::getline(file, line)) {
+            position += line.size() + 1;
+            if (!line.empty() && line.back() == '\r') line.pop_back();
+            if (line.empty()) continue;
+
+            ParsedLine<T>& parsed = result.emplace_back();
+            try {
+                parsed.value.emplace(parse(line));
+            } catch (...) {
+                parsed.error = std::current_exception();
+            }
+        }
+        return result;
+    }
+
+    // Разбор файла по частям: первая часть разбирается в вызывающем потоке, остальные - в рабочих.
+    // Частей столько, сколько рабочих удалось захватить из общего запаса.
+    // parse вызывается одновременно из нескольких потоков и не должен изменять общие данные
+    template<typename Parse>
+    auto parseFile(const std::string& name, Parse parse) const {
+        using T = std::decay_t<std::invoke_result_t<const Parse&, const std::string&>>;
+        std::string path = dataDirectory + name;
+        std::uint64_t size = 0;
+        std::uint64_t wanted = countParts(path, size);
+        unsigned extra = wanted > 1 ? acquireWorkers(static_cast<unsigned>(wanted - 1)) : 0;
+        std::vector<std::uint64_t> bounds = splitOnLines(path, size, wanted == 0 ? 0 : extra + 1);
+
+        std::vector<ParsedFile<T>> parts(bounds.size() - 1);
+        std::vector<std::exception_ptr> errors(parts.size());
+        std::vector<std::thread> workers;
+        for (std::size_t i = 1; i < parts.size(); ++i) {
+            workers.emplace_back([&, i]() {
+                try {
+                    parts[i] = parseRange<T>(path, bounds[i], bounds[i + 1], parse);
+                } catch (...) {
+                    errors[i] = std::current_exception();
+                }
+            });
+        }
+        try {
+            parts[0] = parseRange<T>(path, bounds[0], bounds[1], parse);
+        } catch (...) {
+            errors[0] = std::current_exception();
+        }
+        for (auto& worker : workers) worker.join();
+        releaseWorkers(extra);
+        for (const auto& error : errors) {
+            if (error) std::rethrow_exception(error);
+        }
+
+        ParsedFile<T> result = std::move(parts[0]);
+        for (std::size_t i = 1; i < parts.size(); ++i) {
+            std::move(parts[i].begin(), parts[i].end(), std::back_inserter(result));
+        }
+        return result;
+    }
+
+    // Кэш производных индексов (index.cache) помечен хешем исходных файлов
+    static constexpr std::uint32_t INDEX_CACHE_MAGIC = 0x58444954; // "TIDX"
+    static constexpr std::uint32_t INDEX_CACHE_VERSION = 2;
+
+    enum IndexCacheSection : std::uint8_t {
+        CACHE_STOP_TIMETABLE = 1,
+        CACHE_FOOTPATHS = 2,
+        CACHE_LAZY_TRIPS = 4,
+        CACHE_TRIPS = 8
+    };
+
+    std::uint64_t hashSourceFiles() const;
+    DerivedIndexCache readIndexCache() const;
+    void saveIndexCache(TransportSystem& system, std::uint64_t sourceHash);
+
+    static std::shared_ptr<Trip> restoreTrip(const CachedTrip& cached, TransportSystem& system);
+    static std::shared_ptr<Vehicle> parseVehicle(const std::string& line);
+    static FootpathGraph::Footpath parseFootpath(const std::string& line);
+    static std::pair<std::string, std::string> parseAdminCredentials(const std::string& line);
+
+public:
+    // Файлы, из которых строятся данные системы (учетные записи администраторов не входят)
+    static constexpr const char* SOURCE_FILES[] = {
+        "stops.txt", "vehicles.txt", "drivers.txt", "routes.txt", "calendars.txt",
+        "trips.txt", "templates.txt", "footpaths.txt"
+    };
+
+    // Результат перечитывания trips.txt на месте
+    struct TripReloadCounts {
+        std::size_t kept = 0;
+        std::size_t removed = 0;
+        std::size_t added = 0;
+    };
+
+    DataManager(const std::string& dir = "data/", unsigned threads = std::thread::hardware_concurrency())
+        : dataDirectory(dir), threadCount(std::max(threads, 1u)), spareWorkers(threadCount - 1) {
+        // Создаем директорию, если её нет
+        std::filesystem::create_directories(dataDirectory);
+    }
+
+    const std::string& getDataDirectory() const { return dataDirectory; }
+
+    // Поток сообщений о загрузке и сохранении (по умолчанию вывод отбрасывается).
+    // Сообщения загрузки в фоновом потоке собираются в строку и выводятся позже
+    void setOutput(std::ostream& stream) { output = &stream; }
+    std::ostream& getOutput() const { return *output; }
+
+    // Сохранение всех данных в текстовые файлы
+    void saveAllData(TransportSystem& system);
+
+    // Загрузка всех данных из текстовых файлов; false, если загрузка прервана ошибкой
+    bool loadAllData(TransportSystem& system);
+
+    // Повторное чтение trips.txt в уже загруженную систему: разбираются только новые
+    // и измененные строки, рейсы с прежней строкой остаются на месте
+    TripReloadCounts reloadTrips(TransportSystem& system);
+
+private:
+    void saveStops(TransportSystem& system);
+    void saveVehicles(TransportSystem& system);
+    void saveDrivers(TransportSystem& system);
+    void saveRoutes(TransportSystem& system);
+    void saveCalendars(TransportSystem& system);
+    void saveTrips(TransportSystem& system);
+    void saveTripTemplates(TransportSystem& system);
+    void saveFootpaths(TransportSystem& system);
+    void saveTripLoading(TransportSystem& system);
+    void saveAdminCredentials(TransportSystem& system);
+
+    // Регистрация разобранных записей в системе (в одном потоке)
+    void loadStops(TransportSystem& system, ParsedFile<Stop> stops);
+    void loadVehicles(TransportSystem& system, ParsedFile<std::shared_ptr<Vehicle>> vehicles);
+    void loadDrivers(TransportSystem& system, ParsedFile<std::shared_ptr<Driver>> drivers);
+    void loadRoutes(TransportSystem& system, ParsedFile<std::shared_ptr<Route>> routes);
+    void loadCalendars(TransportSystem& system, ParsedFile<ServiceCalendar> calendars);
+    bool loadTrips(TransportSystem& system, DerivedIndexCache& indexes);
+    void loadTripTemplates(TransportSystem& system);
+    void loadFootpaths(TransportSystem& system, ParsedFile<FootpathGraph::Footpath> footpaths);
+    void loadTripLoading(TransportSystem& system);
+    void loadAdminCredentials(TransportSystem& system,
+                              ParsedFile<std::pair<std::string, std::string>> credentials);
+};
+
+// Прибытие рейса на остановку в индексе расписаний
+struct StopEvent {
+    int minutes;
+    EntityHandle trip;
+
+    bool operator<(const StopEvent& other) const {
+        return minutes != other.minutes ? minutes < other.minutes : trip < other.trip;
+    }
+};
+
+// Расписание по остановкам: для каждой остановки прибытия, упорядоченные по времени.
+// Обновляется точечно при добавлении, удалении и сдвиге рейсов
+class StopTimetableIndex {
+private:
+    CountedHashMap<std::string, std::vector<StopEvent>, MemoryComponent::StopTimetable> events;
+
+    void insertEvent(const std::string& stop, const StopEvent& event) {
+        auto& list = events[stop];
+        list.insert(std::upper_bound(list.begin(), list.end(), event), event);
+    }
+
+    void eraseEvent(const std::string& stop, const StopEvent& event) {
+        auto it = events.find(stop);
+        if (it == events.end()) return;
+        auto& list = it->second;
+        auto pos = std::lower_bound(list.begin(), list.end(), event);
+        if (pos != list.end() && pos->minutes == event.minutes && pos->trip == event.trip) {
+            list.erase(pos);
+        }
+        if (list.empty()) {
+            events.erase(it);
+        }
+    }
+
+public:
+    void addTrip(const Trip& trip) {
+        trip.forEachArrival([&](const std::string& stop, const Time& time) {
+            insertEvent(stop, {time.getTotalMinutes(), trip.getHandle()});
+        });
+    }
+
+    // Пакетное добавление: прибытия собираются по остановкам, сортируются и сливаются
+    // со списком каждой остановки за один проход
+    void addTrips(const std::vector<std::shared_ptr<Trip>>& added) {
+        std::unordered_map<std::string, std::vector<StopEvent>> incoming;
+        for (const auto& trip : added) {
+            trip->forEachArrival([&](const std::string& stop, const Time& time) {
+                incoming[stop].push_back({time.getTotalMinutes(), trip->getHandle()});
+            });
+        }
+        for (auto& [stop, list] : incoming) {
+            std::sort(list.begin(), list.end());
+            auto& target = events[stop];
+            std::size_t middle = target.size();
+            target.insert(target.end(), list.begin(), list.end());
+            std::inplace_merge(target.begin(), target.begin() + static_cast<std::ptrdiff_t>(middle), target.end());
+        }
+    }
+
+    // Удаление по текущему расписанию рейса (вызывать до его изменения)
+    void removeTrip(const Trip& trip) {
+        trip.forEachArrival([&](const std::string& stop, const Time& time) {
+            eraseEvent(stop, {time.getTotalMinutes(), trip.getHandle()});
+        });
+    }
+
+    // Пакетное удаление: каждая затронутая остановка фильтруется один раз
+    void removeTrips(const std::vector<std::shared_ptr<Trip>>& removed, const HandleSet& removedHandles) {
+        std::unordered_set<std::string> affected;
+        for (const auto& trip : removed) {
+            trip->forEachArrival([&affected](const std::string& stop, const Time&) {
+                affected.insert(stop);
+            });
+        }
+
+        for (const auto& stop : affected) {
+            auto it = events.find(stop);
+            if (it == events.end()) continue;
+            auto& list = it->second;
+            list.erase(std::remove_if(list.begin(), list.end(),
+                [&](const StopEvent& event) { return removedHandles.contains(event.trip); }), list.end());
+            if (list.empty()) {
+                events.erase(it);
+            }
+        }
+    }
+
+    // Перенос одного прибытия: затрагивается только список этой остановки
+    void moveEvent(const std::string& stop, EntityHandle trip, int oldMinutes, int newMinutes) {
+        eraseEvent(stop, {oldMinutes, trip});
+        insertEvent(stop, {newMinutes, trip});
+    }
+
+    // Прибытия на остановку в интервале [from, to]
+    std::pair<const StopEvent*, const StopEvent*> range(const std::string& stop, int from, int to) const {
+        auto it = events.find(stop);
+        if (it == events.end() || from > to) return {nullptr, nullptr};
+        const auto& list = it->second;
+        auto first = std::lower_bound(list.begin(), list.end(), StopEvent{from, 0});
+        auto last = std::lower_bound(first, list.end(), StopEvent{to + 1, 0});
+        return {list.data() + (first - list.begin()), list.data() + (last - list.begin())};
+    }
+
+    // Все прибытия на остановку не раньше from
+    std::pair<const StopEvent*, const StopEvent*> departuresFrom(const std::string& stop, int from) const {
+        return range(stop, from, std::numeric_limits<int>::max() - 1);
+    }
+
+    // Копия индекса только с рейсами, для которых predicate(дескриптор) истинно.
+    // Порядок сохраняется, поэтому сортировка не нужна
+    template<typename Predicate>
+    StopTimetableIndex filtered(Predicate predicate) const {
+        StopTimetableIndex result;
+        for (const auto& [stop, list] : events) {
+            std::vector<StopEvent> kept;
+            std::copy_if(list.begin(), list.end(), std::back_inserter(kept),
+                         [&](const StopEvent& event) { return predicate(event.trip); });
+            if (!kept.empty()) {
+                kept.shrink_to_fit();
+                result.events.emplace(stop, std::move(kept));
+            }
+        }
+        return result;
+    }
+
+    // Запись в кэш индексов с заменой дескрипторов: map(дескриптор) - номер рейса в файле
+    template<typename Map>
+    void write(BinaryWriter& out, Map map) const {
+        out.value(static_cast<std::uint32_t>(events.size()));
+        std::vector<StopEvent> mapped;
+        for (const auto& [stop, list] : events) {
+            mapped.clear();
+            for (const StopEvent& event : list) {
+                mapped.push_back({event.minutes, map(event.trip)});
+            }
+            out.string(stop);
+            out.array(mapped);
+        }
+    }
+
+    // Чтение из кэша: в событиях остаются номера рейсов в файле до вызова remapTrips
+    static StopTimetableIndex read(BinaryReader& in) {
+        StopTimetableIndex index;
+        auto stopCount = in.value<std::uint32_t>();
+        index.events.reserve(stopCount);
+        for (std::uint32_t i = 0; i < stopCount; ++i) {
+            std::string stop = in.string();
+            index.events.emplace(std::move(stop), in.array<StopEvent>());
+        }
+        return index;
+    }
+
+    // Замена номеров рейсов дескрипторами: map(номер) - дескриптор или INVALID_HANDLE.
+    // Порядок прибытий с одинаковым временем восстанавливается сортировкой
+    template<typename Map>
+    bool remapTrips(Map map) {
+        for (auto& [stop, list] : events) {
+            for (StopEvent& event : list) {
+                event.trip = map(event.trip);
+                if (event.trip == INVALID_HANDLE) return false;
+            }
+            if (!std::is_sorted(list.begin(), list.end())) {
+                std::sort(list.begin(), list.end());
+            }
+        }
+        return true;
+    }
+
+    std::size_t getEventCount() const {
+        std::size_t count = 0;
+        for (const auto& [stop, list] : events) {
+            count += list.size();
+        }
+        return count;
+    }
+
+    std::size_t getStopCount() const { return events.size(); }
+
+    std::size_t getMemoryBytes() const {
+        std::size_t bytes = 0;
+        for (const auto& [stop, list] : events) {
+            bytes += ComponentMemory::stringBytes(stop) + list.capacity() * sizeof(StopEvent);
+        }
+        return bytes;
+    }
+};
+
+// Отправление рейса по профилю хода
+struct PatternDeparture {
+    int minutes;        // время отправления от начала суток
+    EntityHandle trip;
+
+    bool operator<(const PatternDeparture& other) const {
+        return minutes != other.minutes ? minutes < other.minutes : trip < other.trip;
+    }
+};
+
+// Общие профили хода рейсов: одинаковые профили хранятся один раз, отправления
+// каждого профиля упорядочены по времени. Как и индекс расписаний, рейс снимается
+// с учета до изменения его расписания и регистрируется заново после
+class TripPatternIndex {
+private:
+    struct Entry {
+        std::shared_ptr<const TripPattern> pattern;
+        std::vector<PatternDeparture> departures;
+    };
+
+    CountedHashMap<std::size_t, std::vector<Entry>, MemoryComponent::TripPatterns> buckets; // по хешу профиля
+    std::size_t patternCount = 0;
+
+    // Запись профиля рейса (хеш и номер в корзине); профиль рейса заменяется общим
+    // экземпляром с тем же ходом. Записи в корзине только добавляются, номер остается верным
+    std::pair<std::size_t, std::size_t> attach(Trip& trip) {
+        std::size_t hash = trip.getPattern()->hash();
+        auto& bucket = buckets[hash];
+        auto it = std::find_if(bucket.begin(), bucket.end(), [&trip](const Entry& entry) {
+            return entry.pattern->sameProfile(*trip.getPattern());
+        });
+        if (it == bucket.end()) {
+            bucket.push_back({trip.getPattern(), {}});
+            it = std::prev(bucket.end());
+            ++patternCount;
+        } else {
+            trip.sharePattern(it->pattern);
+        }
+        return {hash, static_cast<std::size_t>(it - bucket.begin())};
+    }
+
+public:
+    // Регистрация рейса; его профиль заменяется общим экземпляром с тем же ходом
+    void addTrip(Trip& trip) {
+        if (!trip.getPattern()) return;
+        auto [hash, index] = attach(trip);
+        auto& departures = buckets[hash][index].departures;
+        PatternDeparture departure{trip.getStartTime().getTotalMinutes(), trip.getHandle()};
+        departures.insert(std::upper_bound(departures.begin(), departures.end(), departure), departure);
+    }
+
+    // Пакетная регистрация: отправления собираются по профилям и сливаются
+    // с имеющимися один раз на профиль
+    void addTrips(const std::vector<std::shared_ptr<Trip>>& added) {
+        std::map<std::pair<std::size_t, std::size_t>, std::vector<PatternDeparture>> incoming;
+        for (const auto& trip : added) {
+            if (!trip->getPattern()) continue;
+            incoming[attach(*trip)].push_back({trip->getStartTime().getTotalMinutes(), trip->getHandle()});
+        }
+        for (auto& [key, list] : incoming) {
+            std::sort(list.begin(), list.end());
+            auto& departures = buckets[key.first][key.second].departures;
+            std::size_t middle = departures.size();
+            departures.insert(departures.end(), list.begin(), list.end());
+            std::inplace_merge(departures.begin(), departures.begin() + static_cast<std::ptrdiff_t>(middle),
+                               departures.end());
+        }
+    }
+
+    void removeTrip(const Trip& trip) {
+        if (!trip.getPattern()) return;
+        auto bucketIt = buckets.find(trip.getPattern()->hash());
+        if (bucketIt == buckets.end()) return;
+        auto& bucket = bucketIt->second;
+        auto it = std::find_if(bucket.begin(), bucket.end(), [&trip](const Entry& entry) {
+            return entry.pattern == trip.getPattern();
+        });
+        if (it == bucket.end()) return;
+
+        PatternDeparture departure{trip.getStartTime().getTotalMinutes(), trip.getHandle()};
+        auto found = std::lower_bound(it->departures.begin(), it->departures.end(), departure);
+        if (found != it->departures.end() && found->trip == departure.trip) {
+            it->departures.erase(found);
+        }
+        if (it->departures.empty()) {
+            *it = std::move(bucket.back());
+            bucket.pop_back();
+            --patternCount;
+            if (bucket.empty()) buckets.erase(bucketIt);
+        }
+    }
+
+    std::size_t size() const { return patternCount; }
+
+    std::size_t getMemoryBytes() const {
+        std::size_t bytes = 0;
+        for (const auto& [hash, bucket] : buckets) {
+            bytes += bucket.capacity() * sizeof(Entry);
+            for (const Entry& entry : bucket) {
+                bytes += entry.pattern->getMemoryBytes() + entry.departures.capacity() * sizeof(PatternDeparture);
+            }
+        }
+        return bytes;
+    }
+};
+
+// Индекс названий остановок: автодополнение по префиксу и поиск с опечатками.
+// Названия хранятся в свернутом регистре (кириллица и латиница, ё = е) как строки кодовых точек
+class StopNameIndex {
+public:
+    struct Match {
+        int stopId;
+        std::string name;
+        int distance; // расстояние Левенштейна до запроса (0 для точных и префиксных совпадений)
+    };
+
+private:
+    struct Entry {
+        std::u32string folded;
+        int stopId;
+        std::string name;
+    };
+
+    std::vector<Entry> entries;
+    std::vector<std::uint32_t> order; // индексы entries, упорядоченные по folded
+    CountedHashMap<std::uint64_t, std::vector<std::uint32_t>, MemoryComponent::StopNames> trigrams;
+
+    static std::u32string decodeUtf8(const std::string& text) {
+        std::u32string result;
+        result.reserve(text.size());
+        for (std::size_t i = 0; i < text.size(); ) {
+            unsigned char lead = static_cast<unsigned char>(text[i]);
+            int length = lead < 0x80 ? 1 : (lead >> 5) == 0x6 ? 2 : (lead >> 4) == 0xE ? 3 : (lead >> 3) == 0x1E ? 4 : 0;
+            if (length == 0 || i + length > text.size()) {
+                result.push_back(lead); // некорректный байт оставляем как есть
+                ++i;
+                continue;
+            }
+            char32_t code = length == 1 ? lead : lead & (0x7F >> length);
+            for (int k = 1; k < length; ++k) {
+                code = (code << 6) | (static_cast<unsigned char>(text[i + k]) & 0x3F);
+            }
+            result.push_back(code);
+            i += length;
+        }
+        return result;
+    }
+
+    // Свертка регистра для латиницы (ASCII и Latin-1) и основной кириллицы; Ё и ё
+    // приравниваются к е. Остальные алфавиты (греческий, расширенная кириллица и т.д.)
+    // сравниваются без свертки, полная свертка Юникода не выполняется
+    static char32_t foldChar(char32_t c) {
+        if (c == 0x0401 || c == 0x0451) return 0x0435;    // Ё, ё -> е
+        if (c >= U'A' && c <= U'Z') return c + 0x20;
+        if (c >= 0x00C0 && c <= 0x00DE && c != 0x00D7) return c + 0x20; // À-Þ -> à-þ (кроме ×)
+        if (c >= 0x0410 && c <= 0x042F) return c + 0x20;  // А-Я -> а-я
+        if (c >= 0x0400 && c <= 0x040F) return c + 0x50;  // Ѐ-Џ -> ѐ-џ
+        return c;
+    }
+
+    // Свертка регистра, обрезка краевых пробелов и схлопывание повторных
+    static std::u32string fold(const std::string& text) {
+        std::u32string result;
+        for (char32_t c : decodeUtf8(text)) {
+            bool space = c == U' ' || c == U'\t';
+            if (space && (result.empty() || result.back() == U' ')) continue;
+            result.push_back(space ? U' ' : foldChar(c));
+        }
+        if (!result.empty() && result.back() == U' ') result.pop_back();
+        return result;
+    }
+
+    // Триграммы строки, дополненной пробелом с обеих сторон
+    template<typename Callback>
+    static void forEachTrigram(const std::u32string& text, Callback callback) {
+        std::u32string padded = U" " + text + U" ";
+        for (std::size_t i = 0; i + 2 < padded.size(); ++i) {
+            callback((static_cast<std::uint64_t>(padded[i]) << 42) |
+                     (static_cast<std::uint64_t>(padded[i + 1]) << 21) | padded[i + 2]);
+        }
+    }
+
+    // Расстояние Левенштейна с отсечением: limit + 1, если расстояние больше limit
+    static int boundedDistance(const std::u32string& a, const std::u32string& b, int limit) {
+        int lengthDiff = static_cast<int>(a.size()) - static_cast<int>(b.size());
+        if (std::abs(lengthDiff) > limit) return limit + 1;
+
+        // Считается только полоса |i - j| <= limit, клетки вне ее равны limit + 1
+        const int outside = limit + 1;
+        const int m = static_cast<int>(b.size());
+        thread_local std::vector<int> previous, current;
+        previous.resize(b.size() + 2);
+        current.resize(b.size() + 2);
+        for (int j = 0; j <= m + 1; ++j) previous[j] = j <= limit ? j : outside;
+
+        for (int i = 1; i <= static_cast<int>(a.size()); ++i) {
+            int low = std::max(1, i - limit);
+            int high = std::min(m, i + limit);
+            current[low - 1] = low == 1 ? std::min(i, outside) : outside;
+            int rowMin = current[low - 1];
+            for (int j = low; j <= high; ++j) {
+                int substitution = previous[j - 1] + (a[i - 1] == b[j - 1] ? 0 : 1);
+                current[j] = std::min({previous[j] + 1, current[j - 1] + 1, substitution, outside});
+                rowMin = std::min(rowMin, current[j]);
+            }
+            current[high + 1] = outside;
+            if (rowMin > limit) return outside;
+            std::swap(previous, current);
+        }
+        return previous[m];
+    }
+
+    static int defaultMaxDistance(std::size_t length) {
+        return std::max(1, static_cast<int>(length) / 4);
+    }
+
+    // Диапазон order с названиями, начинающимися с prefix: оба конца ищутся двоичным поиском,
+    // для верхнего названия сравниваются с prefix только по его длине
+    std::pair<std::size_t, std::size_t> prefixRange(const std::u32string& prefix) const {
+        auto first = std::lower_bound(order.begin(), order.end(), prefix,
+            [this](std::uint32_t index, const std::u32string& value) { return entries[index].folded < value; });
+        auto last = std::upper_bound(first, order.end(), prefix,
+            [this](const std::u32string& value, std::uint32_t index) {
+                return entries[index].folded.compare(0, value.size(), value) > 0;
+            });
+        return {static_cast<std::size_t>(first - order.begin()), static_cast<std::size_t>(last - order.begin())};
+    }
+
+public:
+    void add(int stopId, const std::string& name) {
+        auto index = static_cast<std::uint32_t>(entries.size());
+        entries.push_back({fold(name), stopId, name});
+
+        const std::u32string& folded = entries.back().folded;
+        auto pos = std::upper_bound(order.begin(), order.end(), folded,
+            [this](const std::u32string& value, std::uint32_t other) { return value < entries[other].folded; });
+        order.insert(pos, index);
+
+        forEachTrigram(folded, [&](std::uint64_t key) {
+            auto& list = trigrams[key];
+            if (list.empty() || list.back() != index) list.push_back(index);
+        });
+    }
+
+    // Автодополнение: первые limit названий, начинающихся с prefix (в алфавитном порядке)
+    std::vector<Match> complete(const std::string& prefix, std::size_t limit) const {
+        std::vector<Match> result;
+        auto [first, last] = prefixRange(fold(prefix));
+        for (std::size_t i = first; i < last && result.size() < limit; ++i) {
+            const Entry& entry = entries[order[i]];
+            result.push_back({entry.stopId, entry.name, 0});
+        }
+        return result;
+    }
+
+    // Поиск с опечатками: кандидаты отбираются по общим триграммам
+    // (каждая правка разрушает не больше трех), затем проверяются расстоянием Левенштейна
+    std::vector<Match> findSimilar(const std::string& query, std::size_t limit, int maxDistance = -1) const {
+        std::u32string folded = fold(query);
+        if (maxDistance < 0) maxDistance = defaultMaxDistance(folded.size());
+
+        std::vector<std::pair<int, std::uint32_t>> scored;
+        int required = static_cast<int>(folded.size()) - 3 * maxDistance;
+        if (required <= 0) {
+            // Короткий запрос: фильтр триграмм ничего не отсекает, проверяем все названия
+            for (std::uint32_t i = 0; i < entries.size(); ++i) {
+                int distance = boundedDistance(folded, entries[i].folded, maxDistance);
+                if (distance <= maxDistance) scored.push_back({distance, i});
+            }
+        } else {
+            thread_local std::vector<int> shared;
+            thread_local std::vector<std::uint32_t> touched;
+            shared.assign(entries.size(), 0);
+            touched.clear();
+
+            forEachTrigram(folded, [&](std::uint64_t key) {
+                auto it = trigrams.find(key);
+                if (it == trigrams.end()) return;
+                for (std::uint32_t index : it->second) {
+                    if (shared[index]++ == 0) touched.push_back(index);
+                }
+            });
+
+            // Кандидаты с большим числом общих триграмм проверяются первыми; когда набрано
+            // limit вариантов, порог расстояния и требуемое число триграмм ужесточаются
+            std::vector<std::pair<int, std::uint32_t>> candidates;
+            for (std::uint32_t index : touched) {
+                if (shared[index] >= required) candidates.push_back({shared[index], index});
+            }
+            std::sort(candidates.begin(), candidates.end(), std::greater<>());
+
+            int currentLimit = maxDistance;
+            for (const auto& [count, index] : candidates) {
+                if (count < static_cast<int>(folded.size()) - 3 * currentLimit) break;
+                int distance = boundedDistance(folded, entries[index].folded, currentLimit);
+                if (distance > currentLimit) continue;
+                scored.push_back({distance, index});
+                if (scored.size() >= limit) {
+                    std::nth_element(scored.begin(), scored.begin() + (limit - 1), scored.end());
+                    scored.resize(limit);
+                    currentLimit = std::min(currentLimit, scored[limit - 1].first);
+                }
+            }
+        }
+
+        std::size_t count = std::min(limit, scored.size());
+        std::partial_sort(scored.begin(), scored.begin() + count, scored.end(),
+            [this](const auto& a, const auto& b) {
+                return a.first != b.first ? a.first < b.first : entries[a.second].folded < entries[b.second].folded;
+            });
+
+        std::vector<Match> result;
+        for (std::size_t i = 0; i < count; ++i) {
+            const Entry& entry = entries[scored[i].second];
+            result.push_back({entry.stopId, entry.name, scored[i].first});
+        }
+        return result;
+    }
+
+    // Однозначное сопоставление ввода с остановкой: точное совпадение без учета регистра,
+    // единственное продолжение префикса или единственный ближайший вариант с опечаткой
+    std::optional<Match> resolve(const std::string& input) const {
+        std::u32string folded = fold(input);
+        if (folded.empty()) return std::nullopt;
+
+        auto [first, last] = prefixRange(folded);
+        if (first < last && entries[order[first]].folded == folded) {
+            const Entry& entry = entries[order[first]];
+            return Match{entry.stopId, entry.name, 0};
+        }
+        if (last - first == 1) {
+            const Entry& entry = entries[order[first]];
+            return Match{entry.stopId, entry.name, 0};
+        }
+        if (first < last) {
+            return std::nullopt; // несколько продолжений - нужен выбор пользователя
+        }
+
+        auto similar = findSimilar(input, 2);
+        if (similar.size() == 1 || (similar.size() == 2 && similar[0].distance < similar[1].distance)) {
+            return similar[0];
+        }
+        return std::nullopt;
+    }
+
+    std::size_t size() const { return entries.size(); }
+
+    std::size_t getMemoryBytes() const {
+        std::size_t bytes = entries.capacity() * sizeof(Entry) + order.capacity() * sizeof(std::uint32_t);
+        for (const auto& entry : entries) {
+            bytes += ComponentMemory::stringBytes(entry.folded) + ComponentMemory::stringBytes(entry.name);
+        }
+        for (const auto& [key, list] : trigrams) {
+            bytes += list.capacity() * sizeof(std::uint32_t);
+        }
+        return bytes;
+    }
+};
+
+// Остановка шаблона рейсов: дескриптор шаблона и позиция остановки в маршруте
+struct TemplateStop {
+    EntityHandle pattern;
+    std::uint32_t stopPosition;
+};
+
+// Событие реального времени от бортового оборудования (фиксированный размер, без кучи)
+struct LiveEvent {
+    char licensePlate[32];
+    std::int64_t timestamp;   // Unix-время, секунды
+    int stopId;
+    int delayMinutes;         // отклонение от плана: >0 опоздание, <0 опережение
+};
+
+// Событие, сопоставленное с транспортным средством и ожидающее применения
+struct LiveUpdate {
+    EntityHandle vehicle;
+    std::int64_t timestamp;
+    int stopId;
+    int delayMinutes;
+};
+
+// Ограниченный кольцевой буфер без блокировок: один писатель, несколько читателей.
+// Каждая ячейка хранит номер последовательности, по которому читатели
+// определяют, заполнена ли она
+template<typename T, std::size_t Capacity>
+class SpmcRingBuffer {
+private:
+    static_assert((Capacity & (Capacity - 1)) == 0, "Емкость должна быть степенью двойки");
+    static constexpr std::size_t MASK = Capacity - 1;
+
+    struct Cell {
+        std::atomic<std::size_t> sequence;
+        T value;
+    };
+
+    std::unique_ptr<Cell[]> cells;
+    alignas(64) std::atomic<std::size_t> head{0}; // следующая запись (только писатель)
+    alignas(64) std::atomic<std::size_t> tail{0}; // следующее чтение
+
+public:
+    SpmcRingBuffer() : cells(new Cell[Capacity]) {
+        for (std::size_t i = 0; i < Capacity; ++i) {
+            cells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    bool tryPush(const T& value) {
+        std::size_t pos = head.load(std::memory_order_relaxed);
+        Cell& cell = cells[pos & MASK];
+        if (cell.sequence.load(std::memory_order_acquire) != pos) {
+            return false; // буфер заполнен
+        }
+        cell.value = value;
+        cell.sequence.store(pos + 1, std::memory_order_release);
+        head.store(pos + 1, std::memory_order_relaxed);
+        return true;
+    }
+
+    bool tryPop(T& out) {
+        std::size_t pos = tail.load(std::memory_order_relaxed);
+        while (true) {
+            Cell& cell = cells[pos & MASK];
+            std::size_t sequence = cell.sequence.load(std::memory_order_acquire);
+            auto diff = static_cast<std::ptrdiff_t>(sequence) - static_cast<std::ptrdiff_t>(pos + 1);
+            if (diff == 0) {
+                if (tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    out = cell.value;
+                    cell.sequence.store(pos + Capacity, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false; // буфер пуст
+            } else {
+                pos = tail.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    std::size_t sizeApprox() const {
+        std::size_t h = head.load(std::memory_order_relaxed);
+        std::size_t t = tail.load(std::memory_order_relaxed);
+        return h > t ? h - t : 0;
+    }
+};
+
+// Источник строк событий: обычный файл или именованный канал. Открытие не ждет писателя
+// канала, а ожидание данных ограничено таймаутом, поэтому читающий поток
+// успевает заметить запрос остановки. Реализация зависит от платформы (TransportCore.cpp)
+class LiveEventSource {
+public:
+    enum class Status { Line, Timeout, End };
+
+private:
+#ifdef _WIN32
+    void* handle = nullptr;
+    bool isPipe = false;
+#else
+    int fd = -1;
+#endif
+    std::string buffer;
+    std::size_t consumed = 0; // начало еще не выданной строки
+    std::size_t scanned = 0;  // часть буфера, уже проверенная на конец строки
+    bool endOfInput = false;
+
+    // Дочитать данные в буфер; false - данных нет до истечения таймаута
+    bool fill(int timeoutMs);
+
+public:
+    explicit LiveEventSource(const std::string& path);
+    ~LiveEventSource();
+    LiveEventSource(const LiveEventSource&) = delete;
+    LiveEventSource& operator=(const LiveEventSource&) = delete;
+
+    // Следующая строка без завершающего перевода строки
+    Status next(std::string& line, int timeoutMs);
+};
+
+// Прием событий реального времени: поток-писатель читает файл или канал в кольцевой буфер,
+// потоки-читатели пачками сопоставляют номерные знаки с транспортом и складывают
+// обновления в очередь. Применяет их поток запросов, не дожидаясь приема
+class LiveEventIngestor {
+public:
+    struct Stats {
+        std::size_t produced;
+        std::size_t consumed;
+        std::size_t applied;
+        std::size_t unresolved;
+        std::size_t malformed;
+        std::size_t backlog;        // события в буфере и в очереди на применение
+        std::int64_t lagSeconds;    // задержка последнего примененного события
+        bool running;
+    };
+
+private:
+    static constexpr std::size_t RING_CAPACITY = 8192;
+
+    SpmcRingBuffer<LiveEvent, RING_CAPACITY> ring;
+    std::unordered_map<std::string, EntityHandle> vehicleByPlate; // снимок на момент запуска
+    std::size_t batchSize;
+    unsigned consumerCount;
+
+    std::unique_ptr<LiveEventSource> source;
+    std::thread producer;
+    std::vector<std::thread> consumers;
+    std::atomic<bool> producerDone{false};
+    std::atomic<bool> stopRequested{false};
+
+    std::mutex pendingMutex;
+    std::vector<LiveUpdate> pending;
+
+    std::atomic<std::size_t> produced{0};
+    std::atomic<std::size_t> consumed{0};
+    std::atomic<std::size_t> applied{0};
+    std::atomic<std::size_t> unresolved{0};
+    std::atomic<std::size_t> malformed{0};
+    std::atomic<std::size_t> pendingCount{0};
+    std::atomic<std::int64_t> lagSeconds{0};
+
+    // Строка: номерной_знак|unix_время|ID_остановки|задержка_мин
+    bool parseLine(const std::string& line, LiveEvent& event) const {
+        std::size_t first = line.find('|');
+        std::size_t second = first == std::string::npos ? first : line.find('|', first + 1);
+        std::size_t third = second == std::string::npos ? second : line.find('|', second + 1);
+        if (third == std::string::npos || first == 0 || first >= sizeof(event.licensePlate)) {
+            return false;
+        }
+
+        char* end = nullptr;
+        const char* text = line.c_str();
+        event.timestamp = std::strtoll(text + first + 1, &end, 10);
+        if (end != text + second) return false;
+        event.stopId = static_cast<int>(std::strtol(text + second + 1, &end, 10));
+        if (end != text + third) return false;
+        event.delayMinutes = static_cast<int>(std::strtol(text + third + 1, &end, 10));
+        if (end == text + third + 1) return false;
+
+        line.copy(event.licensePlate, first);
+        event.licensePlate[first] = '\0';
+        return true;
+    }
+
+    // Таймаут ожидания источника: с такой задержкой писатель замечает запрос остановки
+    static constexpr int SOURCE_POLL_MS = 100;
+
+    void produce() {
+        std::string line;
+        LiveEvent event{};
+        while (!stopRequested.load(std::memory_order_relaxed)) {
+            LiveEventSource::Status status = source->next(line, SOURCE_POLL_MS);
+            if (status == LiveEventSource::Status::End) break;
+            if (status == LiveEventSource::Status::Timeout) continue;
+            if (!line.empty() && line.back() == '\r') line.pop_back();
+            if (line.empty()) continue;
+            if (!parseLine(line, event)) {
+                malformed.fetch_add(1, std::memory_order_relaxed);
+                continue;
+            }
+            // Буфер ограничен: при переполнении писатель ждет читателей
+            while (!ring.tryPush(event)) {
+                if (stopRequested.load(std::memory_order_relaxed)) return;
+                std::this_thread::yield();
+            }
+            produced.fetch_add(1, std::memory_order_relaxed);
+        }
+        producerDone.store(true, std::memory_order_release);
+    }
+
+    void consume() {
+        std::vector<LiveUpdate> batch;
+        batch.reserve(batchSize);
+        LiveEvent event;
+
+        while (!stopRequested.load(std::memory_order_relaxed)) {
+            while (batch.size() < batchSize && ring.tryPop(event)) {
+                consumed.fetch_add(1, std::memory_order_relaxed);
+                auto it = vehicleByPlate.find(event.licensePlate);
+                if (it == vehicleByPlate.end()) {
+                    unresolved.fetch_add(1, std::memory_order_relaxed);
+                    continue;
+                }
+                batch.push_back({it->second, event.timestamp, event.stopId, event.delayMinutes});
+            }
+
+            if (!batch.empty()) {
+                std::lock_guard<std::mutex> lock(pendingMutex);
+                pending.insert(pending.end(), batch.begin(), batch.end());
+                pendingCount.store(pending.size(), std::memory_order_relaxed);
+                batch.clear();
+                continue;
+            }
+
+            if (producerDone.load(std::memory_order_acquire) && ring.sizeApprox() == 0) {
+                break;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+
+public:
+    LiveEventIngestor(std::unordered_map<std::string, EntityHandle> vehicles,
+                      unsigned consumerThreads = 2, std::size_t batch = 256)
+        : vehicleByPlate(std::move(vehicles)), batchSize(batch),
+          consumerCount(std::max(1u, consumerThreads)) {}
+
+    ~LiveEventIngestor() {
+        stop();
+    }
+
+    // Источник - обычный файл или именованный канал; канал без писателя не блокирует запуск
+    void start(const std::string& path) {
+        source = std::make_unique<LiveEventSource>(path);
+        producer = std::thread(&LiveEventIngestor::produce, this);
+        for (unsigned i = 0; i < consumerCount; ++i) {
+            consumers.emplace_back(&LiveEventIngestor::consume, this);
+        }
+    }
+
+    void stop() {
+        stopRequested.store(true);
+        if (producer.joinable()) producer.join();
+        for (auto& consumer : consumers) {
+            if (consumer.joinable()) consumer.join();
+        }
+        consumers.clear();
+        source.reset();
+    }
+
+    // Забрать накопленные обновления; если очередь занята читателем, вернуть пустой список
+    std::vector<LiveUpdate> takePending() {
+        std::vector<LiveUpdate> result;
+        std::unique_lock<std::mutex> lock(pendingMutex, std::try_to_lock);
+        if (lock.owns_lock()) {
+            result.swap(pending);
+            pendingCount.store(0, std::memory_order_relaxed);
+        }
+        return result;
+    }
+
+    void recordApplied(std::size_t appliedCount, std::size_t unresolvedCount, std::int64_t lag) {
+        applied.fetch_add(appliedCount, std::memory_order_relaxed);
+        unresolved.fetch_add(unresolvedCount, std::memory_order_relaxed);
+        lagSeconds.store(lag, std::memory_order_relaxed);
+    }
+
+    Stats getStats() const {
+        bool consumersActive = producerDone.load() ? ring.sizeApprox() > 0 : true;
+        return {produced.load(), consumed.load(), applied.load(), unresolved.load(), malformed.load(),
+                ring.sizeApprox() + pendingCount.load(), lagSeconds.load(),
+                !stopRequested.load() && consumersActive};
+    }
+};
+
+// Отложенная загрузка рейсов: индекс строк trips.txt по маршрутам. Рейсы маршрута
+// читаются из файла при первом обращении; загруженные маршруты вытесняются в порядке
+// давности обращения, когда оценка их памяти превышает лимит
+class LazyTripStore {
+public:
+    static constexpr std::size_t DEFAULT_MEMORY_LIMIT = 64 * 1024 * 1024;
+
+private:
+    struct LineRef {
+        std::uint64_t offset;
+        std::uint32_t length;
+    };
+
+    struct RouteEntry {
+        std::vector<LineRef> lines;
+        bool loaded = false;
+        bool pinned = false;        // рейсы изменены в памяти, перечитать их из файла нельзя
+        std::size_t bytes = 0;      // оценка памяти загруженных рейсов
+        CountedList<int, MemoryComponent::LazyTrips>::iterator recent;
+    };
+
+    std::string path;
+    CountedHashMap<int, RouteEntry, MemoryComponent::LazyTrips> routes;                         // по номеру маршрута
+    std::vector<std::pair<int, int>> tripRoutes;                         // (ID рейса, маршрут), по ID
+    CountedHashMap<std::string, std::vector<int>, MemoryComponent::LazyTrips> routesByVehicle;  // номер ТС -> маршруты
+    CountedHashMap<std::string, std::vector<int>, MemoryComponent::LazyTrips> routesByStop;
+
+    // Загруженные и не закрепленные маршруты, последний использованный в начале
+    CountedList<int, MemoryComponent::LazyTrips> recent;
+    std::size_t loadedBytes = 0;
+    std::size_t memoryLimit;
+
+    // Поле номер index строки рейса (поля разделены '|')
+    static std::string_view field(std::string_view line, int index) {
+        std::size_t begin = 0;
+        for (int i = 0; i < index; ++i) {
+            begin = line.find('|', begin);
+            if (begin == std::string_view::npos) return {};
+            ++begin;
+        }
+        std::size_t end = line.find('|', begin);
+        return line.substr(begin, end == std::string_view::npos ? line.size() - begin : end - begin);
+    }
+
+    static bool parseInt(std::string_view text, int& value) {
+        auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), value);
+        return error == std::errc() && end == text.data() + text.size();
+    }
+
+    template<typename Map>
+    static const std::vector<int>* findList(const Map& map, const std::string& key) {
+        auto it = map.find(key);
+        return it != map.end() ? &it->second : nullptr;
+    }
+
+public:
+    explicit LazyTripStore(std::size_t limit = DEFAULT_MEMORY_LIMIT) : memoryLimit(limit) {}
+
+    // Построение индекса по файлу. При повторном сканировании (после перезаписи файла)
+    // состояние известных маршрутов сохраняется, а новые маршруты уже находятся в памяти
+    void scan(const std::string& file, bool initial) {
+        std::ifstream input(file, std::ios::binary);
+        if (!input.is_open()) throw TransportException("Не удалось открыть файл " + file);
+
+        CountedHashMap<int, RouteEntry, MemoryComponent::LazyTrips> scanned;
+        std::vector<std::pair<int, int>> scannedTrips;
+        CountedHashMap<std::string, std::vector<int>, MemoryComponent::LazyTrips> vehicles;
+        std::string line;
+        std::uint64_t offset = 0;
+        while (std::getline(input, line)) {
+            std::uint64_t lineOffset = offset;
+            offset += line.size() + 1;
+            if (!line.empty() && line.back() == '\r') line.pop_back();
+
+            // Строки без номера рейса или маршрута сообщат об ошибке при полной загрузке
+            int tripId, routeNumber;
+            if (!parseInt(field(line, 0), tripId) || !parseInt(field(line, 1), routeNumber)) continue;
+
+            scanned[routeNumber].lines.push_back({lineOffset, static_cast<std::uint32_t>(line.size())});
+            scannedTrips.push_back({tripId, routeNumber});
+            auto& vehicleRoutes = vehicles[std::string(field(line, 6))];
+            if (vehicleRoutes.empty() || vehicleRoutes.back() != routeNumber) {
+                vehicleRoutes.push_back(routeNumber);
+            }
+        }
+
+        for (auto& [number, entry] : scanned) {
+            auto old = routes.find(number);
+            if (old != routes.end()) {
+                entry.loaded = old->second.loaded;
+                entry.pinned = old->second.pinned;
+                entry.bytes = old->second.bytes;
+                entry.recent = old->second.recent;
+                routes.erase(old);
+            } else if (!initial) {
+                entry.loaded = entry.pinned = true;
+            }
+        }
+        for (const auto& [number, entry] : routes) {
+            if (entry.loaded && !entry.pinned) {
+                recent.erase(entry.recent);
+                loadedBytes -= entry.bytes;
+            }
+        }
+
+        for (auto& [plate, list] : vehicles) {
+            std::sort(list.begin(), list.end());
+            list.erase(std::unique(list.begin(), list.end()), list.end());
+        }
+        std::sort(scannedTrips.begin(), scannedTrips.end());
+
+        path = file;
+        routes = std::move(scanned);
+        tripRoutes = std::move(scannedTrips);
+        routesByVehicle = std::move(vehicles);
+    }
+
+    // Индекс строк файла для кэша индексов (состояние загрузки маршрутов не сохраняется)
+    void writeIndex(BinaryWriter& out) const {
+        out.value(static_cast<std::uint32_t>(routes.size()));
+        for (const auto& [number, entry] : routes) {
+            out.value(number);
+            out.array(entry.lines);
+        }
+        std::vector<int> pairs;
+        pairs.reserve(2 * tripRoutes.size());
+        for (const auto& [tripId, routeNumber] : tripRoutes) {
+            pairs.push_back(tripId);
+            pairs.push_back(routeNumber);
+        }
+        out.array(pairs);
+        out.value(static_cast<std::uint32_t>(routesByVehicle.size()));
+        for (const auto& [plate, list] : routesByVehicle) {
+            out.string(plate);
+            out.array(list);
+        }
+    }
+
+    // Замена начального сканирования файла: все маршруты еще не загружены
+    void readIndex(BinaryReader& in, const std::string& file) {
+        auto routeCount = in.value<std::uint32_t>();
+        for (std::uint32_t i = 0; i < routeCount; ++i) {
+            int number = in.value<int>();
+            routes[number].lines = in.array<LineRef>();
+        }
+        auto pairs = in.array<int>();
+        for (std::size_t i = 0; i + 1 < pairs.size(); i += 2) {
+            tripRoutes.push_back({pairs[i], pairs[i + 1]});
+        }
+        auto vehicleCount = in.value<std::uint32_t>();
+        for (std::uint32_t i = 0; i < vehicleCount; ++i) {
+            std::string plate = in.string();
+            routesByVehicle[plate] = in.array<int>();
+        }
+        path = file;
+    }
+
+    // Маршруты, проходящие через остановку, для загрузки по запросу к ней
+    void indexRouteStops(int routeNumber, const std::vector<std::string>& stops) {
+        if (!routes.count(routeNumber)) return;
+        for (const auto& stop : stops) {
+            auto& list = routesByStop[stop];
+            if (list.empty() || list.back() != routeNumber) list.push_back(routeNumber);
+        }
+    }
+
+    bool isPending(int routeNumber) const {
+        auto it = routes.find(routeNumber);
+        return it != routes.end() && !it->second.loaded;
+    }
+
+    const std::vector<int>* routesAtStop(const std::string& stop) const { return findList(routesByStop, stop); }
+    const std::vector<int>* routesOfVehicle(const std::string& plate) const { return findList(routesByVehicle, plate); }
+
+    std::optional<int> routeOfTrip(int tripId) const {
+        auto it = std::lower_bound(tripRoutes.begin(), tripRoutes.end(),
+                                   std::make_pair(tripId, std::numeric_limits<int>::min()));
+        if (it == tripRoutes.end() || it->first != tripId || !routes.count(it->second)) return std::nullopt;
+        return it->second;
+    }
+
+    std::vector<int> getPendingRoutes() const {
+        std::vector<int> result;
+        for (const auto& [number, entry] : routes) {
+            if (!entry.loaded) result.push_back(number);
+        }
+        std::sort(result.begin(), result.end());
+        return result;
+    }
+
+    // Строки рейсов маршрута в порядке файла
+    std::vector<std::string> readLines(int routeNumber) const {
+        std::vector<std::string> result;
+        auto it = routes.find(routeNumber);
+        if (it == routes.end()) return result;
+
+        std::ifstream input(path, std::ios::binary);
+        if (!input.is_open()) throw TransportException("Не удалось открыть файл " + path);
+        for (const LineRef& ref : it->second.lines) {
+            std::string line(ref.length, '\0');
+            input.seekg(static_cast<std::streamoff>(ref.offset));
+            if (!input.read(line.data(), ref.length)) {
+                throw TransportException("Файл " + path + " изменен после построения индекса");
+            }
+            result.push_back(std::move(line));
+        }
+        return result;
+    }
+
+    // Незагруженные рейсы переписываются в новый файл без разбора
+    void copyPendingLines(std::ostream& out) const {
+        for (int number : getPendingRoutes()) {
+            for (const auto& line : readLines(number)) {
+                out << line << "\n";
+            }
+        }
+    }
+
+    void markLoaded(int routeNumber, std::size_t bytes) {
+        RouteEntry& entry = routes.at(routeNumber);
+        entry.loaded = true;
+        entry.bytes = bytes;
+        if (!entry.pinned) {
+            entry.recent = recent.insert(recent.begin(), routeNumber);
+            loadedBytes += bytes;
+        }
+    }
+
+    void touch(int routeNumber) {
+        auto it = routes.find(routeNumber);
+        if (it != routes.end() && it->second.loaded && !it->second.pinned) {
+            recent.splice(recent.begin(), recent, it->second.recent);
+        }
+    }
+
+    void pin(int routeNumber) {
+        auto it = routes.find(routeNumber);
+        if (it == routes.end() || it->second.pinned) return;
+        if (it->second.loaded) {
+            recent.erase(it->second.recent);
+            loadedBytes -= it->second.bytes;
+        }
+        it->second.pinned = true;
+    }
+
+    // Маршрут удален из системы: его строки больше не загружаются
+    void forgetRoute(int routeNumber) {
+        pin(routeNumber);
+        routes.erase(routeNumber);
+    }
+
+    // Давно не использованные маршруты сверх лимита памяти; они помечаются незагруженными
+    std::vector<int> takeEvictions() {
+        std::vector<int> evicted;
+        while (loadedBytes > memoryLimit && !recent.empty()) {
+            int number = recent.back();
+            recent.pop_back();
+            RouteEntry& entry = routes.at(number);
+            entry.loaded = false;
+            loadedBytes -= entry.bytes;
+            entry.bytes = 0;
+            evicted.push_back(number);
+        }
+        return evicted;
+    }
+
+    void setMemoryLimit(std::size_t limit) { memoryLimit = limit; }
+    std::size_t getMemoryLimit() const { return memoryLimit; }
+    std::size_t getLoadedBytes() const { return loadedBytes; }
+    std::size_t getRouteCount() const { return routes.size(); }
+
+    std::size_t getLoadedRouteCount() const {
+        return static_cast<std::size_t>(std::count_if(routes.begin(), routes.end(),
+            [](const auto& item) { return item.second.loaded; }));
+    }
+
+    std::size_t getMemoryBytes() const {
+        std::size_t bytes = sizeof(LazyTripStore) + ComponentMemory::stringBytes(path) +
+                            tripRoutes.capacity() * sizeof(std::pair<int, int>);
+        for (const auto& [number, entry] : routes) {
+            bytes += entry.lines.capacity() * sizeof(LineRef);
+        }
+        for (const auto* map : {&routesByVehicle, &routesByStop}) {
+            for (const auto& [key, list] : *map) {
+                bytes += ComponentMemory::stringBytes(key) + list.capacity() * sizeof(int);
+            }
+        }
+        return bytes;
+    }
+};
+
+// Загрузка рейсов: все сразу при запуске или по требованию с лимитом памяти загруженных
+struct TripLoadingOptions {
+    bool onDemand = false;
+    std::size_t memoryLimit = LazyTripStore::DEFAULT_MEMORY_LIMIT;
+};
+
+// Разобранный рейс в кэше: маршрут, транспорт и водитель записаны ключами поиска,
+// расписание - смещениями профиля. Восстановление не разбирает текст строки trips.txt
+struct CachedTrip {
+    int tripId = 0;
+    int routeNumber = 0;
+    std::string licensePlate;
+    std::string firstName;
+    std::string lastName;
+    std::string middleName;
+    int startMinutes = 0;
+    int calendarId = 0;
+    std::vector<int> offsets; // пустой - расписание не рассчитано
+
+    static CachedTrip of(const Trip& trip) {
+        CachedTrip cached;
+        cached.tripId = trip.getTripId();
+        cached.routeNumber = trip.getRoute()->getNumber();
+        cached.licensePlate = trip.getVehicle()->getLicensePlate();
+        cached.firstName = trip.getDriver()->getFirstName();
+        cached.lastName = trip.getDriver()->getLastName();
+        cached.middleName = trip.getDriver()->getMiddleName();
+        cached.startMinutes = trip.getStartTime().getTotalMinutes();
+        cached.calendarId = trip.getCalendarId();
+        if (trip.getPattern()) cached.offsets = trip.getPattern()->getOffsets();
+        return cached;
+    }
+
+    void write(BinaryWriter& out) const {
+        out.value(tripId);
+        out.value(routeNumber);
+        out.string(licensePlate);
+        out.string(firstName);
+        out.string(lastName);
+        out.string(middleName);
+        out.value(startMinutes);
+        out.value(calendarId);
+        out.array(offsets);
+    }
+
+    static CachedTrip read(BinaryReader& in) {
+        CachedTrip cached;
+        cached.tripId = in.value<int>();
+        cached.routeNumber = in.value<int>();
+        cached.licensePlate = in.string();
+        cached.firstName = in.string();
+        cached.lastName = in.string();
+        cached.middleName = in.string();
+        cached.startMinutes = in.value<int>();
+        cached.calendarId = in.value<int>();
+        cached.offsets = in.array<int>();
+        return cached;
+    }
+};
+
+// Производные индексы из кэша (index.cache). Разделы заполнены, только если хеш
+// исходных файлов совпал с записанным в кэше
+struct DerivedIndexCache {
+    std::uint64_t sourceHash = 0;
+    std::optional<std::vector<CachedTrip>> trips;       // рейсы в порядке файла
+    std::optional<StopTimetableIndex> stopTimetable;    // с номерами рейсов в файле вместо дескрипторов
+    std::optional<FootpathGraph> footpaths;             // переходы, построенные по координатам
+    std::unique_ptr<LazyTripStore> lazyTrips;           // индекс строк trips.txt
+};
+
+// Наблюдение за файлами данных опросом: время изменения и размер файлов сравниваются
+// с отметками последней загрузки или сохранения. Об изменении сообщается, когда файл
+// перестал меняться (две проверки подряд дали одну отметку), чтобы не читать его во время записи
+class DataFileWatcher {
+private:
+    struct Stamp {
+        std::filesystem::file_time_type modified{};
+        std::uintmax_t size = 0;
+        bool exists = false;
+
+        bool operator==(const Stamp& other) const = default;
+    };
+
+    std::string directory;
+    std::vector<std::string> files;
+    std::vector<Stamp> baseline;   // отметки последней загрузки или сохранения
+    std::vector<Stamp> observed;   // отметки предыдущей проверки
+    std::vector<bool> settled;     // файл изменен и больше не меняется
+    mutable std::mutex mutex;
+
+    std::thread poller;
+    std::atomic<bool> stopRequested{false};
+
+    Stamp stampOf(const std::string& name) const {
+        std::error_code error;
+        std::string path = directory + name;
+        Stamp stamp;
+        stamp.modified = std::filesystem::last_write_time(path, error);
+        if (error) return {};
+        stamp.size = std::filesystem::file_size(path, error);
+        stamp.exists = !error;
+        return stamp;
+    }
+
+    void poll(std::chrono::milliseconds interval) {
+        while (!stopRequested.load()) {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                for (std::size_t i = 0; i < files.size(); ++i) {
+                    Stamp current = stampOf(files[i]);
+                    settled[i] = current != baseline[i] && current == observed[i];
+                    observed[i] = current;
+                }
+            }
+            // Короткие паузы, чтобы остановка не ждала целый интервал
+            auto wakeUp = std::chrono::steady_clock::now() + interval;
+            while (!stopRequested.load() && std::chrono::steady_clock::now() < wakeUp) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(20));
+            }
+        }
+    }
+
+public:
+    DataFileWatcher(std::string dir, std::vector<std::string> names)
+        : directory(std::move(dir)), files(std::move(names)),
+          baseline(files.size()), observed(files.size()), settled(files.size(), false) {}
+
+    ~DataFileWatcher() {
+        stop();
+    }
+
+    void start(std::chrono::milliseconds interval) {
+        stop();
+        stopRequested.store(false);
+        poller = std::thread(&DataFileWatcher::poll, this, interval);
+    }
+
+    void stop() {
+        stopRequested.store(true);
+        if (poller.joinable()) poller.join();
+    }
+
+    bool isRunning() const { return poller.joinable(); }
+
+    // Текущее состояние файлов считается исходным (после загрузки, сохранения или перед перечитыванием)
+    void acknowledge() {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (std::size_t i = 0; i < files.size(); ++i) {
+            baseline[i] = observed[i] = stampOf(files[i]);
+            settled[i] = false;
+        }
+    }
+
+    // Файлы, измененные после отметки и переставшие меняться (по данным фонового опроса)
+    std::vector<std::string> getSettledChanges() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::vector<std::string> result;
+        for (std::size_t i = 0; i < files.size(); ++i) {
+            if (settled[i]) result.push_back(files[i]);
+        }
+        return result;
+    }
+
+    // Файлы, отличающиеся от отметки прямо сейчас (для перечитывания по команде)
+    std::vector<std::string> getChangedFiles() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::vector<std::string> result;
+        for (std::size_t i = 0; i < files.size(); ++i) {
+            if (stampOf(files[i]) != baseline[i]) result.push_back(files[i]);
+        }
+        return result;
+    }
+};
+
+// Итог перечитывания измененных файлов данных
+struct DataReloadStats {
+    std::vector<std::string> files;
+    bool fullReload = false;            // система собрана заново (изменены не только рейсы)
+    bool succeeded = true;
+    std::size_t tripsKept = 0;
+    std::size_t tripsRemoved = 0;
+    std::size_t tripsAdded = 0;
+    bool liveIngestionStopped = false;  // дескрипторы транспорта изменились, прием нужно запустить заново
+    std::string messages;               // сообщения загрузки
+    std::chrono::milliseconds elapsed{0};
+};
+
+// Пакет изменений расписания: маршруты и рейсы, добавляемые и удаляемые вместе.
+// Применяется TransportSystem::commit целиком или не применяется совсем
+class TimetableBatch {
+private:
+    std::vector<std::shared_ptr<Route>> addedRoutes;
+    std::vector<std::shared_ptr<Trip>> addedTrips;
+    std::vector<int> removedRoutes;    // номера маршрутов (удаляются вместе с рейсами)
+    std::vector<int> removedTrips;     // ID рейсов
+
+    friend class TransportSystem;
+
+public:
+    void addRoute(std::shared_ptr<Route> route) { addedRoutes.push_back(std::move(route)); }
+    void addTrip(std::shared_ptr<Trip> trip) { addedTrips.push_back(std::move(trip)); }
+    void removeRoute(int routeNumber) { removedRoutes.push_back(routeNumber); }
+    void removeTrip(int tripId) { removedTrips.push_back(tripId); }
+
+    std::size_t size() const {
+        return addedRoutes.size() + addedTrips.size() + removedRoutes.size() + removedTrips.size();
+    }
+
+    bool empty() const { return size() == 0; }
+
+    void clear() {
+        addedRoutes.clear();
+        addedTrips.clear();
+        removedRoutes.clear();
+        removedTrips.clear();
+    }
+};
+
+// Итог применения пакета изменений
+struct TimetableBatchResult {
+    std::size_t routesAdded = 0;
+    std::size_t routesRemoved = 0;
+    std::size_t tripsAdded = 0;
+    std::size_t tripsRemoved = 0;      // вместе с рейсами удаленных маршрутов
+};
+
+// Строка расписания остановки: маршрут и время прибытия
+struct TimetableRow {
+    int routeNumber;
+    Time arrival;
+};
+
+// Расписание остановки за интервал времени, строки упорядочены по прибытию
+struct StopTimetable {
+    std::string stopName;
+    Time from;
+    Time to;
+    std::optional<ServiceDate> date;
+    std::vector<TimetableRow> rows;
+};
+
+// Прибытие рейса на остановку в рассчитанном расписании
+struct ScheduledStop {
+    std::string stop;
+    Time arrival;
+};
+
+// Класс транспортной системы
+class TransportSystem {
+private:
+    std::vector<std::shared_ptr<Route>> routes;
+    std::vector<std::shared_ptr<Trip>> trips;
+    std::vector<std::shared_ptr<Vehicle>> vehicles;
+    std::vector<std::shared_ptr<Driver>> drivers;
+    std::vector<Stop> stops;
+    CountedHashMap<int, std::string, MemoryComponent::StopIds> stopIdToName;
+    std::unordered_map<std::string, std::string> adminCredentials;
+
+    // Таблицы дескрипторов сущностей
+    HandleTable<Route> routeHandles;
+    HandleTable<Trip> tripHandles;
+    HandleTable<Vehicle> vehicleHandles;
+    HandleTable<Driver> driverHandles;
+
+    // Интервалы занятости каждого транспортного средства (по дескриптору)
+    CountedHashMap<EntityHandle, IntervalIndex, MemoryComponent::VehicleIntervals> vehicleIntervals;
+
+    // Индексы рейсов: по ID и по остановкам
+    CountedHashMap<int, EntityHandle, MemoryComponent::TripIds> tripIdToHandle;
+    StopTimetableIndex stopTimetable;
+
+    // Общие профили хода рейсов и упорядоченные отправления каждого профиля
+    TripPatternIndex tripPatterns;
+
+    // Шаблоны интервального движения и индекс их остановок
+    std::vector<std::shared_ptr<TripTemplate>> tripTemplates;
+    HandleTable<TripTemplate> templateHandles;
+    CountedHashMap<std::string, std::vector<TemplateStop>, MemoryComponent::Templates> templatesByStop;
+    std::int64_t nextRunIdBase = 0; // следующий свободный диапазон номеров отправлений шаблонов
+
+    // Индексы маршрутов: по номеру и рейсы каждого маршрута (для каскадного удаления)
+    CountedHashMap<int, EntityHandle, MemoryComponent::RouteIndex> routeNumberToHandle;
+    CountedHashMap<EntityHandle, std::vector<EntityHandle>, MemoryComponent::RouteIndex> routeTrips;
+
+    // Позиции сущностей в векторах routes и trips (по дескриптору) для удаления за O(1)
+    std::vector<std::size_t> routePosition;
+    std::vector<std::size_t> tripPosition;
+
+    // Индекс транспорта по номерному знаку
+    CountedHashMap<std::string, EntityHandle, MemoryComponent::VehiclePlates> vehicleByPlate;
+
+    // Индекс водителей по полному имени и по имени с фамилией (первый добавленный).
+    // Нужен для разбора рейсов, который ищет водителя для каждой строки
+    CountedHashMap<std::string, EntityHandle, MemoryComponent::DriverNames> driverByName;
+
+    static std::string driverNameKey(const std::string& firstName, const std::string& lastName) {
+        return firstName + "|" + lastName;
+    }
+
+    // Индекс названий остановок для автодополнения и поиска с опечатками
+    StopNameIndex stopNames;
+
+    // Пространственный индекс остановок, строится при первом запросе после изменений
+    mutable StopSpatialIndex stopLocations;
+    mutable bool stopLocationsDirty = false;
+
+    // Пешеходные переходы: из файла или по координатам остановок в радиусе FOOTPATH_RADIUS.
+    // Построенные по координатам пересчитываются при первом запросе после изменения остановок
+    mutable FootpathGraph footpaths;
+    mutable bool footpathsDirty = false;
+    bool footpathsFromFile = false;
+
+    // Перестроение индексов по запросу из константных методов: запросы могут идти из
+    // нескольких потоков, поэтому проверка флага и перестроение выполняются под мьютексом
+    mutable std::mutex derivedIndexMutex;
+
+    const StopSpatialIndex& stopLocationsLocked() const {
+        if (stopLocationsDirty) {
+            stopLocations.build(stops);
+            stopLocationsDirty = false;
+        }
+        return stopLocations;
+    }
+
+    // Прием событий реального времени и последняя примененная задержка каждого рейса
+    std::unique_ptr<LiveEventIngestor> liveIngestor;
+    std::unordered_map<EntityHandle, int> liveDelays;
+
+    // Календари обслуживания и индексы расписаний по дням. Дни с одинаковым набором
+    // действующих календарей используют общий индекс только с их рейсами
+    CountedMap<int, ServiceCalendar, MemoryComponent::Calendars> calendars;
+    mutable CountedMap<std::vector<bool>, StopTimetableIndex, MemoryComponent::Calendars> serviceDayIndexes;
+
+    // Отложенная загрузка рейсов (nullptr - все рейсы загружены при запуске)
+    std::unique_ptr<LazyTripStore> lazyTrips;
+    TripLoadingOptions tripLoading;
+
+    // Расписание по остановкам не строится при регистрации рейсов: его заменит индекс из кэша
+    bool stopTimetableDeferred = false;
+
+    // Изменение календарей делает индексы дней устаревшими. Изменения рейсов вносятся
+    // в построенные индексы дней так же, как в общий (см. forEachServiceDayOf)
+    void invalidateServiceDays() {
+        serviceDayIndexes.clear();
+    }
+
+    // Построенные индексы дней, в которые действует календарь рейса
+    template<typename Action>
+    void forEachServiceDayOf(int calendarId, Action action) {
+        for (auto& [activeCalendars, index] : serviceDayIndexes) {
+            if (isActiveInServiceDay(activeCalendars, calendarId)) action(index);
+        }
+    }
+
+    ServiceCalendar& requireCalendar(int calendarId) {
+        auto it = calendars.find(calendarId);
+        if (it == calendars.end()) {
+            throw TransportException("Календарь с ID " + std::to_string(calendarId) + " не найден");
+        }
+        return it->second;
+    }
+
+    // Рейс для изменения: при отложенной загрузке его маршрут читается и закрепляется в памяти
+    Trip& requireTrip(int tripId) {
+        loadTripForChange(tripId);
+        auto it = tripIdToHandle.find(tripId);
+        if (it == tripIdToHandle.end()) {
+            throw TransportException("Рейс с ID " + std::to_string(tripId) + " не найден");
+        }
+        return *tripHandles.get(it->second);
+    }
+
+    // Интервалы занятости водителя и транспорта после изменения расписания рейса
+    void refreshTripIntervals(const Trip& trip) {
+        driverSchedule.refreshTrip(trip);
+        auto& busy = vehicleIntervals[trip.getVehicle()->getHandle()];
+        if (busy.remove(trip.getTripId())) {
+            busy.insert(makeInterval(trip));
+        }
+    }
+
+    static BusyInterval makeInterval(const Trip& trip) {
+        int start = trip.getStartTime().getTotalMinutes();
+        return {start, start + trip.getDurationMinutes(), trip.getTripId(), trip.getCalendarId()};
+    }
+
+    // Условие пропуска интервалов, календари которых не имеют общих дней с calendarId:
+    // рейсы будней и выходных могут занимать один транспорт в одно время суток
+    auto ignoreOtherDays(int calendarId) const {
+        return [this, calendarId](const BusyInterval& other) {
+            return !calendarsShareDay(calendarId, other.calendarId);
+        };
+    }
+
+    // Отправления шаблона проверяются по тем же правилам, что и рейс в addTrip: транспорт
+    // не занят другим рейсом или отправлением и успевает завершить предыдущий оборот, водитель
+    // не назначен в это время на другой рейс. Возвращает интервалы отправлений по транспорту
+    std::unordered_map<EntityHandle, std::vector<BusyInterval>> checkTemplateRuns(const TripTemplate& pattern) const {
+        std::unordered_map<EntityHandle, std::vector<BusyInterval>> byVehicle, byDriver;
+        for (int run = 0; run < pattern.getDepartureCount(); ++run) {
+            BusyInterval interval = pattern.getRunInterval(run);
+            byVehicle[pattern.getRunVehicle(run)->getHandle()].push_back(interval);
+            byDriver[pattern.getRunDriver(run)->getHandle()].push_back(interval);
+        }
+
+        auto describe = [](const BusyInterval& interval) { return Time(0, interval.start).serialize(); };
+        auto checkOwnRuns = [&describe](std::vector<BusyInterval> intervals, const std::string& who) {
+            IntervalIndex own;
+            own.insertAll(std::move(intervals));
+            auto overlaps = own.findAllOverlaps();
+            if (!overlaps.empty()) {
+                throw TransportException(who + " не успевает завершить рейс с отправлением в " +
+                                         describe(*overlaps.front().first) + " до отправления в " +
+                                         describe(*overlaps.front().second));
+            }
+        };
+
+        for (const auto& [vehicle, intervals] : byVehicle) {
+            std::string who = "Транспорт " + vehicleHandles.get(vehicle)->getLicensePlate();
+            auto busy = vehicleIntervals.find(vehicle);
+            for (const auto& interval : intervals) {
+                if (busy == vehicleIntervals.end()) break;
+                if (const BusyInterval* conflict = busy->second.findOverlapExcept(
+                        interval.start, interval.end, ignoreOtherDays(interval.calendarId))) {
+                    throw TransportException(who + " уже занят рейсом " + std::to_string(conflict->tripId) +
+                                             " во время отправления в " + describe(interval));
+                }
+            }
+            checkOwnRuns(intervals, who);
+        }
+
+        // Отправления других шаблонов у тех же водителей
+        std::unordered_map<EntityHandle, std::vector<BusyInterval>> otherRuns;
+        for (const auto& existing : tripTemplates) {
+            for (int run = 0; run < existing->getDepartureCount(); ++run) {
+                EntityHandle driver = existing->getRunDriver(run)->getHandle();
+                if (byDriver.count(driver)) {
+                    otherRuns[driver].push_back(existing->getRunInterval(run));
+                }
+            }
+        }
+        for (const auto& [driver, intervals] : byDriver) {
+            const Driver* person = driverHandles.get(driver);
+            std::string who = "Водитель " + person->getLastName() + " " + person->getFirstName();
+            IntervalIndex others;
+            auto other = otherRuns.find(driver);
+            if (other != otherRuns.end()) others.insertAll(std::move(other->second));
+            for (const auto& interval : intervals) {
+                auto otherDays = ignoreOtherDays(interval.calendarId);
+                const BusyInterval* conflict =
+                    driverSchedule.findOverlapExcept(driver, interval.start, interval.end, otherDays);
+                if (!conflict) conflict = others.findOverlapExcept(interval.start, interval.end, otherDays);
+                if (conflict) {
+                    throw TransportException(who + " уже занят рейсом " + std::to_string(conflict->tripId) +
+                                             " во время отправления в " + describe(interval));
+                }
+            }
+            checkOwnRuns(intervals, who);
+        }
+        return byVehicle;
+    }
+
+    // Регистрация рейса во всех индексах, кроме индексов дней
+    void registerTrip(std::shared_ptr<Trip> trip) {
+        // Неположительные номера заняты отправлениями шаблонов
+        if (trip->getTripId() <= 0) {
+            throw TransportException("ID рейса должен быть положительным");
+        }
+
+        // Проверка на уникальность ID рейса
+        if (tripIdToHandle.count(trip->getTripId())) {
+            throw TransportException("Рейс с ID " + std::to_string(trip->getTripId()) + " уже существует");
+        }
+
+        // Проверка, что маршрут существует
+        if (!routeHandles.contains(trip->getRoute().get())) {
+            throw TransportException("Маршрут не зарегистрирован в системе!");
+        }
+
+        if (trip->getCalendarId() != 0) {
+            requireCalendar(trip->getCalendarId());
+        }
+
+        // Проверка, что водитель существует
+        if (!driverHandles.contains(trip->getDriver().get())) {
+            throw TransportException("Водитель не зарегистрирован в системе!");
+        }
+
+        // Проверка, что транспорт существует
+        if (!vehicleHandles.contains(trip->getVehicle().get())) {
+            throw TransportException("Транспорт не зарегистрирован в системе!");
+        }
+
+        // Проверка, что транспорт не занят другим рейсом в это время
+        BusyInterval interval = makeInterval(*trip);
+        auto& busy = vehicleIntervals[trip->getVehicle()->getHandle()];
+        if (const BusyInterval* conflict =
+                busy.findOverlapExcept(interval.start, interval.end, ignoreOtherDays(interval.calendarId))) {
+            throw TransportException("Транспорт " + trip->getVehicle()->getLicensePlate() +
+                                     " уже занят рейсом " + std::to_string(conflict->tripId) +
+                                     " в это время");
+        }
+
+        busy.insert(interval);
+        EntityHandle handle = tripHandles.acquire(trip);
+        tripIdToHandle[trip->getTripId()] = handle;
+        routeTrips[trip->getRoute()->getHandle()].push_back(handle);
+        if (handle >= tripPosition.size()) tripPosition.resize(handle + 1);
+        tripPosition[handle] = trips.size();
+        if (!stopTimetableDeferred) {
+            stopTimetable.addTrip(*trip);
+        }
+        tripPatterns.addTrip(*trip);
+        driverSchedule.assignTripToDriver(trip->getDriver(), trip);
+        trips.push_back(std::move(trip));
+    }
+
+    // Удаление набора рейсов (removedHandles - их дескрипторы). Индексы обновляются пакетно:
+    // каждая затронутая остановка, водитель, транспорт и маршрут обрабатываются один раз
+    void detachTrips(const std::vector<std::shared_ptr<Trip>>& removed, const HandleSet& removedHandles) {
+        if (removed.empty()) return;
+
+        // Индексы дней изменяются так же, как общий, и остаются действительными
+        stopTimetable.removeTrips(removed, removedHandles);
+        for (auto& [activeCalendars, index] : serviceDayIndexes) {
+            index.removeTrips(removed, removedHandles);
+        }
+        driverSchedule.removeTrips(removed, removedHandles);
+        for (const auto& trip : removed) {
+            tripPatterns.removeTrip(*trip);
+        }
+
+        std::unordered_set<EntityHandle> affectedVehicles;
+        std::unordered_set<EntityHandle> affectedRoutes;
+        for (const auto& trip : removed) {
+            affectedVehicles.insert(trip->getVehicle()->getHandle());
+            affectedRoutes.insert(trip->getRoute()->getHandle());
+        }
+        for (EntityHandle vehicle : affectedVehicles) {
+            vehicleIntervals[vehicle].removeIf([&](const BusyInterval& interval) {
+                auto it = tripIdToHandle.find(interval.tripId);
+                return it != tripIdToHandle.end() && removedHandles.contains(it->second);
+            });
+        }
+        for (EntityHandle route : affectedRoutes) {
+            auto it = routeTrips.find(route);
+            if (it == routeTrips.end()) continue;
+            auto& siblings = it->second;
+            siblings.erase(std::remove_if(siblings.begin(), siblings.end(),
+                [&removedHandles](EntityHandle handle) { return removedHandles.contains(handle); }), siblings.end());
+            if (siblings.empty()) {
+                routeTrips.erase(it);
+            }
+        }
+
+        for (const auto& trip : removed) {
+            EntityHandle handle = trip->getHandle();
+            tripIdToHandle.erase(trip->getTripId());
+            liveDelays.erase(handle);
+            swapAndPop(trips, tripPosition, handle);
+            tripHandles.release(trip.get());
+        }
+    }
+
+    // Удаление рейсов маршрутов (список дескрипторов упорядочен). Возвращает число удаленных рейсов
+    std::size_t detachRouteTrips(const std::vector<EntityHandle>& routeList) {
+        std::vector<std::shared_ptr<Trip>> removed;
+        HandleSet removedHandles;
+        for (EntityHandle route : routeList) {
+            auto it = routeTrips.find(route);
+            if (it == routeTrips.end()) continue;
+            for (EntityHandle handle : it->second) {
+                removed.push_back(tripHandles.getShared(handle));
+                removedHandles.insert(handle);
+            }
+            routeTrips.erase(it);
+        }
+        detachTrips(removed, removedHandles);
+        return removed.size();
+    }
+
+    // Регистрация проверенных рейсов: прибытия, отправления профилей и интервалы занятости
+    // сливаются с индексами один раз на остановку, профиль, водителя и транспорт
+    void attachTrips(const std::vector<std::shared_ptr<Trip>>& added) {
+        std::unordered_map<EntityHandle, std::vector<BusyInterval>> incoming;
+        trips.reserve(trips.size() + added.size());
+        for (const auto& trip : added) {
+            EntityHandle handle = tripHandles.acquire(trip);
+            tripIdToHandle[trip->getTripId()] = handle;
+            routeTrips[trip->getRoute()->getHandle()].push_back(handle);
+            if (handle >= tripPosition.size()) tripPosition.resize(handle + 1);
+            tripPosition[handle] = trips.size();
+            trips.push_back(trip);
+            incoming[trip->getVehicle()->getHandle()].push_back(makeInterval(*trip));
+        }
+
+        for (auto& [vehicle, intervals] : incoming) {
+            vehicleIntervals[vehicle].insertAll(std::move(intervals));
+        }
+        if (!stopTimetableDeferred) {
+            stopTimetable.addTrips(added);
+        }
+        tripPatterns.addTrips(added);
+        driverSchedule.assignTrips(added);
+    }
+
+    // Удаление рейса из всех индексов
+    void detachTrip(int tripId) {
+        loadTripForChange(tripId);
+        auto found = tripIdToHandle.find(tripId);
+        if (found == tripIdToHandle.end()) {
+            throw TransportException("Рейс с ID " + std::to_string(tripId) + " не найден");
+        }
+
+        EntityHandle handle = found->second;
+        std::shared_ptr<Trip> trip = tripHandles.getShared(handle);
+        driverSchedule.removeTripFromDriver(trip->getDriver(), tripId);
+        vehicleIntervals[trip->getVehicle()->getHandle()].remove(tripId);
+        stopTimetable.removeTrip(*trip);
+        forEachServiceDayOf(trip->getCalendarId(), [&trip](StopTimetableIndex& index) { index.removeTrip(*trip); });
+        tripPatterns.removeTrip(*trip);
+
+        auto& siblings = routeTrips[trip->getRoute()->getHandle()];
+        auto sibling = std::find(siblings.begin(), siblings.end(), handle);
+        if (sibling != siblings.end()) {
+            *sibling = siblings.back();
+            siblings.pop_back();
+        }
+        if (siblings.empty()) {
+            routeTrips.erase(trip->getRoute()->getHandle());
+        }
+
+        tripIdToHandle.erase(found);
+        liveDelays.erase(handle);
+        swapAndPop(trips, tripPosition, handle);
+        tripHandles.release(trip.get());
+    }
+
+    // Оценка памяти рейса: объект, прибытия в индексе остановок, отправление профиля,
+    // интервал занятости и запись в индексе ID
+    static std::size_t estimateTripBytes(const Trip& trip) {
+        return sizeof(Trip) + 4 * sizeof(void*) + trip.getRoute()->getAllStops().size() * sizeof(StopEvent) +
+               sizeof(PatternDeparture) + sizeof(BusyInterval) + sizeof(std::pair<const int, EntityHandle>);
+    }
+
+    // Действует ли календарь в наборе, которым помечен индекс дня
+    bool isActiveInServiceDay(const std::vector<bool>& activeCalendars, int calendarId) const {
+        if (calendarId == 0) return true;
+        auto it = calendars.find(calendarId);
+        return it != calendars.end() && activeCalendars[std::distance(calendars.begin(), it)];
+    }
+
+    // Чтение рейсов маршрута из файла. Построенные индексы дней дополняются, а не сбрасываются,
+    // поэтому выполняющийся поиск может продолжаться после загрузки
+    void loadRouteTrips(int routeNumber) {
+        std::vector<std::shared_ptr<Trip>> loaded;
+        std::size_t bytes = 0;
+        for (const auto& line : lazyTrips->readLines(routeNumber)) {
+            try {
+                auto trip = Trip::deserialize(line, this);
+                registerTrip(trip);
+                bytes += estimateTripBytes(*trip);
+                loaded.push_back(std::move(trip));
+            } catch (const std::exception& e) {
+                dataManager.getOutput() << "Ошибка загрузки рейса: " << e.what() << "\n";
+            }
+        }
+
+        for (auto& [activeCalendars, index] : serviceDayIndexes) {
+            for (const auto& trip : loaded) {
+                if (isActiveInServiceDay(activeCalendars, trip->getCalendarId())) {
+                    index.addTrip(*trip);
+                }
+            }
+        }
+        lazyTrips->markLoaded(routeNumber, bytes);
+    }
+
+    void loadTripRoute(int routeNumber) {
+        if (lazyTrips && lazyTrips->isPending(routeNumber)) {
+            loadRouteTrips(routeNumber);
+        }
+    }
+
+    // Изменения рейса нельзя потерять при вытеснении, поэтому его маршрут закрепляется
+    void loadTripForChange(int tripId) {
+        if (!lazyTrips) return;
+        if (auto routeNumber = lazyTrips->routeOfTrip(tripId)) {
+            loadTripRoute(*routeNumber);
+            lazyTrips->pin(*routeNumber);
+        }
+    }
+
+    // Новые компоненты
+    JourneyPlanner journeyPlanner;
+    DriverSchedule driverSchedule;
+    DataManager dataManager;
+
+    // Наблюдение за файлами данных и система, собираемая из них в фоне
+    struct ReloadBuild {
+        std::unique_ptr<TransportSystem> system;  // nullptr, если загрузка прервана ошибкой
+        std::string messages;
+    };
+
+    DataFileWatcher dataWatcher;
+    std::future<ReloadBuild> pendingReload;
+    DataReloadStats pendingReloadStats;
+    std::chrono::steady_clock::time_point pendingReloadStart;
+
+    static ReloadBuild buildFromFiles() {
+        ReloadBuild build;
+        std::ostringstream messages;
+        auto fresh = std::make_unique<TransportSystem>();
+        std::ostream& previous = fresh->dataManager.getOutput();
+        fresh->dataManager.setOutput(messages);
+        bool loaded = fresh->dataManager.loadAllData(*fresh);
+        fresh->dataManager.setOutput(previous);
+        build.messages = messages.str();
+        if (loaded) {
+            build.system = std::move(fresh);
+        }
+        return build;
+    }
+
+    // Замена всех данных данными системы, собранной заново. Учетные записи администраторов,
+    // наблюдение за файлами и компоненты с указателем на систему остаются прежними
+    void adoptData(TransportSystem& fresh) {
+        using std::swap;
+        swap(routes, fresh.routes);
+        swap(trips, fresh.trips);
+        swap(vehicles, fresh.vehicles);
+        swap(drivers, fresh.drivers);
+        swap(stops, fresh.stops);
+        swap(stopIdToName, fresh.stopIdToName);
+        swap(routeHandles, fresh.routeHandles);
+        swap(tripHandles, fresh.tripHandles);
+        swap(vehicleHandles, fresh.vehicleHandles);
+        swap(driverHandles, fresh.driverHandles);
+        swap(vehicleIntervals, fresh.vehicleIntervals);
+        swap(tripIdToHandle, fresh.tripIdToHandle);
+        swap(stopTimetable, fresh.stopTimetable);
+        swap(tripPatterns, fresh.tripPatterns);
+        swap(tripTemplates, fresh.tripTemplates);
+        swap(templateHandles, fresh.templateHandles);
+        swap(templatesByStop, fresh.templatesByStop);
+        swap(nextRunIdBase, fresh.nextRunIdBase);
+        swap(routeNumberToHandle, fresh.routeNumberToHandle);
+        swap(routeTrips, fresh.routeTrips);
+        swap(routePosition, fresh.routePosition);
+        swap(tripPosition, fresh.tripPosition);
+        swap(vehicleByPlate, fresh.vehicleByPlate);
+        swap(driverByName, fresh.driverByName);
+        swap(stopNames, fresh.stopNames);
+        swap(stopLocations, fresh.stopLocations);
+        swap(stopLocationsDirty, fresh.stopLocationsDirty);
+        swap(footpaths, fresh.footpaths);
+        swap(footpathsDirty, fresh.footpathsDirty);
+        swap(footpathsFromFile, fresh.footpathsFromFile);
+        swap(liveDelays, fresh.liveDelays);
+        swap(calendars, fresh.calendars);
+        swap(serviceDayIndexes, fresh.serviceDayIndexes);
+        swap(lazyTrips, fresh.lazyTrips);
+        swap(tripLoading, fresh.tripLoading);
+        driverSchedule.swap(fresh.driverSchedule);
+    }
+
+    // Полная замена данных. Прием событий останавливается: дескрипторы транспорта в нем устарели
+    void finishFullReload(ReloadBuild build, DataReloadStats& stats) {
+        stats.fullReload = true;
+        stats.messages = std::move(build.messages);
+        if (!build.system) {
+            stats.succeeded = false;
+            return;
+        }
+        stats.liveIngestionStopped = liveIngestor != nullptr;
+        stopLiveIngestion();
+        adoptData(*build.system);
+    }
+
+    // Изменен только файл рейсов, и все рейсы в памяти: перечитывание на месте
+    bool canReloadTripsInPlace(const std::vector<std::string>& files) const {
+        return !lazyTrips && files.size() == 1 && files.front() == "trips.txt";
+    }
+
+    DataReloadStats reloadFiles(std::vector<std::string> files) {
+        auto start = std::chrono::steady_clock::now();
+        DataReloadStats stats;
+        stats.files = std::move(files);
+        if (canReloadTripsInPlace(stats.files)) {
+            std::ostringstream messages;
+            std::ostream& previous = dataManager.getOutput();
+            dataManager.setOutput(messages);
+            DataManager::TripReloadCounts counts;
+            try {
+                counts = dataManager.reloadTrips(*this);
+            } catch (...) {
+                dataManager.setOutput(previous);
+                throw;
+            }
+            dataManager.setOutput(previous);
+            stats.messages = messages.str();
+            stats.tripsKept = counts.kept;
+            stats.tripsRemoved = counts.removed;
+            stats.tripsAdded = counts.added;
+        } else {
+            finishFullReload(buildFromFiles(), stats);
+        }
+        stats.elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+        return stats;
+    }
+
+    // Фоновая сборка заменит все данные, поэтому изменения, сделанные до ее применения,
+    // были бы потеряны. Такие изменения отклоняются
+    void rejectEditDuringReload() const {
+        if (pendingReload.valid()) {
+            throw TransportException("Идет перезагрузка данных из файлов, изменение отклонено. "
+                                     "Повторите его после применения новых данных");
+        }
+    }
+
+    DataReloadStats finishPendingReload() {
+        DataReloadStats stats = std::move(pendingReloadStats);
+        finishFullReload(pendingReload.get(), stats);
+        stats.elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() -
+                                                                              pendingReloadStart);
+        return stats;
+    }
+
+public:
+    TransportSystem()
+        : journeyPlanner(this), dataManager(),
+          dataWatcher(dataManager.getDataDirectory(),
+                      {std::begin(DataManager::SOURCE_FILES), std::end(DataManager::SOURCE_FILES)}) {
+        // Инициализация учетных данных администраторов
+        adminCredentials["admin"] = "admin123";
+        adminCredentials["manager"] = "manager123";
+    }
+
+    // Аутентификация администратора
+    bool authenticateAdmin(const std::string& username, const std::string& password) {
+        auto it = adminCredentials.find(username);
+        return it != adminCredentials.end() && it->second == password;
+    }
+
+    // Добавление нового администратора
+    void addAdmin(const std::string& username, const std::string& password) {
+        adminCredentials[username] = password;
+    }
+
+    // Сохранение данных
+    // Фоновая сборка по старым файлам отбрасывается: сохраненные данные новее
+    void saveData() {
+        if (pendingReload.valid()) {
+            pendingReload.get();
+        }
+        dataManager.saveAllData(*this);
+        dataWatcher.acknowledge();
+    }
+
+    // Поток сообщений о загрузке и сохранении данных; без вызова сообщения не выводятся
+    void setDataOutput(std::ostream& stream) { dataManager.setOutput(stream); }
+
+    // Загрузка данных
+    void loadData() {
+        dataManager.loadAllData(*this);
+        dataWatcher.acknowledge();
+    }
+
+    // Наблюдение за файлами данных: изменения подхватываются между командами (applyDataReload)
+    void startDataWatch(std::chrono::milliseconds interval = std::chrono::seconds(1)) {
+        dataWatcher.start(interval);
+    }
+
+    void stopDataWatch() { dataWatcher.stop(); }
+    bool isDataWatchActive() const { return dataWatcher.isRunning(); }
+    bool isReloadPending() const { return pendingReload.valid(); }
+
+    // Файлы, измененные после последней загрузки или сохранения
+    std::vector<std::string> getChangedDataFiles() const { return dataWatcher.getChangedFiles(); }
+
+    // Перечитывание измененных файлов по команде. Если изменен только trips.txt, разбираются
+    // лишь новые и измененные строки; иначе система собирается заново и заменяет текущие данные.
+    // Начатая в фоне сборка дожидается завершения
+    DataReloadStats reloadChangedData() {
+        if (pendingReload.valid()) {
+            return finishPendingReload();
+        }
+        auto files = dataWatcher.getChangedFiles();
+        dataWatcher.acknowledge();
+        if (files.empty()) return {};
+        return reloadFiles(std::move(files));
+    }
+
+    // Применение изменений, найденных наблюдением. Вызывается потоком запросов между командами:
+    // полная сборка идет в фоне, а запросы до ее готовности обслуживаются прежними данными
+    std::optional<DataReloadStats> applyDataReload() {
+        if (pendingReload.valid()) {
+            if (pendingReload.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+                return std::nullopt;
+            }
+            return finishPendingReload();
+        }
+        if (!dataWatcher.isRunning()) return std::nullopt;
+
+        auto files = dataWatcher.getSettledChanges();
+        if (files.empty()) return std::nullopt;
+        dataWatcher.acknowledge();
+        if (canReloadTripsInPlace(files)) {
+            return reloadFiles(std::move(files));
+        }
+
+        pendingReloadStats = DataReloadStats();
+        pendingReloadStats.files = std::move(files);
+        pendingReloadStart = std::chrono::steady_clock::now();
+        pendingReload = std::async(std::launch::async, &TransportSystem::buildFromFiles);
+        return std::nullopt;
+    }
+
+    const TripLoadingOptions& getTripLoadingOptions() const { return tripLoading; }
+
+    // Режим загрузки применяется при следующей загрузке данных, лимит памяти - сразу
+    void setTripLoadingOptions(const TripLoadingOptions& options) {
+        tripLoading = options;
+        if (lazyTrips) {
+            lazyTrips->setMemoryLimit(options.memoryLimit);
+        }
+    }
+
+    // Переход к загрузке рейсов по требованию: строится только индекс строк файла
+    // (или берется готовый из кэша индексов)
+    void enableLazyTrips(const std::string& path, std::unique_ptr<LazyTripStore> cached = nullptr) {
+        auto store = std::move(cached);
+        if (store) {
+            store->setMemoryLimit(tripLoading.memoryLimit);
+        } else {
+            store = std::make_unique<LazyTripStore>(tripLoading.memoryLimit);
+            store->scan(path, true);
+        }
+        for (const auto& route : routes) {
+            store->indexRouteStops(route->getNumber(), route->getAllStops());
+        }
+        lazyTrips = std::move(store);
+    }
+
+    // После перезаписи файла рейсов смещения строк пересчитываются
+    void reindexLazyTrips(const std::string& path) {
+        if (lazyTrips) {
+            lazyTrips->scan(path, false);
+        }
+    }
+
+    const LazyTripStore* getLazyTrips() const { return lazyTrips.get(); }
+
+    // Загрузка рейсов без построения расписания по остановкам (оно есть в кэше индексов)
+    void deferStopTimetable() { stopTimetableDeferred = true; }
+
+    // Установка расписания по остановкам из кэша. Номер рейса в кэше - его позиция в списке
+    // рейсов, то есть порядок в файле. Если кэш не согласуется с рейсами, индекс строится заново
+    bool restoreStopTimetable(std::optional<StopTimetableIndex> cached) {
+        if (!stopTimetableDeferred) return false;
+        stopTimetableDeferred = false;
+        invalidateServiceDays();
+
+        std::size_t arrivals = 0;
+        for (const auto& trip : trips) {
+            trip->forEachArrival([&arrivals](const std::string&, const Time&) { ++arrivals; });
+        }
+        bool restored = cached && cached->getEventCount() == arrivals &&
+                        cached->remapTrips([this](EntityHandle position) {
+                            return position < trips.size() ? trips[position]->getHandle() : INVALID_HANDLE;
+                        });
+        if (restored) {
+            stopTimetable = std::move(*cached);
+            return true;
+        }
+
+        stopTimetable = StopTimetableIndex();
+        for (const auto& trip : trips) {
+            stopTimetable.addTrip(*trip);
+        }
+        return false;
+    }
+
+    void writeStopTimetable(BinaryWriter& out) const {
+        stopTimetable.write(out, [this](EntityHandle handle) {
+            return static_cast<EntityHandle>(tripPosition[handle]);
+        });
+    }
+
+    // Переходы по координатам из кэша вместо поиска соседей каждой остановки
+    void restoreDerivedFootpaths(FootpathGraph cached) {
+        if (footpathsFromFile) return;
+        footpaths = std::move(cached);
+        footpathsDirty = false;
+    }
+
+    // Рейсы маршрутов через остановку загружаются при первом обращении к ней
+    void loadTripsAtStop(const std::string& stopName) {
+        if (!lazyTrips) return;
+        if (const auto* stopRoutes = lazyTrips->routesAtStop(stopName)) {
+            for (int number : *stopRoutes) {
+                if (lazyTrips->isPending(number)) {
+                    loadRouteTrips(number);
+                } else {
+                    lazyTrips->touch(number);
+                }
+            }
+        }
+    }
+
+    // Для отчетов и проверок по всем рейсам
+    void loadAllTrips() {
+        if (!lazyTrips) return;
+        for (int number : lazyTrips->getPendingRoutes()) {
+            loadRouteTrips(number);
+        }
+    }
+
+    // Вытеснение давно не использованных маршрутов сверх лимита. Вызывается в начале запроса,
+    // чтобы не освобождать рейсы, на которые ссылается выполняющийся поиск. Во время приема
+    // событий реального времени рейсы не вытесняются: события сопоставляются с загруженными
+    void trimLoadedTrips() {
+        if (!lazyTrips || liveIngestor) return;
+        for (int number : lazyTrips->takeEvictions()) {
+            auto it = routeNumberToHandle.find(number);
+            if (it != routeNumberToHandle.end()) {
+                detachRouteTrips({it->second});
+            }
+        }
+    }
+
+    // Функция поиска маршрутов между двумя остановками
+    std::vector<std::shared_ptr<Route>> findRoutes(const std::string& stopA, const std::string& stopB) {
+        std::vector<std::shared_ptr<Route>> foundRoutes;
+        for (const auto& route : routes) {
+            if (route->containsStop(stopA) &&
+                route->containsStop(stopB) &&
+                route->isStopBefore(stopA, stopB)) {
+                foundRoutes.push_back(route);
+            }
+        }
+        return foundRoutes;
+    }
+
+    // Расписание остановки: рейсы и отправления по шаблонам в интервале [startTime, endTime]
+    StopTimetable getStopTimetable(int stopId, const Time& startTime, const Time& endTime,
+                                   std::optional<ServiceDate> date = std::nullopt) {
+        auto it = stopIdToName.find(stopId);
+        if (it == stopIdToName.end()) {
+            throw TransportException("Остановка с ID " + std::to_string(stopId) + " не найдена");
+        }
+        const std::string& stopName = it->second;
+        trimLoadedTrips();
+        loadTripsAtStop(stopName);
+
+        // Индекс уже упорядочен по времени прибытия
+        StopTimetable result{stopName, startTime, endTime, date, {}};
+        auto [first, last] = getStopTimetableIndex(date).range(stopName, startTime.getTotalMinutes(),
+                                                               endTime.getTotalMinutes());
+        result.rows.reserve(static_cast<std::size_t>(last - first));
+        for (const StopEvent* event = first; event != last; ++event) {
+            result.rows.push_back({tripHandles.get(event->trip)->getRoute()->getNumber(),
+                                   Time(0, event->minutes)});
+        }
+
+        // Отправления по шаблонам вычисляются на лету
+        if (const auto* templates = getTemplatesAtStop(stopName)) {
+            for (const TemplateStop& entry : *templates) {
+                const TripTemplate& pattern = *templateHandles.get(entry.pattern);
+                if (!isServiceActive(pattern.getCalendarId(), date)) continue;
+                pattern.forEachArrival(entry.stopPosition, startTime.getTotalMinutes(), endTime.getTotalMinutes(),
+                    [&](int, int minutes) {
+                        result.rows.push_back({pattern.getRoute()->getNumber(), Time(0, minutes)});
+                    });
+            }
+            std::stable_sort(result.rows.begin(), result.rows.end(), [](const auto& a, const auto& b) {
+                return a.arrival.getTotalMinutes() < b.arrival.getTotalMinutes();
+            });
+        }
+        return result;
+    }
+
+    // Расчет времени прибытия для рейса - ИСПРАВЛЕННАЯ ВЕРСИЯ.
+    // Возвращает новое расписание рейса по остановкам маршрута
+    std::vector<ScheduledStop> calculateArrivalTimes(int tripId, double averageSpeed) {
+        rejectEditDuringReload();
+        if (averageSpeed <= 0) {
+            throw TransportException("Средняя скорость должна быть положительной");
+        }
+
+        Trip* trip = &requireTrip(tripId);
+        const auto& stopsList = trip->getRoute()->getAllStops();
+
+        if (stopsList.empty()) {
+            throw TransportException("Маршрут не содержит остановок");
+        }
+
+        // Рейс пересчитывается целиком, поэтому его записи в индексах заменяются
+        stopTimetable.removeTrip(*trip);
+        forEachServiceDayOf(trip->getCalendarId(), [trip](StopTimetableIndex& index) { index.removeTrip(*trip); });
+        tripPatterns.removeTrip(*trip);
+
+        Time currentTime = trip->getStartTime();
+        std::vector<Time> arrivals{currentTime};
+
+        const double distanceBetweenStops = 1.5; // км
+        const int stopTime = 1; // минута
+
+        for (size_t i = 1; i < stopsList.size(); ++i) {
+            double travelTimeMinutes = (distanceBetweenStops / averageSpeed) * 60;
+            Time arrivalTime = currentTime + static_cast<int>(travelTimeMinutes + 0.5);
+            arrivals.push_back(arrivalTime);
+            currentTime = arrivalTime + stopTime;
+        }
+        trip->setArrivalTimes(arrivals);
+
+        stopTimetable.addTrip(*trip);
+        forEachServiceDayOf(trip->getCalendarId(), [trip](StopTimetableIndex& index) { index.addTrip(*trip); });
+        tripPatterns.addTrip(*trip);
+        refreshTripIntervals(*trip);
+
+        std::vector<ScheduledStop> schedule;
+        schedule.reserve(stopsList.size());
+        trip->forEachArrival([&schedule](const std::string& stop, const Time& time) {
+            schedule.push_back({stop, time});
+        });
+        return schedule;
+    }
+
+    // Задержка рейса на остановке: прибытие на ней и последующих остановках сдвигается.
+    // На каждой следующей стоянке поглощается до slackPerStop минут отклонения.
+    // Обновляются только затронутые записи индексов. Возвращает число измененных остановок
+    int reportDelay(int tripId, const std::string& stopName, int delayMinutes, int slackPerStop = 0) {
+        rejectEditDuringReload();
+        if (slackPerStop < 0) {
+            throw TransportException("Запас времени на стоянке не может быть отрицательным");
+        }
+
+        Trip& trip = requireTrip(tripId);
+        const auto& stopsList = trip.getRoute()->getAllStops();
+        int position = trip.getRoute()->getStopPosition(stopName);
+        if (position == -1 || !trip.hasStop(stopName)) {
+            throw TransportException("Остановка '" + stopName + "' не найдена в расписании рейса");
+        }
+
+        // Новые смещения собираются локально, профиль строится один раз. Смещения сдвигаются
+        // без приведения к суткам: опережение не может перенести прибытие раньше отправления
+        // рейса или прибытия на предыдущую обслуживаемую остановку, такие значения ограничиваются
+        std::vector<int> offsets = trip.getPattern()->getOffsets();
+        int previous = 0;
+        for (int i = position - 1; i >= 0; --i) {
+            if (offsets[i] != TripPattern::NO_STOP) {
+                previous = offsets[i];
+                break;
+            }
+        }
+        int remaining = delayMinutes;
+        int affected = 0;
+        tripPatterns.removeTrip(trip);
+        for (size_t i = position; i < stopsList.size() && remaining != 0; ++i) {
+            if (offsets[i] == TripPattern::NO_STOP) continue;
+
+            int oldOffset = offsets[i];
+            offsets[i] = std::max(oldOffset + remaining, previous);
+            previous = offsets[i];
+            if (offsets[i] != oldOffset) {
+                const std::string& stop = stopsList[i];
+                int oldMinutes = (trip.getStartTime() + oldOffset).getTotalMinutes();
+                int newMinutes = (trip.getStartTime() + offsets[i]).getTotalMinutes();
+                stopTimetable.moveEvent(stop, trip.getHandle(), oldMinutes, newMinutes);
+                forEachServiceDayOf(trip.getCalendarId(), [&](StopTimetableIndex& index) {
+                    index.moveEvent(stop, trip.getHandle(), oldMinutes, newMinutes);
+                });
+                ++affected;
+            }
+
+            // Сокращение стоянки перед следующим перегоном
+            int absorbed = std::min(std::abs(remaining), slackPerStop);
+            remaining += remaining > 0 ? -absorbed : absorbed;
+        }
+        trip.setArrivalOffsets(std::move(offsets));
+        tripPatterns.addTrip(trip);
+
+        refreshTripIntervals(trip);
+        return affected;
+    }
+
+    // АДМИНИСТРАТИВНЫЕ ФУНКЦИИ
+    void addRoute(std::shared_ptr<Route> route) {
+        rejectEditDuringReload();
+        // Проверка на уникальность номера маршрута
+        if (routeNumberToHandle.count(route->getNumber())) {
+            throw TransportException("Маршрут с номером " + std::to_string(route->getNumber()) + " уже существует");
+        }
+        EntityHandle handle = routeHandles.acquire(route);
+        routeNumberToHandle[route->getNumber()] = handle;
+        if (handle >= routePosition.size()) routePosition.resize(handle + 1);
+        routePosition[handle] = routes.size();
+        routes.push_back(std::move(route));
+    }
+
+    void addTrip(std::shared_ptr<Trip> trip) {
+        rejectEditDuringReload();
+        // При отложенной загрузке сначала читаются рейсы, с которыми возможен конфликт:
+        // того же маршрута, с тем же ID и на том же транспорте
+        int routeNumber = trip->getRoute()->getNumber();
+        if (lazyTrips) {
+            loadTripRoute(routeNumber);
+            loadTripForChange(trip->getTripId());
+            if (const auto* vehicleRoutes = lazyTrips->routesOfVehicle(trip->getVehicle()->getLicensePlate())) {
+                for (int number : *vehicleRoutes) loadTripRoute(number);
+            }
+        }
+
+        const Trip& added = *trip;
+        registerTrip(std::move(trip));
+        forEachServiceDayOf(added.getCalendarId(), [&added](StopTimetableIndex& index) { index.addTrip(added); });
+        if (lazyTrips) lazyTrips->pin(routeNumber);
+    }
+
+    void addTripTemplate(std::shared_ptr<TripTemplate> pattern) {
+        rejectEditDuringReload();
+        for (const auto& existing : tripTemplates) {
+            if (existing->getTemplateId() == pattern->getTemplateId()) {
+                throw TransportException("Шаблон рейсов с ID " + std::to_string(pattern->getTemplateId()) + " уже существует");
+            }
+        }
+        if (!routeHandles.contains(pattern->getRoute().get())) {
+            throw TransportException("Маршрут не зарегистрирован в системе!");
+        }
+        if (pattern->getCalendarId() != 0) {
+            requireCalendar(pattern->getCalendarId());
+        }
+        for (const auto& vehicle : pattern->getVehicles()) {
+            if (!vehicleHandles.contains(vehicle.get())) {
+                throw TransportException("Транспорт не зарегистрирован в системе!");
+            }
+        }
+        for (const auto& driver : pattern->getDrivers()) {
+            if (!driverHandles.contains(driver.get())) {
+                throw TransportException("Водитель не зарегистрирован в системе!");
+            }
+        }
+
+        if (nextRunIdBase + pattern->getDepartureCount() > std::numeric_limits<int>::max()) {
+            throw TransportException("Исчерпан диапазон номеров рейсов шаблонов");
+        }
+        pattern->setRunIdBase(static_cast<int>(nextRunIdBase));
+
+        // Рейсы, с которыми возможен конфликт по транспорту, читаются так же, как в addTrip
+        if (lazyTrips) {
+            for (const auto& vehicle : pattern->getVehicles()) {
+                if (const auto* vehicleRoutes = lazyTrips->routesOfVehicle(vehicle->getLicensePlate())) {
+                    for (int number : *vehicleRoutes) loadTripRoute(number);
+                }
+            }
+        }
+        auto runIntervals = checkTemplateRuns(*pattern);
+        nextRunIdBase += pattern->getDepartureCount();
+        for (auto& [vehicle, intervals] : runIntervals) {
+            vehicleIntervals[vehicle].insertAll(std::move(intervals));
+        }
+
+        EntityHandle handle = templateHandles.acquire(pattern);
+        const auto& stopsList = pattern->getRoute()->getAllStops();
+        for (std::size_t i = 0; i < stopsList.size(); ++i) {
+            templatesByStop[stopsList[i]].push_back({handle, static_cast<std::uint32_t>(i)});
+        }
+        tripTemplates.push_back(std::move(pattern));
+    }
+
+    void removeTripTemplate(int templateId) {
+        rejectEditDuringReload();
+        auto it = std::find_if(tripTemplates.begin(), tripTemplates.end(),
+                               [templateId](const auto& t) { return t->getTemplateId() == templateId; });
+        if (it == tripTemplates.end()) {
+            throw TransportException("Шаблон рейсов с ID " + std::to_string(templateId) + " не найден");
+        }
+
+        EntityHandle handle = (*it)->getHandle();
+        const TripTemplate& removed = **it;
+        for (const auto& vehicle : removed.getVehicles()) {
+            vehicleIntervals[vehicle->getHandle()].removeIf([&removed](const BusyInterval& interval) {
+                return removed.ownsRunId(interval.tripId);
+            });
+        }
+        for (const auto& stop : (*it)->getRoute()->getAllStops()) {
+            auto entries = templatesByStop.find(stop);
+            if (entries == templatesByStop.end()) continue;
+            auto& list = entries->second;
+            list.erase(std::remove_if(list.begin(), list.end(),
+                [handle](const TemplateStop& entry) { return entry.pattern == handle; }), list.end());
+            if (list.empty()) {
+                templatesByStop.erase(entries);
+            }
+        }
+        templateHandles.release(it->get());
+        tripTemplates.erase(it);
+    }
+
+    void addVehicle(std::shared_ptr<Vehicle> vehicle) {
+        rejectEditDuringReload();
+        if (!vehicle) {
+            throw TransportException("Неизвестный тип транспорта");
+        }
+
+        // Проверка на уникальность номерного знака
+        if (vehicleByPlate.count(vehicle->getLicensePlate())) {
+            throw TransportException("Транспортное средство с номером " + vehicle->getLicensePlate() + " уже существует");
+        }
+        vehicleByPlate[vehicle->getLicensePlate()] = vehicleHandles.acquire(vehicle);
+        vehicles.push_back(std::move(vehicle));
+    }
+
+    void addDriver(std::shared_ptr<Driver> driver) {
+        rejectEditDuringReload();
+        EntityHandle handle = driverHandles.acquire(driver);
+        std::string key = driverNameKey(driver->getFirstName(), driver->getLastName());
+        driverByName.emplace(key + "|" + driver->getMiddleName(), handle);
+        driverByName.emplace(std::move(key), handle);
+        drivers.push_back(std::move(driver));
+    }
+
+    void addStop(const Stop& stop) {
+        rejectEditDuringReload();
+        // Проверка на уникальность ID остановки
+        if (stopIdToName.count(stop.getId())) {
+            throw TransportException("Остановка с ID " + std::to_string(stop.getId()) + " уже существует");
+        }
+        stops.push_back(stop);
+        stopIdToName[stop.getId()] = stop.getName();
+        stopNames.add(stop.getId(), stop.getName());
+        if (stop.hasCoordinates()) {
+            stopLocationsDirty = true;
+            footpathsDirty = true;
+        }
+    }
+
+    // Ближайшие остановки к точке (k-d дерево перестраивается после изменения остановок)
+    std::vector<StopSpatialIndex::Neighbor> findNearestStops(double latitude, double longitude,
+                                                             std::size_t count) const {
+        return getStopLocations().kNearest(latitude, longitude, count);
+    }
+
+    std::vector<StopSpatialIndex::Neighbor> findStopsWithinRadius(double latitude, double longitude,
+                                                                  double radiusMeters) const {
+        return getStopLocations().withinRadius(latitude, longitude, radiusMeters);
+    }
+
+    const StopSpatialIndex& getStopLocations() const {
+        std::lock_guard<std::mutex> lock(derivedIndexMutex);
+        return stopLocationsLocked();
+    }
+
+    static constexpr double FOOTPATH_RADIUS = 400.0; // м
+    static constexpr double WALKING_SPEED = 80.0;    // м/мин, около 5 км/ч
+
+    // Точное совпадение названия (без исправления опечаток)
+    bool hasStopNamed(const std::string& name) const {
+        auto match = stopNames.resolve(name);
+        return match && match->name == name;
+    }
+
+    // Явно заданные переходы заменяют построенные по координатам. Переход двусторонний,
+    // из повторов одной пары остается самый короткий
+    void setFootpaths(const std::vector<FootpathGraph::Footpath>& list) {
+        rejectEditDuringReload();
+        std::map<std::pair<std::string, std::string>, int> pairs;
+        for (const auto& footpath : list) {
+            if (!hasStopNamed(footpath.from) || !hasStopNamed(footpath.to)) {
+                throw TransportException("Неизвестная остановка в пешем переходе: " +
+                                         footpath.from + " - " + footpath.to);
+            }
+            auto key = std::minmax(footpath.from, footpath.to);
+            auto [it, inserted] = pairs.try_emplace({key.first, key.second}, footpath.minutes);
+            if (!inserted) it->second = std::min(it->second, footpath.minutes);
+        }
+
+        std::vector<FootpathGraph::Footpath> symmetric;
+        symmetric.reserve(pairs.size() * 2);
+        for (const auto& [stopsPair, minutes] : pairs) {
+            symmetric.push_back({stopsPair.first, stopsPair.second, minutes});
+            symmetric.push_back({stopsPair.second, stopsPair.first, minutes});
+        }
+        footpaths.build(symmetric);
+        footpathsFromFile = true;
+        footpathsDirty = false;
+    }
+
+    bool hasExplicitFootpaths() const { return footpathsFromFile; }
+
+    const FootpathGraph& getFootpaths() const {
+        std::lock_guard<std::mutex> lock(derivedIndexMutex);
+        if (footpathsDirty && !footpathsFromFile) {
+            const auto& locations = stopLocationsLocked();
+            std::vector<FootpathGraph::Footpath> derived;
+            for (const auto& stop : stops) {
+                if (!stop.hasCoordinates()) continue;
+                for (const auto& neighbor : locations.withinRadius(stop.getLatitude(), stop.getLongitude(),
+                                                                   FOOTPATH_RADIUS)) {
+                    if (neighbor.stopId == stop.getId()) continue;
+                    int minutes = std::max(1, static_cast<int>(std::ceil(neighbor.distanceMeters / WALKING_SPEED)));
+                    derived.push_back({stop.getName(), stopIdToName.at(neighbor.stopId), minutes});
+                }
+            }
+            footpaths.build(derived);
+            footpathsDirty = false;
+        }
+        return footpaths;
+    }
+
+    // Удаление маршрута вместе с рейсами. Возвращает число удаленных рейсов
+    std::size_t removeRoute(int routeNumber) {
+        return removeRoutes({routeNumber});
+    }
+
+    // Каскадное удаление маршрутов вместе с их рейсами. Возвращает число удаленных рейсов
+    std::size_t removeRoutes(const std::vector<int>& routeNumbers) {
+        rejectEditDuringReload();
+        // Сначала проверка всех номеров, чтобы не удалить часть набора
+        std::vector<EntityHandle> routeList;
+        for (int number : routeNumbers) {
+            auto it = routeNumberToHandle.find(number);
+            if (it == routeNumberToHandle.end()) {
+                throw TransportException("Маршрут с номером " + std::to_string(number) + " не найден");
+            }
+            routeList.push_back(it->second);
+        }
+        std::sort(routeList.begin(), routeList.end());
+        routeList.erase(std::unique(routeList.begin(), routeList.end()), routeList.end());
+
+        // Незагруженные рейсы удаляемых маршрутов больше не читаются из файла
+        if (lazyTrips) {
+            for (int number : routeNumbers) lazyTrips->forgetRoute(number);
+        }
+        std::size_t removedTrips = detachRouteTrips(routeList);
+
+        // Шаблоны рейсов удаляемых маршрутов
+        for (std::size_t i = tripTemplates.size(); i-- > 0; ) {
+            if (std::binary_search(routeList.begin(), routeList.end(), tripTemplates[i]->getRoute()->getHandle())) {
+                removeTripTemplate(tripTemplates[i]->getTemplateId());
+            }
+        }
+
+        for (EntityHandle handle : routeList) {
+            Route* route = routeHandles.get(handle);
+            routeNumberToHandle.erase(route->getNumber());
+            swapAndPop(routes, routePosition, handle);
+            routeHandles.release(route);
+        }
+        return removedTrips;
+    }
+
+    void removeTrip(int tripId) {
+        rejectEditDuringReload();
+        detachTrip(tripId);
+    }
+
+    // Удаление рейсов без сообщений (при перечитывании файла рейсов) одним пакетным проходом.
+    // Сначала проверяются все ID, чтобы не удалить часть набора; возвращает число удаленных
+    std::size_t removeTrips(const std::vector<int>& tripIds) {
+        rejectEditDuringReload();
+        std::vector<std::shared_ptr<Trip>> removed;
+        HandleSet removedHandles;
+        for (int tripId : tripIds) {
+            loadTripForChange(tripId);
+            auto it = tripIdToHandle.find(tripId);
+            if (it == tripIdToHandle.end()) {
+                throw TransportException("Рейс с ID " + std::to_string(tripId) + " не найден");
+            }
+            if (removedHandles.contains(it->second)) continue;
+            removedHandles.insert(it->second);
+            removed.push_back(tripHandles.getShared(it->second));
+        }
+        detachTrips(removed, removedHandles);
+        return removed.size();
+    }
+
+    // Применение пакета изменений: все изменения проверяются вместе до первого из них
+    // (ID и номера - по хеш-множествам с учетом удалений в том же пакете, занятость
+    // транспорта - по новым рейсам, упорядоченным по времени). При ошибках выбрасывается
+    // исключение со списком всех найденных нарушений, система не меняется.
+    // Затем удаления выполняются одним пакетным проходом, а новые рейсы сливаются с индексами.
+    // Пакет очищается после применения
+    TimetableBatchResult commit(TimetableBatch& batch) {
+        rejectEditDuringReload();
+        // При отложенной загрузке читаются рейсы, с которыми возможен конфликт (как в addTrip)
+        if (lazyTrips) {
+            for (int tripId : batch.removedTrips) {
+                loadTripForChange(tripId);
+            }
+            for (const auto& trip : batch.addedTrips) {
+                loadTripRoute(trip->getRoute()->getNumber());
+                loadTripForChange(trip->getTripId());
+                if (const auto* vehicleRoutes = lazyTrips->routesOfVehicle(trip->getVehicle()->getLicensePlate())) {
+                    for (int number : *vehicleRoutes) loadTripRoute(number);
+                }
+            }
+        }
+
+        std::vector<std::string> problems;
+
+        // Удаляемые маршруты; ID их рейсов освобождаются
+        std::vector<int> routeNumbers;
+        HandleSet removedRoutes;
+        std::unordered_set<int> freedTripIds;
+        for (int number : batch.removedRoutes) {
+            auto it = routeNumberToHandle.find(number);
+            if (it == routeNumberToHandle.end()) {
+                problems.push_back("Маршрут с номером " + std::to_string(number) + " не найден");
+                continue;
+            }
+            if (removedRoutes.contains(it->second)) continue;
+            removedRoutes.insert(it->second);
+            routeNumbers.push_back(number);
+            auto tripsOfRoute = routeTrips.find(it->second);
+            if (tripsOfRoute == routeTrips.end()) continue;
+            for (EntityHandle handle : tripsOfRoute->second) {
+                freedTripIds.insert(tripHandles.get(handle)->getTripId());
+            }
+        }
+
+        // Удаляемые рейсы; рейсы удаляемых маршрутов снимаются вместе с маршрутом
+        std::vector<std::shared_ptr<Trip>> removed;
+        HandleSet removedHandles;
+        for (int tripId : batch.removedTrips) {
+            auto it = tripIdToHandle.find(tripId);
+            if (it == tripIdToHandle.end()) {
+                problems.push_back("Рейс с ID " + std::to_string(tripId) + " не найден");
+                continue;
+            }
+            if (!freedTripIds.insert(tripId).second) continue;
+            auto trip = tripHandles.getShared(it->second);
+            if (removedRoutes.contains(trip->getRoute()->getHandle())) continue;
+            removedHandles.insert(it->second);
+            removed.push_back(std::move(trip));
+        }
+
+        // Новые маршруты: номер свободен или освобождается в этом пакете
+        std::unordered_set<int> newRouteNumbers;
+        std::unordered_set<const Route*> newRoutes;
+        for (const auto& route : batch.addedRoutes) {
+            int number = route->getNumber();
+            auto existing = routeNumberToHandle.find(number);
+            if (routeHandles.contains(route.get()) || !newRouteNumbers.insert(number).second ||
+                (existing != routeNumberToHandle.end() && !removedRoutes.contains(existing->second))) {
+                problems.push_back("Маршрут с номером " + std::to_string(number) + " уже существует");
+                continue;
+            }
+            newRoutes.insert(route.get());
+        }
+
+        // Новые рейсы: ID, маршрут, календарь, водитель и транспорт
+        std::unordered_set<int> newTripIds;
+        std::unordered_map<EntityHandle, std::vector<BusyInterval>> newIntervals;
+        for (const auto& trip : batch.addedTrips) {
+            std::string prefix = "Рейс " + std::to_string(trip->getTripId()) + ": ";
+            if (trip->getTripId() <= 0) {
+                problems.push_back(prefix + "ID рейса должен быть положительным");
+                continue;
+            }
+            auto existing = tripIdToHandle.find(trip->getTripId());
+            if (tripHandles.contains(trip.get()) || !newTripIds.insert(trip->getTripId()).second ||
+                (existing != tripIdToHandle.end() && !freedTripIds.count(trip->getTripId()))) {
+                problems.push_back("Рейс с ID " + std::to_string(trip->getTripId()) + " уже существует");
+                continue;
+            }
+            const Route* route = trip->getRoute().get();
+            if (!newRoutes.count(route) &&
+                (!routeHandles.contains(route) || removedRoutes.contains(route->getHandle()))) {
+                problems.push_back(prefix + "маршрут не зарегистрирован в системе");
+            }
+            if (trip->getCalendarId() != 0 && !calendars.count(trip->getCalendarId())) {
+                problems.push_back(prefix + "календарь с ID " + std::to_string(trip->getCalendarId()) + " не найден");
+            }
+            if (!driverHandles.contains(trip->getDriver().get())) {
+                problems.push_back(prefix + "водитель не зарегистрирован в системе");
+            }
+            if (!vehicleHandles.contains(trip->getVehicle().get())) {
+                problems.push_back(prefix + "транспорт не зарегистрирован в системе");
+                continue;
+            }
+            newIntervals[trip->getVehicle()->getHandle()].push_back(makeInterval(*trip));
+        }
+
+        // Занятость транспорта: новые рейсы проверяются по времени друг с другом
+        // и с оставшимися рейсами
+        for (auto& [vehicle, intervals] : newIntervals) {
+            const std::string& plate = vehicleHandles.get(vehicle)->getLicensePlate();
+            std::sort(intervals.begin(), intervals.end(),
+                      [](const BusyInterval& a, const BusyInterval& b) { return a.start < b.start; });
+            auto busy = vehicleIntervals.find(vehicle);
+            std::vector<const BusyInterval*> active;
+            for (const BusyInterval& interval : intervals) {
+                std::erase_if(active, [&interval](const BusyInterval* other) { return other->end < interval.start; });
+                for (const BusyInterval* other : active) {
+                    if (!calendarsShareDay(other->calendarId, interval.calendarId)) continue;
+                    problems.push_back("Транспорт " + plate + " занят рейсами " + std::to_string(other->tripId) +
+                                       " и " + std::to_string(interval.tripId) + " пакета в одно время");
+                }
+                active.push_back(&interval);
+                if (busy == vehicleIntervals.end()) continue;
+                auto otherDays = ignoreOtherDays(interval.calendarId);
+                const BusyInterval* conflict = busy->second.findOverlapExcept(interval.start, interval.end,
+                    [&freedTripIds, &otherDays](const BusyInterval& other) {
+                        return freedTripIds.count(other.tripId) > 0 || otherDays(other);
+                    });
+                if (conflict) {
+                    problems.push_back("Рейс " + std::to_string(interval.tripId) + ": транспорт " + plate +
+                                       " уже занят рейсом " + std::to_string(conflict->tripId) + " в это время");
+                }
+            }
+        }
+
+        if (!problems.empty()) {
+            const std::size_t SHOWN = 20;
+            std::string message = "Пакет изменений отклонен, ошибок: " + std::to_string(problems.size());
+            for (std::size_t i = 0; i < problems.size() && i < SHOWN; ++i) {
+                message += "\n  " + problems[i];
+            }
+            if (problems.size() > SHOWN) {
+                message += "\n  ... и еще " + std::to_string(problems.size() - SHOWN);
+            }
+            throw TransportException(message);
+        }
+
+        TimetableBatchResult result;
+        detachTrips(removed, removedHandles);
+        result.tripsRemoved = removed.size();
+        if (!routeNumbers.empty()) {
+            result.tripsRemoved += removeRoutes(routeNumbers);
+            result.routesRemoved = routeNumbers.size();
+        }
+
+        for (const auto& route : batch.addedRoutes) {
+            addRoute(route);
+        }
+        attachTrips(batch.addedTrips);
+        for (auto& [activeCalendars, index] : serviceDayIndexes) {
+            std::vector<std::shared_ptr<Trip>> active;
+            for (const auto& trip : batch.addedTrips) {
+                if (isActiveInServiceDay(activeCalendars, trip->getCalendarId())) active.push_back(trip);
+            }
+            index.addTrips(active);
+        }
+        if (lazyTrips) {
+            for (const auto& trip : batch.addedTrips) lazyTrips->pin(trip->getRoute()->getNumber());
+        }
+        result.routesAdded = batch.addedRoutes.size();
+        result.tripsAdded = batch.addedTrips.size();
+        batch.clear();
+        return result;
+    }
+
+    // Получение всех рейсов
+    const std::vector<std::shared_ptr<Trip>>& getTrips() const { return trips; }
+    const std::vector<std::shared_ptr<Route>>& getRoutes() const { return routes; }
+    const std::vector<std::shared_ptr<Vehicle>>& getVehicles() const { return vehicles; }
+    const std::vector<Stop>& getStops() const { return stops; }
+    const std::vector<std::shared_ptr<Driver>>& getDrivers() const { return drivers; }
+
+    const CountedHashMap<int, std::string, MemoryComponent::StopIds>& getStopIdToName() const { return stopIdToName; }
+
+    // Доступ к сущностям по дескриптору (без счетчиков ссылок)
+    Route* getRouteByHandle(EntityHandle handle) const { return routeHandles.get(handle); }
+    Trip* getTripByHandle(EntityHandle handle) const { return tripHandles.get(handle); }
+    Vehicle* getVehicleByHandle(EntityHandle handle) const { return vehicleHandles.get(handle); }
+    Driver* getDriverByHandle(EntityHandle handle) const { return driverHandles.get(handle); }
+
+    // Рейсы маршрута (nullptr, если их нет)
+    const std::vector<EntityHandle>* getRouteTrips(EntityHandle route) const {
+        auto it = routeTrips.find(route);
+        return it != routeTrips.end() ? &it->second : nullptr;
+    }
+
+    // Применение результата автоматического распределения водителей
+    void applyRoster(const RosterResult& roster) {
+        rejectEditDuringReload();
+        std::vector<EntityHandle> newDriver(tripHandles.getSlotCount(), INVALID_HANDLE);
+        for (const auto& assignment : roster.assignments) {
+            if (assignment.trip < newDriver.size()) {
+                newDriver[assignment.trip] = assignment.driver;
+            }
+        }
+
+        std::vector<const std::shared_ptr<Driver>*> driverByHandle(driverHandles.getSlotCount(), nullptr);
+        for (const auto& driver : drivers) {
+            driverByHandle[driver->getHandle()] = &driver;
+        }
+
+        for (const auto& trip : trips) {
+            EntityHandle handle = newDriver[trip->getHandle()];
+            if (handle == INVALID_HANDLE || handle == trip->getDriver()->getHandle()) continue;
+
+            if (handle >= driverByHandle.size() || !driverByHandle[handle]) {
+                throw TransportException("Водитель из распределения не зарегистрирован в системе!");
+            }
+            const auto& driver = *driverByHandle[handle];
+
+            driverSchedule.removeTripFromDriver(trip->getDriver(), trip->getTripId());
+            trip->setDriver(driver);
+            driverSchedule.assignTripToDriver(driver, trip);
+            if (lazyTrips) lazyTrips->pin(trip->getRoute()->getNumber());
+        }
+    }
+
+    const StopTimetableIndex& getStopTimetableIndex() const { return stopTimetable; }
+    const TripPatternIndex& getTripPatterns() const { return tripPatterns; }
+
+    // Индекс расписаний на дату: только рейсы, действующие в этот день.
+    // Строится при первом запросе для данного набора действующих календарей
+    const StopTimetableIndex& getStopTimetableIndex(std::optional<ServiceDate> date) const {
+        if (!date || calendars.empty()) {
+            return stopTimetable;
+        }
+
+        std::vector<bool> activeCalendars;
+        activeCalendars.reserve(calendars.size());
+        for (const auto& [id, calendar] : calendars) {
+            activeCalendars.push_back(calendar.isActive(*date));
+        }
+
+        auto it = serviceDayIndexes.find(activeCalendars);
+        if (it == serviceDayIndexes.end()) {
+            it = serviceDayIndexes.emplace(activeCalendars, stopTimetable.filtered([&](EntityHandle handle) {
+                return isServiceActive(tripHandles.get(handle)->getCalendarId(), date);
+            })).first;
+        }
+        return it->second;
+    }
+
+    // Действует ли календарь в указанный день (без даты и для календаря 0 - всегда)
+    bool isServiceActive(int calendarId, std::optional<ServiceDate> date) const {
+        if (!date || calendarId == 0) return true;
+        auto it = calendars.find(calendarId);
+        return it != calendars.end() && it->second.isActive(*date);
+    }
+
+    // Есть ли день, в который действуют оба календаря (календарь 0 действует каждый день)
+    bool calendarsShareDay(int first, int second) const {
+        if (first == 0 || second == 0 || first == second) return true;
+        auto a = calendars.find(first);
+        auto b = calendars.find(second);
+        return a != calendars.end() && b != calendars.end() && a->second.sharesDayWith(b->second);
+    }
+
+    void addServiceCalendar(const ServiceCalendar& calendar) {
+        rejectEditDuringReload();
+        if (calendars.count(calendar.getCalendarId())) {
+            throw TransportException("Календарь с ID " + std::to_string(calendar.getCalendarId()) + " уже существует");
+        }
+        calendars.emplace(calendar.getCalendarId(), calendar);
+        invalidateServiceDays();
+    }
+
+    // Новый день обслуживания не должен занять транспорт, уже работающий в этот день
+    // в то же время по другому календарю
+    void addCalendarException(int calendarId, ServiceDate date, bool active) {
+        rejectEditDuringReload();
+        ServiceCalendar& calendar = requireCalendar(calendarId);
+        if (active && !calendar.isActive(date)) {
+            for (const auto& [vehicle, busy] : vehicleIntervals) {
+                for (const auto& [first, second] : busy.findAllOverlaps()) {
+                    const BusyInterval* other = first->calendarId == calendarId ? second
+                                              : second->calendarId == calendarId ? first : nullptr;
+                    if (other && other->calendarId != calendarId && isServiceActive(other->calendarId, date)) {
+                        throw TransportException("Транспорт " + vehicleHandles.get(vehicle)->getLicensePlate() +
+                                                 " в этот день уже занят рейсом " + std::to_string(other->tripId) +
+                                                 " в то же время, что и рейс " +
+                                                 std::to_string(first == other ? second->tripId : first->tripId));
+                    }
+                }
+            }
+        }
+        calendar.addException(date, active);
+        invalidateServiceDays();
+    }
+
+    void setTripCalendar(int tripId, int calendarId) {
+        rejectEditDuringReload();
+        if (calendarId != 0) {
+            requireCalendar(calendarId);
+        }
+        Trip& trip = requireTrip(tripId);
+        BusyInterval interval = makeInterval(trip);
+        auto otherDays = ignoreOtherDays(calendarId);
+        const BusyInterval* conflict = vehicleIntervals[trip.getVehicle()->getHandle()].findOverlapExcept(
+            interval.start, interval.end,
+            [tripId, &otherDays](const BusyInterval& other) { return other.tripId == tripId || otherDays(other); });
+        if (conflict) {
+            throw TransportException("Транспорт " + trip.getVehicle()->getLicensePlate() + " уже занят рейсом " +
+                                     std::to_string(conflict->tripId) + " в это время");
+        }
+
+        // Рейс переносится только между индексами дней, где действует лишь один из календарей
+        for (auto& [activeCalendars, index] : serviceDayIndexes) {
+            bool wasActive = isActiveInServiceDay(activeCalendars, trip.getCalendarId());
+            bool nowActive = isActiveInServiceDay(activeCalendars, calendarId);
+            if (wasActive && !nowActive) index.removeTrip(trip);
+            if (!wasActive && nowActive) index.addTrip(trip);
+        }
+        trip.setCalendarId(calendarId);
+        refreshTripIntervals(trip);
+    }
+
+    const CountedMap<int, ServiceCalendar, MemoryComponent::Calendars>& getCalendars() const { return calendars; }
+
+    // Узлы календарей и кэша индексов по дням учитывает аллокатор; сами индексы дней
+    // относятся к индексу расписаний остановок
+    std::size_t getCalendarMemory() const {
+        std::size_t bytes = 0;
+        for (const auto& [id, calendar] : calendars) {
+            bytes += calendar.getMemoryBytes();
+        }
+        for (const auto& [key, index] : serviceDayIndexes) {
+            bytes += key.capacity() / 8; // vector<bool> хранит бит на календарь
+        }
+        return bytes;
+    }
+
+    // Общий индекс расписаний и его копии для отдельных дней обслуживания
+    std::size_t getStopTimetableMemory() const {
+        std::size_t bytes = stopTimetable.getMemoryBytes();
+        for (const auto& [key, index] : serviceDayIndexes) {
+            bytes += index.getMemoryBytes();
+        }
+        return bytes;
+    }
+
+    const StopNameIndex& getStopNameIndex() const { return stopNames; }
+
+    // Название остановки по вводу пользователя (регистр и небольшие опечатки не важны)
+    std::string resolveStopName(const std::string& input) const {
+        return resolveStop(input).name;
+    }
+
+    StopNameIndex::Match resolveStop(const std::string& input) const {
+        if (auto match = stopNames.resolve(input)) {
+            return *match;
+        }
+
+        auto suggestions = stopNames.complete(input, 5);
+        if (suggestions.empty()) {
+            suggestions = stopNames.findSimilar(input, 5);
+        }
+        std::string message = "Остановка '" + input + "' не найдена";
+        for (std::size_t i = 0; i < suggestions.size(); ++i) {
+            message += (i == 0 ? ". Возможно: " : ", ") + suggestions[i].name;
+        }
+        throw TransportException(message);
+    }
+
+    const std::vector<std::shared_ptr<TripTemplate>>& getTripTemplates() const { return tripTemplates; }
+    const TripTemplate* getTemplateByHandle(EntityHandle handle) const { return templateHandles.get(handle); }
+
+    // Шаблоны, проходящие через остановку (nullptr, если таких нет)
+    const std::vector<TemplateStop>* getTemplatesAtStop(const std::string& stopName) const {
+        auto it = templatesByStop.find(stopName);
+        return it != templatesByStop.end() ? &it->second : nullptr;
+    }
+
+    std::size_t getTemplateMemory() const {
+        std::size_t bytes = templateHandles.getMemoryBytes() +
+                            tripTemplates.capacity() * sizeof(std::shared_ptr<TripTemplate>);
+        for (const auto& pattern : tripTemplates) {
+            bytes += pattern->getMemoryBytes();
+        }
+        for (const auto& [stop, list] : templatesByStop) {
+            bytes += ComponentMemory::stringBytes(stop) + list.capacity() * sizeof(TemplateStop);
+        }
+        return bytes;
+    }
+
+    // Запуск приема событий из файла или канала
+    void startLiveIngestion(const std::string& path, unsigned consumerThreads = 2) {
+        stopLiveIngestion();
+        loadAllTrips();
+        liveIngestor = std::make_unique<LiveEventIngestor>(
+            std::unordered_map<std::string, EntityHandle>(vehicleByPlate.begin(), vehicleByPlate.end()), consumerThreads);
+        liveIngestor->start(path);
+    }
+
+    void stopLiveIngestion() {
+        if (liveIngestor) {
+            applyLiveUpdates();
+            liveIngestor.reset();
+        }
+    }
+
+    const LiveEventIngestor* getLiveIngestor() const { return liveIngestor.get(); }
+
+    // Применение накопленных событий пачкой. Вызывается потоком запросов;
+    // если очередь в этот момент занята, применение откладывается до следующего вызова
+    std::size_t applyLiveUpdates() {
+        if (!liveIngestor) return 0;
+        auto updates = liveIngestor->takePending();
+        if (updates.empty()) return 0;
+
+        // Из пачки для каждого транспорта важно только последнее событие
+        std::sort(updates.begin(), updates.end(), [](const LiveUpdate& a, const LiveUpdate& b) {
+            return a.vehicle != b.vehicle ? a.vehicle < b.vehicle : a.timestamp < b.timestamp;
+        });
+
+        std::size_t appliedCount = 0, unresolvedCount = 0;
+        std::int64_t newest = 0;
+        for (std::size_t i = 0; i < updates.size(); ++i) {
+            const LiveUpdate& update = updates[i];
+            newest = std::max(newest, update.timestamp);
+            if (i + 1 < updates.size() && updates[i + 1].vehicle == update.vehicle) continue;
+
+            // Рейс, который транспорт выполняет в момент события
+            // localtime использует общий статический буфер, а события читают другие потоки
+            std::time_t timestamp = static_cast<std::time_t>(update.timestamp);
+            std::tm local{};
+#ifdef _WIN32
+            bool converted = localtime_s(&local, &timestamp) == 0;
+#else
+            bool converted = localtime_r(&timestamp, &local) != nullptr;
+#endif
+            int minute = converted ? local.tm_hour * 60 + local.tm_min : 0;
+            std::optional<ServiceDate> date;
+            if (converted) {
+                date = ServiceDate(std::chrono::year_month_day{std::chrono::year(local.tm_year + 1900),
+                                                               std::chrono::month(local.tm_mon + 1),
+                                                               std::chrono::day(local.tm_mday)});
+            }
+            // Транспорт может выполнять в одно время суток рейсы разных календарей:
+            // берется рейс, действующий в день события
+            auto busyIt = vehicleIntervals.find(update.vehicle);
+            const BusyInterval* active = busyIt == vehicleIntervals.end() ? nullptr
+                : busyIt->second.findOverlapExcept(minute, minute, [this, &date](const BusyInterval& interval) {
+                      return !isServiceActive(interval.calendarId, date);
+                  });
+            auto stopIt = stopIdToName.find(update.stopId);
+            if (!active || stopIt == stopIdToName.end()) {
+                ++unresolvedCount;
+                continue;
+            }
+
+            try {
+                EntityHandle tripHandle = tripIdToHandle.at(active->tripId);
+                int& current = liveDelays[tripHandle];
+                if (update.delayMinutes != current) {
+                    reportDelay(active->tripId, stopIt->second, update.delayMinutes - current);
+                    current = update.delayMinutes;
+                }
+                ++appliedCount;
+            } catch (const std::exception&) {
+                ++unresolvedCount; // остановка не входит в рейс
+            }
+        }
+
+        std::int64_t lag = static_cast<std::int64_t>(std::time(nullptr)) - newest;
+        liveIngestor->recordApplied(appliedCount, unresolvedCount, lag);
+        return appliedCount;
+    }
+
+    std::shared_ptr<Trip> getTripSharedByHandle(EntityHandle handle) const {
+        return tripHandles.getShared(handle);
+    }
+
+    std::size_t getRouteIndexMemory() const {
+        std::size_t bytes = (routePosition.capacity() + tripPosition.capacity()) * sizeof(std::size_t);
+        for (const auto& [route, list] : routeTrips) {
+            bytes += list.capacity() * sizeof(EntityHandle);
+        }
+        return bytes;
+    }
+
+    std::size_t getVehiclePlateIndexMemory() const {
+        std::size_t bytes = 0;
+        for (const auto& [plate, handle] : vehicleByPlate) {
+            bytes += ComponentMemory::stringBytes(plate);
+        }
+        return bytes;
+    }
+
+    std::size_t getDriverNameIndexMemory() const {
+        std::size_t bytes = 0;
+        for (const auto& [name, handle] : driverByName) {
+            bytes += ComponentMemory::stringBytes(name);
+        }
+        return bytes;
+    }
+
+    // Аудит всего расписания на двойное назначение транспорта
+    std::vector<VehicleConflict> findVehicleConflicts() const {
+        return VehicleConflictDetector::findConflicts(trips, [this](int first, int second) {
+            return calendarsShareDay(first, second);
+        });
+    }
+
+    std::size_t getVehicleIntervalsMemory() const {
+        std::size_t bytes = 0;
+        for (const auto& [handle, busy] : vehicleIntervals) {
+            bytes += busy.getMemoryBytes();
+        }
+        return bytes;
+    }
+
+    std::size_t getHandleTablesMemory() const {
+        return routeHandles.getMemoryBytes() + tripHandles.getMemoryBytes() +
+               vehicleHandles.getMemoryBytes() + driverHandles.getMemoryBytes();
+    }
+
+    // Получение компонентов
+    JourneyPlanner& getJourneyPlanner() { return journeyPlanner; }
+    const JourneyPlanner& getJourneyPlanner() const { return journeyPlanner; }
+    DriverSchedule& getDriverSchedule() { return driverSchedule; }
+    const DriverSchedule& getDriverSchedule() const { return driverSchedule; }
+
+    // Поиск водителя по ФИО
+    std::shared_ptr<Driver> findDriverByName(const std::string& firstName,
+                                            const std::string& lastName,
+                                            const std::string& middleName = "") const {
+        // Без отчества подходит первый водитель с такими именем и фамилией
+        std::string key = driverNameKey(firstName, lastName);
+        if (!middleName.empty()) key += "|" + middleName;
+        auto it = driverByName.find(key);
+        return it != driverByName.end() ? driverHandles.getShared(it->second) : nullptr;
+    }
+
+    // Поиск транспорта по номеру
+    std::shared_ptr<Vehicle> findVehicleByLicensePlate(const std::string& licensePlate) const {
+        auto it = vehicleByPlate.find(licensePlate);
+        return it != vehicleByPlate.end() ? vehicleHandles.getShared(it->second) : nullptr;
+    }
+
+    // Поиск маршрута по номеру
+    std::shared_ptr<Route> findRouteByNumber(int number) const {
+        auto it = routeNumberToHandle.find(number);
+        return it != routeNumberToHandle.end() ? routeHandles.getShared(it->second) : nullptr;
+    }
+
+    // Получение всех рейсов через остановку
+    std::vector<std::shared_ptr<Trip>> getTripsThroughStop(const std::string& stopName) const {
+        std::vector<std::shared_ptr<Trip>> result;
+        for (const auto& trip : trips) {
+            if (trip->hasStop(stopName)) {
+                result.push_back(trip);
+            }
+        }
+        return result;
+    }
+
+    // Получение остановки по ID
+    std::string getStopNameById(int id) const {
+        auto it = stopIdToName.find(id);
+        if (it != stopIdToName.end()) {
+            return it->second;
+        }
+        return "";
+    }
+
+    // Для использования в Trip::deserialize
+    friend class Trip;
+};
+
+// Строка отчета о памяти: компонент, количество объектов, байты
+struct MemoryUsage {
+    std::string component;
+    std::size_t objects;
+    std::size_t bytes;
+};
+
+// Отчет о памяти структур данных. Узлы контейнеров и сущности в пулах измеряются счетчиками
+// компонентов (ComponentMemory), буферы векторов и строк - по их емкости.
+// Счетчики общие для процесса: во время фоновой перезагрузки в них входит и новая копия данных
+class MemoryProfiler {
+private:
+    template<typename T>
+    static std::size_t vectorBytes(const std::vector<T>& v) {
+        return v.capacity() * sizeof(T);
+    }
+
+    static std::size_t measured(MemoryComponent component) {
+        return ComponentMemory::getLiveBytes(component);
+    }
+
+    static std::size_t stringBytes(const std::string& s) {
+        return ComponentMemory::stringBytes(s);
+    }
+
+    // Выравнивание по числу символов UTF-8, а не байтов (setw считает байты)
+    static std::string padRight(const std::string& text, std::size_t width) {
+        std::size_t length = 0;
+        for (unsigned char c : text) {
+            if ((c & 0xC0) != 0x80) ++length;
+        }
+        return length < width ? text + std::string(width - length, ' ') : text;
+    }
+
+public:
+    static std::vector<MemoryUsage> collect(const TransportSystem& system) {
+        std::vector<MemoryUsage> report;
+
+        const auto& routes = system.getRoutes();
+        MemoryUsage routeUsage{"Маршруты", routes.size(), vectorBytes(routes) + measured(MemoryComponent::Routes)};
+        for (const auto& route : routes) {
+            routeUsage.bytes += stringBytes(route->getVehicleType()) +
+                                stringBytes(route->getStartStop()) +
+                                stringBytes(route->getEndStop()) +
+                                vectorBytes(route->getAllStops());
+            for (const auto& stop : route->getAllStops()) {
+                routeUsage.bytes += stringBytes(stop);
+            }
+        }
+        report.push_back(routeUsage);
+
+        const auto& trips = system.getTrips();
+        report.push_back({"Рейсы", trips.size(), vectorBytes(trips) + measured(MemoryComponent::Trips)});
+
+        // Расписания рейсов: общие профили хода и упорядоченные отправления
+        const auto& tripPatterns = system.getTripPatterns();
+        report.push_back({"Профили хода рейсов", tripPatterns.size(),
+                          tripPatterns.getMemoryBytes() + measured(MemoryComponent::TripPatterns)});
+
+        // Индекс строк файла рейсов при загрузке по требованию
+        if (const LazyTripStore* lazyTrips = system.getLazyTrips()) {
+            report.push_back({"Индекс загрузки рейсов", lazyTrips->getRouteCount(),
+                              lazyTrips->getMemoryBytes() + measured(MemoryComponent::LazyTrips)});
+        }
+
+        const auto& vehicles = system.getVehicles();
+        MemoryUsage vehicleUsage{"Транспорт", vehicles.size(),
+                                 vectorBytes(vehicles) + measured(MemoryComponent::Vehicles)};
+        for (const auto& vehicle : vehicles) {
+            vehicleUsage.bytes += stringBytes(vehicle->getType()) +
+                                  stringBytes(vehicle->getModel()) +
+                                  stringBytes(vehicle->getLicensePlate());
+        }
+        report.push_back(vehicleUsage);
+
+        const auto& drivers = system.getDrivers();
+        MemoryUsage driverUsage{"Водители", drivers.size(),
+                                vectorBytes(drivers) + measured(MemoryComponent::Drivers)};
+        for (const auto& driver : drivers) {
+            driverUsage.bytes += stringBytes(driver->getFirstName()) +
+                                 stringBytes(driver->getLastName()) +
+                                 stringBytes(driver->getMiddleName());
+        }
+        report.push_back(driverUsage);
+
+        const auto& stops = system.getStops();
+        MemoryUsage stopUsage{"Остановки", stops.size(), vectorBytes(stops)};
+        for (const auto& stop : stops) {
+            stopUsage.bytes += stringBytes(stop.getName());
+        }
+        report.push_back(stopUsage);
+
+        const auto& stopIdToName = system.getStopIdToName();
+        MemoryUsage stopIndexUsage{"stopIdToName", stopIdToName.size(), measured(MemoryComponent::StopIds)};
+        for (const auto& [id, name] : stopIdToName) {
+            stopIndexUsage.bytes += stringBytes(name);
+        }
+        report.push_back(stopIndexUsage);
+
+        const auto& driverSchedule = system.getDriverSchedule();
+        report.push_back({"DriverSchedule::driverTrips", driverSchedule.getDriverCount(),
+                          driverSchedule.getMemoryBytes() + measured(MemoryComponent::DriverSchedule)});
+
+        report.push_back({"Таблицы дескрипторов", 4, system.getHandleTablesMemory()});
+        report.push_back({"Интервалы занятости транспорта", system.getVehicles().size(),
+                          system.getVehicleIntervalsMemory() + measured(MemoryComponent::VehicleIntervals)});
+        report.push_back({"Индексы расписаний остановок", system.getStopTimetableIndex().getStopCount(),
+                          system.getStopTimetableMemory() + measured(MemoryComponent::StopTimetable)});
+        report.push_back({"Индекс ID рейсов", system.getTrips().size(), measured(MemoryComponent::TripIds)});
+        report.push_back({"Индекс названий остановок", system.getStopNameIndex().size(),
+                          system.getStopNameIndex().getMemoryBytes() + measured(MemoryComponent::StopNames)});
+        report.push_back({"Пространственный индекс остановок", system.getStopLocations().size(),
+                          system.getStopLocations().getMemoryBytes()});
+        report.push_back({"Граф пеших переходов", system.getFootpaths().size(),
+                          system.getFootpaths().getMemoryBytes() + measured(MemoryComponent::Footpaths)});
+        report.push_back({"Календари и кэш индексов дней", system.getCalendars().size(),
+                          system.getCalendarMemory() + measured(MemoryComponent::Calendars)});
+        report.push_back({"Шаблоны интервального движения", system.getTripTemplates().size(),
+                          system.getTemplateMemory() + measured(MemoryComponent::Templates)});
+        report.push_back({"Индекс маршрутов и позиций", system.getRoutes().size(),
+                          system.getRouteIndexMemory() + measured(MemoryComponent::RouteIndex)});
+        report.push_back({"Индекс номерных знаков", system.getVehicles().size(),
+                          system.getVehiclePlateIndexMemory() + measured(MemoryComponent::VehiclePlates)});
+        report.push_back({"Индекс имен водителей", system.getDrivers().size(),
+                          system.getDriverNameIndexMemory() + measured(MemoryComponent::DriverNames)});
+
+        // Резерв слябов: выделено у аллокатора, но пока не занято сущностями
+        MemoryUsage poolReserve{"Резерв пулов сущностей", 0, 0};
+        for (const SlabPoolBase* pool : SlabPoolBase::getAllPools()) {
+            poolReserve.objects++;
+            poolReserve.bytes += pool->getReservedBytes() - pool->getLiveBytes();
+        }
+        report.push_back(poolReserve);
+
+        return report;
+    }
+
+    static void printReport(const TransportSystem& system, std::ostream& os) {
+        auto report = collect(system);
+        std::size_t accounted = 0;
+
+        os << "\n=== ИСПОЛЬЗОВАНИЕ ПАМЯТИ ===\n";
+        os << padRight("Компонент", 30) << padRight("Объектов", 12) << "Байт\n";
+        for (const auto& usage : report) {
+            os << padRight(usage.component, 30) << std::left << std::setw(12) << usage.objects
+               << usage.bytes << '\n';
+            accounted += usage.bytes;
+        }
+
+        os << "Итого по структурам: " << accounted << " байт\n";
+        if (AllocationTracker::isInstalled()) {
+            std::size_t live = AllocationTracker::getLiveBytes();
+            os << "Куча процесса (аллокатор): " << live << " байт в "
+               << AllocationTracker::getLiveBlocks() << " блоках, пик "
+               << AllocationTracker::getPeakBytes() << " байт\n";
+            os << "Прочее (буферы ввода-вывода, служебные данные): "
+               << (live > accounted ? live - accounted : 0) << " байт\n";
+        } else {
+            os << "Куча процесса: учет выделений не подключен (AllocationTracking.cpp)\n";
+        }
+
+        const auto& planner = system.getJourneyPlanner().getLastQueryStats();
+        os << "Последний запрос планировщика: " << planner.expandedNodes << " узлов, "
+           << planner.allocations << " выделений, " << planner.allocatedBytes << " байт\n";
+    }
+};
+
+// Итоги импорта ленты GTFS
+struct GtfsImportStats {
+    std::size_t stops = 0;
+    std::size_t routes = 0;     // маршруты системы: по одному на каждую трассу маршрута GTFS
+    std::size_t trips = 0;
+    std::size_t stopTimes = 0;
+    std::size_t calendars = 0;
+    std::size_t skipped = 0;    // записи и рейсы, пропущенные из-за ошибок
+    std::vector<std::string> errors; // сообщения о первых ошибках (не больше десяти)
+};
+
+// Импорт ленты GTFS (stops, routes, trips, stop_times, calendar, calendar_dates) из каталога.
+// stop_times.txt читается потоком в два прохода: первый считает записи каждого рейса, второй
+// собирает рейс и импортирует его, как только получены все его записи. GTFS не требует, чтобы
+// записи рейса шли подряд, но обычно это так, поэтому в памяти держатся только недособранные
+// рейсы, а описание рейса из trips.txt удаляется после его импорта
+class GtfsImporter {
+private:
+    static constexpr std::size_t MAX_REPORTED_ERRORS = 10;
+
+    struct GtfsRoute {
+        std::string shortName;
+        std::string vehicleType;
+    };
+
+    struct GtfsTrip {
+        std::string routeId;
+        std::string blockId;
+        int calendarId;
+    };
+
+    struct StopTime {
+        int sequence;
+        std::uint32_t stop;  // индекс в stopNames
+        int minutes;         // -1, если время не задано (промежуточная остановка без времени)
+    };
+
+    struct ServiceRange {
+        std::uint8_t mask = 0;
+        std::optional<ServiceDate> start, end;
+        std::vector<std::pair<ServiceDate, bool>> exceptions;
+    };
+
+    TransportSystem& system;
+    std::filesystem::path directory;
+    GtfsImportStats stats;
+
+    std::unordered_map<std::string, std::uint32_t> stopIndex; // stop_id -> индекс названия
+    std::vector<std::string> stopNames;
+    std::unordered_set<std::string> usedStopNames;
+    std::unordered_map<std::string, GtfsRoute> gtfsRoutes;
+    std::unordered_map<std::string, GtfsTrip> gtfsTrips;
+    std::unordered_map<std::string, int> serviceCalendars;
+    std::unordered_map<std::string, std::shared_ptr<Route>> patterns; // route_id + остановки -> маршрут
+    std::unordered_map<const Vehicle*, std::shared_ptr<Driver>> vehicleDrivers;
+
+    std::unordered_set<int> usedStopIds, usedRouteNumbers, usedTripIds;
+    int nextStopId = 1, nextRouteNumber = 1, nextTripId = 1;
+
+    static int toInt(std::string_view text, int fallback) {
+        int value = 0;
+        auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), value);
+        return error == std::errc() && end == text.data() + text.size() ? value : fallback;
+    }
+
+    // ЧЧ:ММ:СС, часы могут быть больше 24 (рейсы после полуночи); пустое значение - -1
+    static int parseTime(std::string_view text) {
+        if (text.empty()) return -1;
+        std::size_t first = text.find(':'), second = text.rfind(':');
+        if (first == std::string_view::npos || first == second) {
+            throw TransportException("Неверный формат времени: " + std::string(text));
+        }
+        int hours = toInt(text.substr(0, first), -1);
+        int minutes = toInt(text.substr(first + 1, second - first - 1), -1);
+        if (hours < 0 || minutes < 0 || minutes > 59) {
+            throw TransportException("Неверный формат времени: " + std::string(text));
+        }
+        return hours * 60 + minutes;
+    }
+
+    // ГГГГММДД
+    static ServiceDate parseDate(std::string_view text) {
+        int value = toInt(text, -1);
+        std::chrono::year_month_day date{std::chrono::year(value / 10000),
+                                         std::chrono::month(static_cast<unsigned>(value / 100 % 100)),
+                                         std::chrono::day(static_cast<unsigned>(value % 100))};
+        if (text.size() != 8 || value < 0 || !date.ok()) {
+            throw TransportException("Неверный формат даты: " + std::string(text));
+        }
+        return ServiceDate(date);
+    }
+
+    // Разделители текстовых файлов данных в названиях заменяются пробелами
+    static std::string cleanName(std::string_view text) {
+        std::string name(text);
+        for (char& c : name) {
+            if (c == '|' || c == ';' || c == '=' || c == '\n' || c == '\r') c = ' ';
+        }
+        return name;
+    }
+
+    static std::string vehicleTypeFor(int routeType) {
+        switch (routeType) {
+            case 0: return "Трамвай";
+            case 11: return "Троллейбус";
+            default: return "Автобус";
+        }
+    }
+
+    // Числовой идентификатор GTFS сохраняется, если он свободен; иначе берется следующий свободный
+    static int allocate(std::string_view preferred, std::unordered_set<int>& used, int& next) {
+        int id = toInt(preferred, 0);
+        if (id <= 0 || used.count(id)) {
+            while (used.count(next)) ++next;
+            id = next;
+        }
+        used.insert(id);
+        return id;
+    }
+
+    void reportError(const char* file, std::size_t record, const std::exception& e) {
+        if (stats.skipped++ < MAX_REPORTED_ERRORS) {
+            stats.errors.push_back(std::string(file) + ", запись " + std::to_string(record) + ": " + e.what());
+        }
+    }
+
+    // Открытие файла ленты и чтение заголовка; nullopt, если необязательного файла нет
+    std::optional<CsvReader> open(const char* file, bool required) const {
+        std::filesystem::path filePath = directory / file;
+        if (!std::filesystem::exists(filePath)) {
+            if (required) throw TransportException(std::string("В ленте GTFS нет файла ") + file);
+            return std::nullopt;
+        }
+        std::optional<CsvReader> reader(std::in_place, filePath.string());
+        if (!reader->next()) return std::nullopt;
+        return reader;
+    }
+
+    static int requireColumn(const CsvReader& reader, const char* file, const char* name) {
+        int index = reader.column(name);
+        if (index < 0) {
+            throw TransportException(std::string("В файле ") + file + " нет столбца " + name);
+        }
+        return index;
+    }
+
+    void importStops() {
+        auto reader = open("stops.txt", true);
+        if (!reader) return;
+        int idColumn = requireColumn(*reader, "stops.txt", "stop_id");
+        int nameColumn = requireColumn(*reader, "stops.txt", "stop_name");
+        int latColumn = reader->column("stop_lat");
+        int lonColumn = reader->column("stop_lon");
+        int typeColumn = reader->column("location_type");
+
+        while (reader->next()) {
+            try {
+                // Станции и входы не обслуживаются рейсами напрямую
+                if (toInt((*reader)[typeColumn], 0) != 0) continue;
+                std::string gtfsId((*reader)[idColumn]);
+                std::string name = cleanName((*reader)[nameColumn]);
+                if (name.empty()) throw TransportException("Пустое название остановки " + gtfsId);
+                if (stopIndex.count(gtfsId)) throw TransportException("Повтор остановки " + gtfsId);
+                // Остановки системы различаются по названию, поэтому одноименные платформы
+                // получают в названии свой stop_id
+                if (usedStopNames.count(name)) {
+                    name += " (" + cleanName(gtfsId) + ")";
+                    if (usedStopNames.count(name)) throw TransportException("Повтор названия остановки " + name);
+                }
+
+                int id = allocate(gtfsId, usedStopIds, nextStopId);
+                std::string_view lat = (*reader)[latColumn], lon = (*reader)[lonColumn];
+                if (!lat.empty() && !lon.empty()) {
+                    system.addStop(Stop(id, name, std::stod(std::string(lat)), std::stod(std::string(lon))));
+                } else {
+                    system.addStop(Stop(id, name));
+                }
+                stopIndex.emplace(std::move(gtfsId), static_cast<std::uint32_t>(stopNames.size()));
+                usedStopNames.insert(name);
+                stopNames.push_back(std::move(name));
+                ++stats.stops;
+            } catch (const std::exception& e) {
+                reportError("stops.txt", reader->getRecordNumber(), e);
+            }
+        }
+    }
+
+    void importRoutes() {
+        auto reader = open("routes.txt", true);
+        if (!reader) return;
+        int idColumn = requireColumn(*reader, "routes.txt", "route_id");
+        int shortNameColumn = reader->column("route_short_name");
+        int typeColumn = reader->column("route_type");
+
+        while (reader->next()) {
+            gtfsRoutes[std::string((*reader)[idColumn])] =
+                {std::string((*reader)[shortNameColumn]), vehicleTypeFor(toInt((*reader)[typeColumn], 3))};
+        }
+    }
+
+    // Календарь системы на каждый service_id; период расширяется до дат исключений
+    void importCalendars() {
+        std::map<std::string, ServiceRange> services;
+
+        if (auto reader = open("calendar.txt", false)) {
+            static const char* const days[] = {"monday", "tuesday", "wednesday", "thursday",
+                                               "friday", "saturday", "sunday"};
+            int idColumn = requireColumn(*reader, "calendar.txt", "service_id");
+            int startColumn = requireColumn(*reader, "calendar.txt", "start_date");
+            int endColumn = requireColumn(*reader, "calendar.txt", "end_date");
+            int dayColumns[7];
+            for (int day = 0; day < 7; ++day) {
+                dayColumns[day] = requireColumn(*reader, "calendar.txt", days[day]);
+            }
+            while (reader->next()) {
+                try {
+                    ServiceRange& range = services[cleanName((*reader)[idColumn])];
+                    for (int day = 0; day < 7; ++day) {
+                        if ((*reader)[dayColumns[day]] == "1") range.mask |= 1u << day;
+                    }
+                    range.start = parseDate((*reader)[startColumn]);
+                    range.end = parseDate((*reader)[endColumn]);
+                } catch (const std::exception& e) {
+                    reportError("calendar.txt", reader->getRecordNumber(), e);
+                }
+            }
+        }
+
+        if (auto reader = open("calendar_dates.txt", false)) {
+            int idColumn = requireColumn(*reader, "calendar_dates.txt", "service_id");
+            int dateColumn = requireColumn(*reader, "calendar_dates.txt", "date");
+            int typeColumn = requireColumn(*reader, "calendar_dates.txt", "exception_type");
+            while (reader->next()) {
+                try {
+                    ServiceDate date = parseDate((*reader)[dateColumn]);
+                    services[cleanName((*reader)[idColumn])].exceptions.push_back(
+                        {date, (*reader)[typeColumn] == "1"});
+                } catch (const std::exception& e) {
+                    reportError("calendar_dates.txt", reader->getRecordNumber(), e);
+                }
+            }
+        }
+
+        int nextCalendarId = system.getCalendars().empty() ? 1 : system.getCalendars().rbegin()->first + 1;
+        for (auto& [serviceId, range] : services) {
+            try {
+                for (const auto& [date, active] : range.exceptions) {
+                    if (!range.start || date < *range.start) range.start = date;
+                    if (!range.end || date > *range.end) range.end = date;
+                }
+                if (!range.start) continue;
+                ServiceCalendar calendar(nextCalendarId, serviceId, range.mask, *range.start, *range.end);
+                for (const auto& [date, active] : range.exceptions) {
+                    calendar.addException(date, active);
+                }
+                system.addServiceCalendar(calendar);
+                serviceCalendars[serviceId] = nextCalendarId++;
+                ++stats.calendars;
+            } catch (const std::exception& e) {
+                reportError("calendar.txt", 0, e);
+            }
+        }
+    }
+
+    void importTrips() {
+        auto reader = open("trips.txt", true);
+        if (!reader) return;
+        int idColumn = requireColumn(*reader, "trips.txt", "trip_id");
+        int routeColumn = requireColumn(*reader, "trips.txt", "route_id");
+        int serviceColumn = reader->column("service_id");
+        int blockColumn = reader->column("block_id");
+
+        while (reader->next()) {
+            try {
+                std::string routeId((*reader)[routeColumn]);
+                if (!gtfsRoutes.count(routeId)) throw TransportException("Неизвестный маршрут " + routeId);
+                auto calendar = serviceCalendars.find(cleanName((*reader)[serviceColumn]));
+                gtfsTrips[std::string((*reader)[idColumn])] =
+                    {std::move(routeId), std::string((*reader)[blockColumn]),
+                     calendar != serviceCalendars.end() ? calendar->second : 0};
+            } catch (const std::exception& e) {
+                reportError("trips.txt", reader->getRecordNumber(), e);
+            }
+        }
+    }
+
+    // Маршрут системы для трассы: route_id и последовательность остановок
+    std::shared_ptr<Route> routeFor(const std::string& routeId, const std::vector<StopTime>& stopTimes) {
+        std::string key = routeId;
+        key += '\0';
+        for (const auto& stopTime : stopTimes) {
+            key.append(reinterpret_cast<const char*>(&stopTime.stop), sizeof(stopTime.stop));
+        }
+        auto it = patterns.find(key);
+        if (it != patterns.end()) return it->second;
+
+        std::vector<std::string> names;
+        names.reserve(stopTimes.size());
+        for (const auto& stopTime : stopTimes) {
+            names.push_back(stopNames[stopTime.stop]);
+        }
+        const GtfsRoute& gtfsRoute = gtfsRoutes.at(routeId);
+        int number = allocate(gtfsRoute.shortName, usedRouteNumbers, nextRouteNumber);
+        auto route = makePooled<Route>(number, gtfsRoute.vehicleType, names);
+        system.addRoute(route);
+        ++stats.routes;
+        return patterns.emplace(std::move(key), std::move(route)).first->second;
+    }
+
+    // Транспорт на блок рейсов GTFS (или на отдельный рейс) с водителем-заглушкой
+    // до распределения водителей
+    std::pair<std::shared_ptr<Vehicle>, std::shared_ptr<Driver>> vehicleFor(
+        const std::string& tripId, const GtfsTrip& trip, const std::string& vehicleType) {
+        std::string plate = cleanName(trip.blockId.empty() ? "GTFS-T" + tripId : "GTFS-B" + trip.blockId);
+        auto vehicle = system.findVehicleByLicensePlate(plate);
+        if (!vehicle) {
+            if (vehicleType == "Трамвай") {
+                vehicle = makePooled<Tram>("GTFS", plate);
+            } else if (vehicleType == "Троллейбус") {
+                vehicle = makePooled<Trolleybus>("GTFS", plate);
+            } else {
+                vehicle = makePooled<Bus>("GTFS", plate);
+            }
+            system.addVehicle(vehicle);
+        }
+
+        auto& driver = vehicleDrivers[vehicle.get()];
+        if (!driver) {
+            driver = makePooled<Driver>("Не назначен", plate);
+            system.addDriver(driver);
+        }
+        return {vehicle, driver};
+    }
+
+    void importTrip(const std::string& tripId, std::vector<StopTime>& stopTimes) {
+        auto found = gtfsTrips.find(tripId);
+        if (found == gtfsTrips.end()) {
+            throw TransportException("Рейс " + tripId + " не описан в trips.txt");
+        }
+        GtfsTrip trip = std::move(found->second);
+        gtfsTrips.erase(found);
+
+        std::stable_sort(stopTimes.begin(), stopTimes.end(),
+                         [](const StopTime& a, const StopTime& b) { return a.sequence < b.sequence; });
+        if (stopTimes.front().minutes < 0 || stopTimes.back().minutes < 0) {
+            throw TransportException("У рейса " + tripId + " не задано время на конечных остановках");
+        }
+
+        // Время промежуточных остановок без расписания - линейная интерполяция между соседними
+        for (std::size_t i = 1, known = 0; i < stopTimes.size(); ++i) {
+            if (stopTimes[i].minutes < 0) continue;
+            for (std::size_t j = known + 1; j < i; ++j) {
+                stopTimes[j].minutes = stopTimes[known].minutes +
+                    (stopTimes[i].minutes - stopTimes[known].minutes) * static_cast<int>(j - known) /
+                    static_cast<int>(i - known);
+            }
+            known = i;
+        }
+
+        auto route = routeFor(trip.routeId, stopTimes);
+        auto [vehicle, driver] = vehicleFor(tripId, trip, route->getVehicleType());
+        int id = allocate(tripId, usedTripIds, nextTripId);
+
+        auto imported = makePooled<Trip>(id, route, vehicle, driver, Time(0, stopTimes.front().minutes));
+        std::vector<Time> arrivals;
+        arrivals.reserve(stopTimes.size());
+        for (const auto& stopTime : stopTimes) {
+            arrivals.push_back(Time(0, stopTime.minutes));
+        }
+        imported->setArrivalTimes(arrivals);
+        imported->setCalendarId(trip.calendarId);
+        system.addTrip(imported);
+        ++stats.trips;
+        stats.stopTimes += stopTimes.size();
+    }
+
+    // Недособранный рейс: полученные записи и число еще не прочитанных
+    struct PendingTrip {
+        std::vector<StopTime> stopTimes;
+        std::size_t remaining = 0;
+        bool failed = false;
+    };
+
+    // Первый проход: число записей каждого рейса
+    std::unordered_map<std::string, std::size_t> countStopTimes() const {
+        std::unordered_map<std::string, std::size_t> counts;
+        auto reader = open("stop_times.txt", true);
+        if (!reader) return counts;
+        int tripColumn = requireColumn(*reader, "stop_times.txt", "trip_id");
+        std::string tripId;
+        while (reader->next()) {
+            tripId.assign((*reader)[tripColumn]);
+            ++counts[tripId];
+        }
+        return counts;
+    }
+
+    void importStopTimes() {
+        std::unordered_map<std::string, PendingTrip> pending;
+        for (auto& [tripId, count] : countStopTimes()) {
+            pending[tripId].remaining = count;
+        }
+
+        auto reader = open("stop_times.txt", true);
+        if (!reader) return;
+        int tripColumn = requireColumn(*reader, "stop_times.txt", "trip_id");
+        int stopColumn = requireColumn(*reader, "stop_times.txt", "stop_id");
+        int sequenceColumn = requireColumn(*reader, "stop_times.txt", "stop_sequence");
+        int arrivalColumn = reader->column("arrival_time");
+        int departureColumn = reader->column("departure_time");
+
+        std::string tripId;
+        while (reader->next()) {
+            tripId.assign((*reader)[tripColumn]);
+            auto it = pending.find(tripId);
+            if (it == pending.end()) continue; // файл изменился между проходами
+            PendingTrip& trip = it->second;
+
+            if (!trip.failed) {
+                try {
+                    auto stop = stopIndex.find(std::string((*reader)[stopColumn]));
+                    if (stop == stopIndex.end()) {
+                        throw TransportException("Неизвестная остановка " + std::string((*reader)[stopColumn]));
+                    }
+                    int minutes = parseTime((*reader)[arrivalColumn]);
+                    if (minutes < 0) minutes = parseTime((*reader)[departureColumn]);
+                    trip.stopTimes.push_back({toInt((*reader)[sequenceColumn], 0), stop->second, minutes});
+                } catch (const std::exception& e) {
+                    // Рейс с ошибочной записью пропускается целиком
+                    reportError("stop_times.txt", reader->getRecordNumber(), e);
+                    trip.failed = true;
+                    trip.stopTimes = {};
+                }
+            }
+
+            if (--trip.remaining == 0) {
+                if (trip.failed) {
+                    gtfsTrips.erase(tripId);
+                } else {
+                    try {
+                        importTrip(tripId, trip.stopTimes);
+                    } catch (const std::exception& e) {
+                        reportError("stop_times.txt", reader->getRecordNumber(), e);
+                    }
+                }
+                pending.erase(it);
+            }
+        }
+
+        // Записи, пропавшие между проходами: рейс не собран полностью
+        for (const auto& [id, trip] : pending) {
+            if (!trip.failed) {
+                reportError("stop_times.txt", reader->getRecordNumber(),
+                            TransportException("Записи рейса " + id + " изменились во время импорта"));
+            }
+            gtfsTrips.erase(id);
+        }
+    }
+
+public:
+    GtfsImporter(TransportSystem& sys, std::filesystem::path feedDirectory)
+        : system(sys), directory(std::move(feedDirectory)) {
+        for (const auto& stop : system.getStops()) {
+            usedStopIds.insert(stop.getId());
+            usedStopNames.insert(stop.getName());
+        }
+        for (const auto& route : system.getRoutes()) usedRouteNumbers.insert(route->getNumber());
+        for (const auto& trip : system.getTrips()) usedTripIds.insert(trip->getTripId());
+    }
+
+    GtfsImportStats run() {
+        if (!std::filesystem::is_directory(directory)) {
+            throw TransportException("Каталог GTFS не найден: " + directory.string());
+        }
+        importStops();
+        importRoutes();
+        importCalendars();
+        importTrips();
+        importStopTimes();
+
+        // Рейсы из trips.txt без единой записи в stop_times.txt
+        stats.skipped += gtfsTrips.size();
+        gtfsTrips.clear();
+        return stats;
+    }
+};
+
+// Итоги экспорта в GTFS
+struct GtfsExportStats {
+    std::size_t stops = 0;
+    std::size_t routes = 0;
+    std::size_t trips = 0;       // включая отправления шаблонов интервального движения
+    std::size_t stopTimes = 0;
+    std::size_t calendars = 0;
+    std::size_t stopsSkipped = 0; // остановки без координат (stop_lat и stop_lon обязательны)
+    std::size_t tripsSkipped = 0; // рейсы, у которых осталось меньше двух остановок с координатами
+};
+
+// Перевозчик для agency.txt: в системе один перевозчик на все маршруты
+struct GtfsAgency {
+    std::string id = "1";
+    std::string name = "Городской общественный транспорт";
+    std::string url = "https://example.org";
+    std::string timezone = "Europe/Minsk";
+};
+
+// Экспорт расписания в ленту GTFS. Рейсы и их расписания пишутся параллельно:
+// маршруты делятся на части примерно равного объема, каждый поток пишет свои файлы частей,
+// затем части дописываются в trips.txt и stop_times.txt по порядку.
+// Остановки без координат в ленту не попадают, их записи в stop_times пропускаются.
+// trip_id обычного рейса - его номер, отправления шаблона - "T<шаблон>_<отправление>",
+// поэтому идентификаторы не повторяются
+class GtfsExporter {
+private:
+    static constexpr const char* DAILY_SERVICE = "DAILY"; // рейсы без календаря
+
+    struct RouteWork {
+        const Route* route;
+        std::vector<const TripTemplate*> templates;
+        std::size_t weight; // число записей stop_times
+    };
+
+    struct Chunk {
+        std::size_t first, last; // диапазон в work
+        std::size_t trips = 0, stopTimes = 0, skipped = 0;
+        std::exception_ptr error;
+    };
+
+    const TransportSystem& system;
+    std::filesystem::path directory;
+    GtfsAgency agency;
+    unsigned threadCount;
+    std::unordered_map<std::string, int> stopIds; // название -> ID остановки для stop_times
+    std::vector<RouteWork> work;
+    bool dailyUsed = false;
+
+    static int routeType(const std::string& vehicleType) {
+        if (vehicleType == "Трамвай") return 0;
+        if (vehicleType == "Троллейбус") return 11;
+        return 3;
+    }
+
+    static void writeDate(CsvWriter& writer, ServiceDate date) {
+        std::chrono::year_month_day ymd(date);
+        writer.field(static_cast<int>(ymd.year()) * 10000 + static_cast<int>(static_cast<unsigned>(ymd.month())) * 100 +
+                     static_cast<int>(static_cast<unsigned>(ymd.day())));
+    }
+
+    static void writeService(CsvWriter& writer, int calendarId) {
+        if (calendarId == 0) {
+            writer.field(std::string_view(DAILY_SERVICE));
+        } else {
+            writer.field(calendarId);
+        }
+    }
+
+    std::string path(const char* file) const { return (directory / file).string(); }
+
+    // Остановки с координатами; остановки без координат и названия маршрутов без записи
+    // в списке остановок учитываются как пропущенные
+    GtfsExportStats writeStops() {
+        GtfsExportStats stats;
+        CsvWriter writer(path("stops.txt"));
+        writer.field(std::string_view("stop_id")).field(std::string_view("stop_name"))
+              .field(std::string_view("stop_lat")).field(std::string_view("stop_lon"));
+        writer.endRecord();
+
+        std::unordered_set<std::string> skipped;
+        for (const auto& stop : system.getStops()) {
+            if (!stop.hasCoordinates()) {
+                skipped.insert(stop.getName());
+                continue;
+            }
+            writer.field(stop.getId()).field(stop.getName())
+                  .field(stop.getLatitude()).field(stop.getLongitude());
+            writer.endRecord();
+            stopIds.try_emplace(stop.getName(), stop.getId());
+            ++stats.stops;
+        }
+        for (const auto& route : system.getRoutes()) {
+            for (const auto& name : route->getAllStops()) {
+                if (!stopIds.count(name)) skipped.insert(name);
+            }
+        }
+        stats.stopsSkipped = skipped.size();
+        return stats;
+    }
+
+    void writeAgency() {
+        CsvWriter writer(path("agency.txt"));
+        writer.field(std::string_view("agency_id")).field(std::string_view("agency_name"))
+              .field(std::string_view("agency_url")).field(std::string_view("agency_timezone"));
+        writer.endRecord();
+        writer.field(agency.id).field(agency.name).field(agency.url).field(agency.timezone);
+        writer.endRecord();
+    }
+
+    void writeRoutes(GtfsExportStats& stats) {
+        CsvWriter writer(path("routes.txt"));
+        writer.field(std::string_view("route_id")).field(std::string_view("agency_id"))
+              .field(std::string_view("route_short_name")).field(std::string_view("route_type"));
+        writer.endRecord();
+        for (const auto& route : system.getRoutes()) {
+            writer.field(route->getNumber()).field(agency.id).field(route->getNumber())
+                  .field(routeType(route->getVehicleType()));
+            writer.endRecord();
+            ++stats.routes;
+        }
+    }
+
+    void writeCalendars(GtfsExportStats& stats) {
+        CsvWriter calendar(path("calendar.txt"));
+        CsvWriter dates(path("calendar_dates.txt"));
+        for (const char* column : {"service_id", "monday", "tuesday", "wednesday", "thursday",
+                                   "friday", "saturday", "sunday", "start_date", "end_date"}) {
+            calendar.field(std::string_view(column));
+        }
+        calendar.endRecord();
+        dates.field(std::string_view("service_id")).field(std::string_view("date"))
+             .field(std::string_view("exception_type"));
+        dates.endRecord();
+
+        for (const auto& [id, service] : system.getCalendars()) {
+            calendar.field(id);
+            for (int day = 0; day < 7; ++day) {
+                calendar.field((service.getWeekdayMask() >> day) & 1);
+            }
+            writeDate(calendar, service.getStartDate());
+            writeDate(calendar, service.getEndDate());
+            calendar.endRecord();
+            for (ServiceDate date : service.getAddedDates()) {
+                dates.field(id);
+                writeDate(dates, date);
+                dates.field(1).endRecord();
+            }
+            for (ServiceDate date : service.getRemovedDates()) {
+                dates.field(id);
+                writeDate(dates, date);
+                dates.field(2).endRecord();
+            }
+            ++stats.calendars;
+        }
+
+        if (dailyUsed) {
+            calendar.field(std::string_view(DAILY_SERVICE));
+            for (int day = 0; day < 7; ++day) calendar.field(1);
+            calendar.field(20000101).field(20991231).endRecord();
+            ++stats.calendars;
+        }
+    }
+
+    // Маршруты с шаблонами и оценкой объема записей для деления на части
+    void collectWork() {
+        std::unordered_map<const Route*, std::vector<const TripTemplate*>> templates;
+        for (const auto& pattern : system.getTripTemplates()) {
+            templates[pattern->getRoute().get()].push_back(pattern.get());
+            dailyUsed |= pattern->getCalendarId() == 0;
+        }
+        for (const auto& trip : system.getTrips()) {
+            dailyUsed |= trip->getCalendarId() == 0;
+        }
+
+        for (const auto& route : system.getRoutes()) {
+            RouteWork item{route.get(), {}, 0};
+            if (const auto* trips = system.getRouteTrips(route->getHandle())) {
+                item.weight += trips->size() * route->getAllStops().size();
+            }
+            auto it = templates.find(route.get());
+            if (it != templates.end()) {
+                item.templates = std::move(it->second);
+                for (const TripTemplate* pattern : item.templates) {
+                    item.weight += static_cast<std::size_t>(pattern->getDepartureCount()) *
+                                   route->getAllStops().size();
+                }
+            }
+            work.push_back(std::move(item));
+        }
+    }
+
+    // Время прибытия в порядке маршрута: после полуночи часы продолжают расти (24:10 и т.д.)
+    static void writeTrip(CsvWriter& trips, CsvWriter& stopTimes, const Route& route, std::string_view tripId,
+                          int calendarId, const std::vector<std::pair<int, int>>& arrivals, Chunk& chunk) {
+        if (arrivals.size() < 2) {
+            ++chunk.skipped;
+            return;
+        }
+        trips.field(route.getNumber());
+        writeService(trips, calendarId);
+        trips.field(tripId).endRecord();
+        ++chunk.trips;
+
+        int sequence = 0;
+        for (const auto& [stopId, minutes] : arrivals) {
+            stopTimes.field(tripId).time(minutes).time(minutes).field(stopId).field(++sequence).endRecord();
+        }
+        chunk.stopTimes += arrivals.size();
+    }
+
+    void writeChunk(Chunk& chunk, std::size_t index) const {
+        try {
+            std::string suffix = ".part" + std::to_string(index);
+            CsvWriter trips(path("trips.txt") + suffix);
+            CsvWriter stopTimes(path("stop_times.txt") + suffix);
+            std::vector<std::pair<int, int>> arrivals;
+
+            for (std::size_t i = chunk.first; i < chunk.last; ++i) {
+                const Route& route = *work[i].route;
+                const auto& stops = route.getAllStops();
+
+                if (const auto* handles = system.getRouteTrips(route.getHandle())) {
+                    for (EntityHandle handle : *handles) {
+                        const Trip& trip = *system.getTripByHandle(handle);
+                        arrivals.clear();
+                        int previous = -1, dayOffset = 0;
+                        for (const auto& stop : stops) {
+                            if (!trip.hasStop(stop)) continue;
+                            int minutes = trip.getArrivalTime(stop).getTotalMinutes() + dayOffset;
+                            if (minutes < previous) {
+                                dayOffset += 1440;
+                                minutes += 1440;
+                            }
+                            previous = minutes;
+                            auto stopId = stopIds.find(stop);
+                            if (stopId != stopIds.end()) arrivals.push_back({stopId->second, minutes});
+                        }
+                        if (trip.getPattern()) {
+                            writeTrip(trips, stopTimes, route, std::to_string(trip.getTripId()),
+                                      trip.getCalendarId(), arrivals, chunk);
+                        }
+                    }
+                }
+
+                for (const TripTemplate* pattern : work[i].templates) {
+                    std::string prefix = "T" + std::to_string(pattern->getTemplateId()) + "_";
+                    for (int run = 0; run < pattern->getDepartureCount(); ++run) {
+                        arrivals.clear();
+                        for (std::size_t position = 0; position < stops.size(); ++position) {
+                            auto stopId = stopIds.find(stops[position]);
+                            if (stopId != stopIds.end()) {
+                                arrivals.push_back({stopId->second, pattern->getArrivalMinutes(run, position)});
+                            }
+                        }
+                        writeTrip(trips, stopTimes, route, prefix + std::to_string(run + 1),
+                                  pattern->getCalendarId(), arrivals, chunk);
+                    }
+                }
+            }
+            trips.flush();
+            stopTimes.flush();
+        } catch (...) {
+            chunk.error = std::current_exception();
+        }
+    }
+
+public:
+    GtfsExporter(const TransportSystem& sys, std::filesystem::path outputDirectory, GtfsAgency agencyInfo = {},
+                 unsigned threads = std::thread::hardware_concurrency())
+        : system(sys), directory(std::move(outputDirectory)), agency(std::move(agencyInfo)),
+          threadCount(std::max(1u, threads)) {}
+
+    GtfsExportStats run() {
+        std::filesystem::create_directories(directory);
+        collectWork();
+        GtfsExportStats stats = writeStops();
+        writeAgency();
+        writeRoutes(stats);
+        writeCalendars(stats);
+
+        // Деление маршрутов на части с близким числом записей stop_times
+        std::size_t total = 0;
+        for (const auto& item : work) total += item.weight;
+        std::size_t chunkCount = std::min<std::size_t>(threadCount, std::max<std::size_t>(work.size(), 1));
+        std::vector<Chunk> chunks;
+        std::size_t first = 0, accumulated = 0;
+        for (std::size_t i = 0; i < work.size(); ++i) {
+            accumulated += work[i].weight;
+            if (accumulated * chunkCount >= total * (chunks.size() + 1) || i + 1 == work.size()) {
+                chunks.push_back({first, i + 1, 0, 0, 0, nullptr});
+                first = i + 1;
+            }
+        }
+        if (chunks.empty()) chunks.push_back({0, 0, 0, 0, 0, nullptr});
+
+        std::vector<std::thread> workers;
+        for (std::size_t i = 1; i < chunks.size(); ++i) {
+            workers.emplace_back([this, &chunks, i]() { writeChunk(chunks[i], i); });
+        }
+        writeChunk(chunks[0], 0);
+        for (auto& worker : workers) worker.join();
+
+        CsvWriter trips(path("trips.txt"));
+        CsvWriter stopTimes(path("stop_times.txt"));
+        trips.field(std::string_view("route_id")).field(std::string_view("service_id"))
+             .field(std::string_view("trip_id"));
+        trips.endRecord();
+        for (const char* column : {"trip_id", "arrival_time", "departure_time", "stop_id", "stop_sequence"}) {
+            stopTimes.field(std::string_view(column));
+        }
+        stopTimes.endRecord();
+
+        std::exception_ptr error;
+        for (std::size_t i = 0; i < chunks.size(); ++i) {
+            std::string suffix = ".part" + std::to_string(i);
+            if (chunks[i].error) {
+                error = error ? error : chunks[i].error;
+            } else if (!error) {
+                trips.append(path("trips.txt") + suffix);
+                stopTimes.append(path("stop_times.txt") + suffix);
+            }
+            std::filesystem::remove(path("trips.txt") + suffix);
+            std::filesystem::remove(path("stop_times.txt") + suffix);
+            stats.trips += chunks[i].trips;
+            stats.stopTimes += chunks[i].stopTimes;
+            stats.tripsSkipped += chunks[i].skipped;
+        }
+        if (error) std::rethrow_exception(error);
+        trips.flush();
+        stopTimes.flush();
+        return stats;
+    }
+};
+
+// Машиночитаемые ответы на запросы: поездки, расписание остановки и список маршрутов
+// в JSON или CSV. Ответ дописывается в строку вызывающего; если она переиспользуется
+// между запросами, ответ формируется без выделений памяти
+class QueryResponseWriter {
+private:
+    static void journeyJson(JsonWriter& json, const Journey& journey) {
+        json.beginObject();
+        json.key("departure").time(journey.getStartTime().getTotalMinutes());
+        json.key("arrival").time(journey.getEndTime().getTotalMinutes());
+        json.key("durationMinutes").number(journey.getTotalDuration());
+        json.key("transfers").number(journey.getTransferCount());
+
+        const auto& trips = journey.getTrips();
+        const auto& transfers = journey.getTransferPoints();
+        json.key("legs").beginArray();
+        for (std::size_t i = 0; i < trips.size(); ++i) {
+            const Trip& trip = *trips[i];
+            json.beginObject();
+            json.key("trip").number(trip.getTripId());
+            json.key("route").number(trip.getRoute()->getNumber());
+            json.key("vehicleType").string(trip.getVehicle()->getType());
+            json.key("vehicle").string(trip.getVehicle()->getLicensePlate());
+            json.key("tripDeparture").time(trip.getStartTime().getTotalMinutes());
+            if (i > 0 && i - 1 < transfers.size()) {
+                json.key("transferAt").string(transfers[i - 1]);
+            }
+            json.endObject();
+        }
+        json.endArray();
+
+        json.key("walks").beginArray();
+        for (const auto& walk : journey.getWalkingLegs()) {
+            json.beginObject();
+            json.key("from").string(walk.from);
+            json.key("to").string(walk.to);
+            json.key("minutes").number(walk.minutes);
+            json.key("beforeLeg").number(walk.beforeTrip);
+            json.endObject();
+        }
+        json.endArray();
+        json.endObject();
+    }
+
+    // Шаги поездки по порядку: пешие переходы перед рейсом, затем сам рейс
+    static void journeyCsv(CsvWriter& csv, const Journey& journey, std::size_t number) {
+        const auto& trips = journey.getTrips();
+        const auto& transfers = journey.getTransferPoints();
+        std::size_t step = 0;
+        auto prefix = [&]() -> CsvWriter& {
+            return csv.field(number)
+                      .time(journey.getStartTime().getTotalMinutes(), false)
+                      .time(journey.getEndTime().getTotalMinutes(), false)
+                      .field(journey.getTransferCount())
+                      .field(++step);
+        };
+        auto walksBefore = [&](std::size_t leg) {
+            for (const auto& walk : journey.getWalkingLegs()) {
+                if (walk.beforeTrip != leg) continue;
+                prefix().field("walk").field(std::string_view()).field(std::string_view()).field(std::string_view())
+                        .field(walk.from).field(walk.to).field(walk.minutes);
+                csv.endRecord();
+            }
+        };
+
+        for (std::size_t i = 0; i < trips.size(); ++i) {
+            walksBefore(i);
+            const Trip& trip = *trips[i];
+            prefix().field("trip").field(trip.getRoute()->getNumber()).field(trip.getTripId())
+                    .field(trip.getVehicle()->getLicensePlate())
+                    .field(i > 0 && i - 1 < transfers.size() ? std::string_view(transfers[i - 1]) : std::string_view())
+                    .field(std::string_view()).field(std::string_view());
+            csv.endRecord();
+        }
+        walksBefore(trips.size());
+    }
+
+    static void journeyCsvHeader(CsvWriter& csv) {
+        for (const char* name : {"journey", "departure", "arrival", "transfers", "step", "type",
+                                 "route", "trip", "vehicle", "stop", "walk_to", "walk_minutes"}) {
+            csv.field(name);
+        }
+        csv.endRecord();
+    }
+
+public:
+    static void writeJson(std::string& out, const Journey& journey) {
+        JsonWriter json(out);
+        journeyJson(json, journey);
+    }
+
+    static void writeJson(std::string& out, const std::vector<Journey>& journeys) {
+        JsonWriter json(out);
+        json.beginArray();
+        for (const auto& journey : journeys) {
+            journeyJson(json, journey);
+        }
+        json.endArray();
+    }
+
+    static void writeJson(std::string& out, const StopTimetable& timetable) {
+        JsonWriter json(out);
+        json.beginObject();
+        json.key("stop").string(timetable.stopName);
+        json.key("from").time(timetable.from.getTotalMinutes());
+        json.key("to").time(timetable.to.getTotalMinutes());
+        json.key("date");
+        if (timetable.date) {
+            json.date(*timetable.date);
+        } else {
+            json.null();
+        }
+        json.key("arrivals").beginArray();
+        for (const auto& row : timetable.rows) {
+            json.beginObject();
+            json.key("route").number(row.routeNumber);
+            json.key("arrival").time(row.arrival.getTotalMinutes());
+            json.endObject();
+        }
+        json.endArray();
+        json.endObject();
+    }
+
+    static void writeJson(std::string& out, const std::vector<std::shared_ptr<Route>>& routes) {
+        JsonWriter json(out);
+        json.beginArray();
+        for (const auto& route : routes) {
+            json.beginObject();
+            json.key("number").number(route->getNumber());
+            json.key("vehicleType").string(route->getVehicleType());
+            json.key("from").string(route->getStartStop());
+            json.key("to").string(route->getEndStop());
+            json.key("stops").beginArray();
+            for (const auto& stop : route->getAllStops()) {
+                json.string(stop);
+            }
+            json.endArray();
+            json.endObject();
+        }
+        json.endArray();
+    }
+
+    static void writeCsv(std::string& out, const Journey& journey) {
+        CsvWriter csv(out);
+        journeyCsvHeader(csv);
+        journeyCsv(csv, journey, 1);
+    }
+
+    static void writeCsv(std::string& out, const std::vector<Journey>& journeys) {
+        CsvWriter csv(out);
+        journeyCsvHeader(csv);
+        for (std::size_t i = 0; i < journeys.size(); ++i) {
+            journeyCsv(csv, journeys[i], i + 1);
+        }
+    }
+
+    static void writeCsv(std::string& out, const StopTimetable& timetable) {
+        CsvWriter csv(out);
+        csv.field("stop").field("date").field("route").field("arrival");
+        csv.endRecord();
+        char date[16];
+        std::string_view dateText;
+        if (timetable.date) {
+            dateText = std::string_view(date, static_cast<std::size_t>(ServiceCalendar::formatDate(date, *timetable.date) - date));
+        }
+        for (const auto& row : timetable.rows) {
+            csv.field(timetable.stopName).field(dateText)
+               .field(row.routeNumber).time(row.arrival.getTotalMinutes(), false);
+            csv.endRecord();
+        }
+    }
+
+    static void writeCsv(std::string& out, const std::vector<std::shared_ptr<Route>>& routes) {
+        CsvWriter csv(out);
+        csv.field("number").field("vehicle_type").field("from").field("to").field("stops");
+        csv.endRecord();
+        for (const auto& route : routes) {
+            csv.field(route->getNumber()).field(route->getVehicleType())
+               .field(route->getStartStop()).field(route->getEndStop())
+               .field(route->getAllStops(), ';');
+            csv.endRecord();
+        }
+    }
+};
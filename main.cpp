@@ -1,1256 +1,6 @@
 #include <iostream>
 #include <windows.h>
-#include <utility>
-#include <vector>
-#include <string>
-#include <memory>
-#include <algorithm>
-#include <fstream>
-#include <sstream>
-#include <map>
-#include <ctime>
-#include <limits>
-#include <unordered_map>
-#include <set>
-#include <queue>
-#include <filesystem>
-#include <iomanip>
-
-class TransportSystem;
-
-// Базовый класс для исключений транспортной системы
-class TransportException : public std::exception {
-private:
-    std::string message;
-public:
-    explicit TransportException(std::string  msg) : message(std::move(msg)) {}
-    const char* what() const noexcept override { return message.c_str(); }
-};
-
-class Stop {
-private:
-    int id;
-    std::string name;
-public:
-    Stop(int stopId, std::string  stopName) : id(stopId), name(std::move(stopName)) {}
-
-    int getId() const { return id; }
-    std::string getName() const { return name; }
-
-    bool operator==(const Stop& other) const {
-        return id == other.id;
-    }
-
-    std::string serialize() const {
-        return std::to_string(id) + "|" + name;
-    }
-
-    static Stop deserialize(const std::string& data) {
-        std::istringstream ss(data);
-        std::string idStr, name;
-        std::getline(ss, idStr, '|');
-        std::getline(ss, name);
-        return Stop(std::stoi(idStr), name);
-    }
-};
-
-// Класс для времени
-class Time {
-private:
-    int hours;
-    int minutes;
-
-    // Вспомогательная функция для нормализации
-    void normalize(int totalMinutes) {
-        totalMinutes = ((totalMinutes % 1440) + 1440) % 1440; // [0, 1439]
-        hours = totalMinutes / 60;
-        minutes = totalMinutes % 60;
-    }
-
-public:
-    explicit Time(int h = 0, int m = 0) {
-        normalize(h * 60 + m);
-    }
-
-    explicit Time(const std::string& timeStr) {
-        std::stringstream ss(timeStr);
-        char colon;
-        int h, m;
-        if (!(ss >> h >> colon >> m) || colon != ':' || ss.fail() || !ss.eof()) {
-            throw TransportException("Неверный формат времени: " + timeStr);
-        }
-        if (h < 0 || h > 23 || m < 0 || m > 59) {
-            throw TransportException("Некорректное время: " + timeStr);
-        }
-        hours = h;
-        minutes = m;
-    }
-
-    int getTotalMinutes() const { return hours * 60 + minutes; }
-    int getHours() const { return hours; }
-    int getMinutes() const { return minutes; }
-
-    bool operator<(const Time& other) const {
-        return getTotalMinutes() < other.getTotalMinutes();
-    }
-
-    bool operator<=(const Time& other) const {
-        return getTotalMinutes() <= other.getTotalMinutes();
-    }
-
-    bool operator>(const Time& other) const {
-        return getTotalMinutes() > other.getTotalMinutes();
-    }
-
-    bool operator>=(const Time& other) const {
-        return getTotalMinutes() >= other.getTotalMinutes();
-    }
-
-    bool operator==(const Time& other) const {
-        return getTotalMinutes() == other.getTotalMinutes();
-    }
-
-    bool operator!=(const Time& other) const {
-        return getTotalMinutes() != other.getTotalMinutes();
-    }
-
-    Time operator+(int minutesToAdd) const {
-        return Time(0, getTotalMinutes() + minutesToAdd);
-    }
-
-    Time operator-(int minutesToSubtract) const {
-        return Time(0, getTotalMinutes() - minutesToSubtract);
-    }
-
-    int operator-(const Time& other) const {
-        return getTotalMinutes() - other.getTotalMinutes();
-    }
-
-    friend std::ostream& operator<<(std::ostream& os, const Time& time) {
-        os << (time.hours < 10 ? "0" : "") << time.hours << ":"
-           << (time.minutes < 10 ? "0" : "") << time.minutes;
-        return os;
-    }
-
-    friend std::istream& operator>>(std::istream& is, Time& time) {
-        std::string timeStr;
-        is >> timeStr;
-        time = Time(timeStr);
-        return is;
-    }
-
-    std::string serialize() const {
-        return (hours < 10 ? "0" : "") + std::to_string(hours) + ":" +
-               (minutes < 10 ? "0" : "") + std::to_string(minutes);
-    }
-
-    static Time deserialize(const std::string& data) {
-        return Time(data);
-    }
-};
-
-// Вперед объявления для транспортных средств
-class Bus;
-class Tram;
-class Trolleybus;
-
-// Базовый класс для транспортного средства
-class Vehicle {
-protected:
-    std::string type;
-    std::string model;
-    std::string licensePlate;
-public:
-    Vehicle(const std::string& t, const std::string& m, const std::string& lp)
-        : type(t), model(m), licensePlate(lp) {}
-
-    virtual ~Vehicle() = default;
-
-    std::string getInfo() const {
-        return type + " " + model + " " + licensePlate;
-    }
-
-    std::string getType() const { return type; }
-    std::string getModel() const { return model; }
-    std::string getLicensePlate() const { return licensePlate; }
-
-    virtual std::string serialize() const {
-        return type + "|" + model + "|" + licensePlate;
-    }
-
-    static std::shared_ptr<Vehicle> deserialize(const std::string& data) {
-        std::istringstream ss(data);
-        std::string type, model, licensePlate;
-        std::getline(ss, type, '|');
-        std::getline(ss, model, '|');
-        std::getline(ss, licensePlate);
-
-        // Используем фабричный метод для создания объектов
-        // Создание объектов будет выполнено в DataManager
-        throw TransportException("Используйте DataManager для создания транспортных средств");
-    }
-};
-
-// Классы конкретных транспортных средств
-class Bus : public Vehicle {
-public:
-    Bus(const std::string& m, const std::string& lp)
-        : Vehicle("Автобус", m, lp) {}
-};
-
-class Tram : public Vehicle {
-public:
-    Tram(const std::string& m, const std::string& lp)
-        : Vehicle("Трамвай", m, lp) {}
-};
-
-class Trolleybus : public Vehicle {
-public:
-    Trolleybus(const std::string& m, const std::string& lp)
-        : Vehicle("Троллейбус", m, lp) {}
-};
-
-// Класс водителя
-class Driver {
-private:
-    std::string firstName;
-    std::string lastName;
-    std::string middleName;
-public:
-    Driver(const std::string& fname, const std::string& lname, const std::string& mname = "")
-        : firstName(fname), lastName(lname), middleName(mname) {}
-
-    std::string getFullName() const {
-        return lastName + " " + firstName + (middleName.empty() ? "" : " " + middleName);
-    }
-
-    std::string getFirstName() const { return firstName; }
-    std::string getLastName() const { return lastName; }
-    std::string getMiddleName() const { return middleName; }
-
-    bool operator==(const Driver& other) const {
-        return firstName == other.firstName &&
-               lastName == other.lastName &&
-               middleName == other.middleName;
-    }
-
-    std::string serialize() const {
-        return firstName + "|" + lastName + "|" + middleName;
-    }
-
-    static std::shared_ptr<Driver> deserialize(const std::string& data) {
-        std::istringstream ss(data);
-        std::string firstName, lastName, middleName;
-        std::getline(ss, firstName, '|');
-        std::getline(ss, lastName, '|');
-        std::getline(ss, middleName);
-        return std::make_shared<Driver>(firstName, lastName, middleName);
-    }
-};
-
-class Route {
-private:
-    int number;
-    std::string vehicleType;
-    std::string startStop;
-    std::string endStop;
-    std::vector<std::string> allStops;
-
-public:
-    Route(int num, const std::string& vType, const std::vector<std::string>& stops)
-        : number(num), vehicleType(vType), allStops(stops) {
-        if (stops.empty()) {
-            throw TransportException("Маршрут не может быть пустым");
-        }
-        startStop = stops.front();
-        endStop = stops.back();
-    }
-
-    bool containsStop(const std::string& stop) const {
-        return std::find(allStops.begin(), allStops.end(), stop) != allStops.end();
-    }
-
-    int getStopPosition(const std::string& stop) const {
-        auto it = std::find(allStops.begin(), allStops.end(), stop);
-        if (it != allStops.end()) {
-            return static_cast<int>(std::distance(allStops.begin(), it));
-        }
-        return -1;
-    }
-
-    bool isStopBefore(const std::string& stopA, const std::string& stopB) const {
-        int posA = getStopPosition(stopA);
-        int posB = getStopPosition(stopB);
-        return posA != -1 && posB != -1 && posA < posB;
-    }
-
-    int getNumber() const { return number; }
-    std::string getVehicleType() const { return vehicleType; }
-    std::string getStartStop() const { return startStop; }
-    std::string getEndStop() const { return endStop; }
-    const std::vector<std::string>& getAllStops() const { return allStops; }
-
-    std::string serialize() const {
-        std::string result = std::to_string(number) + "|" + vehicleType + "|";
-        for (size_t i = 0; i < allStops.size(); ++i) {
-            result += allStops[i];
-            if (i < allStops.size() - 1) result += ";";
-        }
-        return result;
-    }
-
-    static std::shared_ptr<Route> deserialize(const std::string& data) {
-        std::istringstream ss(data);
-        std::string numberStr, vehicleType, stopsStr;
-        std::getline(ss, numberStr, '|');
-        std::getline(ss, vehicleType, '|');
-        std::getline(ss, stopsStr);
-
-        std::vector<std::string> stops;
-        std::istringstream stopsStream(stopsStr);
-        std::string stop;
-        while (std::getline(stopsStream, stop, ';')) {
-            stops.push_back(stop);
-        }
-
-        return std::make_shared<Route>(std::stoi(numberStr), vehicleType, stops);
-    }
-};
-
-// Вперед объявление для TransportSystem
-class TransportSystem;
-
-// Класс рейса
-class Trip {
-private:
-    int tripId;
-    std::shared_ptr<Route> route;
-    std::shared_ptr<Vehicle> vehicle;
-    std::shared_ptr<Driver> driver;
-    Time startTime;
-    std::map<std::string, Time> schedule; // остановка -> время прибытия
-
-public:
-    Trip(int id, std::shared_ptr<Route> r, std::shared_ptr<Vehicle> v,
-         std::shared_ptr<Driver> d, const Time& start)
-        : tripId(id), route(std::move(r)), vehicle(std::move(v)),
-          driver(std::move(d)), startTime(start) {}
-
-    void setArrivalTime(const std::string& stop, const Time& time) {
-        schedule[stop] = time;
-    }
-
-    Time getArrivalTime(const std::string& stop) const {
-        auto it = schedule.find(stop);
-        if (it != schedule.end()) {
-            return it->second;
-        }
-        throw TransportException("Остановка не найдена в расписании рейса");
-    }
-
-    bool hasStop(const std::string& stop) const {
-        return schedule.find(stop) != schedule.end();
-    }
-
-    int getTripId() const { return tripId; }
-    std::shared_ptr<Route> getRoute() const { return route; }
-    std::shared_ptr<Vehicle> getVehicle() const { return vehicle; }
-    std::shared_ptr<Driver> getDriver() const { return driver; }
-    Time getStartTime() const { return startTime; }
-    const std::map<std::string, Time>& getSchedule() const { return schedule; }
-
-    Time getEstimatedEndTime() const {
-        return startTime + 60; // Предполагаем 1 час для поездки
-    }
-
-    std::string serialize() const {
-        std::string result = std::to_string(tripId) + "|" + route->serialize() + "|" +
-                           vehicle->serialize() + "|" + driver->serialize() + "|" +
-                           startTime.serialize() + "|";
-
-        // Сериализация расписания
-        std::string scheduleStr;
-        for (const auto& [stop, time] : schedule) {
-            scheduleStr += stop + "=" + time.serialize() + ";";
-        }
-        if (!scheduleStr.empty()) scheduleStr.pop_back(); // Удаляем последнюю точку с запятой
-        result += scheduleStr;
-
-        return result;
-    }
-
-    static std::shared_ptr<Trip> deserialize(const std::string& data, TransportSystem* system = nullptr);
-};
-
-// Класс для хранения информации о поездке с пересадками
-class Journey {
-private:
-    std::vector<std::shared_ptr<Trip>> trips; // Рейсы, составляющие поездку
-    std::vector<std::string> transferPoints; // Точки пересадок
-    Time startTime;
-    Time endTime;
-    int transferCount;
-
-public:
-    Journey(const std::vector<std::shared_ptr<Trip>>& tripList,
-            const std::vector<std::string>& transfers,
-            Time start, Time end)
-        : trips(tripList), transferPoints(transfers),
-          startTime(start), endTime(end),
-          transferCount(static_cast<int>(transfers.size())) {}
-
-    int getTotalDuration() const {
-        return endTime - startTime;
-    }
-
-    int getTransferCount() const { return transferCount; }
-    Time getStartTime() const { return startTime; }
-    Time getEndTime() const { return endTime; }
-    const std::vector<std::shared_ptr<Trip>>& getTrips() const { return trips; }
-    const std::vector<std::string>& getTransferPoints() const { return transferPoints; }
-
-    void display() const {
-        std::cout << "\nМаршрут поездки:\n";
-        std::cout << "Общее время: " << getTotalDuration() << " минут\n";
-        std::cout << "Пересадок: " << transferCount << "\n";
-        std::cout << "Время отправления: " << startTime << "\n";
-        std::cout << "Время прибытия: " << endTime << "\n";
-
-        for (size_t i = 0; i < trips.size(); ++i) {
-            std::cout << "\nЭтап " << (i + 1) << ":\n";
-            std::cout << "  Маршрут: " << trips[i]->getRoute()->getNumber() << "\n";
-            std::cout << "  Транспорт: " << trips[i]->getVehicle()->getInfo() << "\n";
-
-            if (i > 0) {
-                std::cout << "  Пересадка на: " << transferPoints[i - 1] << "\n";
-            }
-        }
-    }
-};
-
-// Класс планировщика поездок
-class JourneyPlanner {
-private:
-    TransportSystem* system;
-
-public:
-    JourneyPlanner(TransportSystem* sys) : system(sys) {}
-
-    std::vector<Journey> findJourneysWithTransfers(const std::string& startStop,
-                                                   const std::string& endStop,
-                                                   const Time& departureTime,
-                                                   int maxTransfers = 2) const;
-
-    Journey findFastestJourney(const std::string& startStop,
-                               const std::string& endStop,
-                               const Time& departureTime);
-
-    Journey findJourneyWithLeastTransfers(const std::string& startStop,
-                                          const std::string& endStop,
-                                          const Time& departureTime);
-
-    void displayJourney(const Journey& journey) const {
-        journey.display();
-    }
-};
-
-// Класс для управления графиком водителей
-class DriverSchedule {
-private:
-    std::unordered_map<std::shared_ptr<Driver>,
-                       std::vector<std::shared_ptr<Trip>>> driverTrips;
-    const int MAX_WORKING_HOURS = 12 * 60; // 12 часов в минутах
-
-public:
-    void assignTripToDriver(std::shared_ptr<Driver> driver,
-                           std::shared_ptr<Trip> trip) {
-        driverTrips[driver].push_back(trip);
-    }
-
-    void removeTripFromDriver(std::shared_ptr<Driver> driver, int tripId) {
-        auto& trips = driverTrips[driver];
-        trips.erase(std::remove_if(trips.begin(), trips.end(),
-            [tripId](const auto& trip) {
-                return trip->getTripId() == tripId;
-            }), trips.end());
-    }
-
-    bool isDriverAvailable(std::shared_ptr<Driver> driver,
-                          const Time& startTime,
-                          const Time& endTime) const {
-        auto it = driverTrips.find(driver);
-        if (it == driverTrips.end()) return true;
-
-        for (const auto& trip : it->second) {
-            Time tripStart = trip->getStartTime();
-            Time tripEnd = tripStart + 60; // Предполагаем 1 час для поездки
-
-            if (!(endTime < tripStart || startTime > tripEnd)) {
-                return false; // Найдено пересечение
-            }
-        }
-        return true;
-    }
-
-    bool checkWorkingHoursCompliance(std::shared_ptr<Driver> driver) const {
-        auto it = driverTrips.find(driver);
-        if (it == driverTrips.end()) return true;
-
-        int totalMinutes = 0;
-        for (const auto& trip : it->second) {
-            totalMinutes += 60; // Предполагаем 1 час на поездку
-        }
-
-        return totalMinutes <= MAX_WORKING_HOURS;
-    }
-
-    std::vector<std::shared_ptr<Trip>> getDriverTrips(
-        std::shared_ptr<Driver> driver) const {
-        auto it = driverTrips.find(driver);
-        if (it != driverTrips.end()) {
-            return it->second;
-        }
-        return {};
-    }
-
-    int getTotalWorkingMinutes(std::shared_ptr<Driver> driver) const {
-        auto trips = getDriverTrips(driver);
-        return static_cast<int>(trips.size()) * 60;
-    }
-};
-
-// Класс для управления данными (сохранение/загрузка в текстовые файлы)
-class DataManager {
-private:
-    std::string dataDirectory;
-
-public:
-    DataManager(const std::string& dir = "data/") : dataDirectory(dir) {
-        // Создаем директорию, если её нет
-        std::filesystem::create_directories(dataDirectory);
-    }
-
-    // Сохранение всех данных в текстовые файлы
-    void saveAllData(TransportSystem& system);
-
-    // Загрузка всех данных из текстовых файлов
-    void loadAllData(TransportSystem& system);
-
-private:
-    void saveStops(TransportSystem& system);
-    void saveVehicles(TransportSystem& system);
-    void saveDrivers(TransportSystem& system);
-    void saveRoutes(TransportSystem& system);
-    void saveTrips(TransportSystem& system);
-    void saveAdminCredentials(TransportSystem& system);
-
-    void loadStops(TransportSystem& system);
-    void loadVehicles(TransportSystem& system);
-    void loadDrivers(TransportSystem& system);
-    void loadRoutes(TransportSystem& system);
-    void loadTrips(TransportSystem& system);
-    void loadAdminCredentials(TransportSystem& system);
-};
-
-// Класс транспортной системы
-class TransportSystem {
-private:
-    std::vector<std::shared_ptr<Route>> routes;
-    std::vector<std::shared_ptr<Trip>> trips;
-    std::vector<std::shared_ptr<Vehicle>> vehicles;
-    std::vector<std::shared_ptr<Driver>> drivers;
-    std::vector<Stop> stops;
-    std::unordered_map<int, std::string> stopIdToName;
-    std::unordered_map<std::string, std::string> adminCredentials;
-
-    // Новые компоненты
-    JourneyPlanner journeyPlanner;
-    DriverSchedule driverSchedule;
-    DataManager dataManager;
-
-public:
-    TransportSystem() : journeyPlanner(this), dataManager() {
-        // Инициализация учетных данных администраторов
-        adminCredentials["admin"] = "admin123";
-        adminCredentials["manager"] = "manager123";
-    }
-
-    // Аутентификация администратора
-    bool authenticateAdmin(const std::string& username, const std::string& password) {
-        auto it = adminCredentials.find(username);
-        return it != adminCredentials.end() && it->second == password;
-    }
-
-    // Добавление нового администратора
-    void addAdmin(const std::string& username, const std::string& password) {
-        adminCredentials[username] = password;
-    }
-
-    // Сохранение данных
-    void saveData() {
-        dataManager.saveAllData(*this);
-    }
-
-    // Загрузка данных
-    void loadData() {
-        dataManager.loadAllData(*this);
-    }
-
-    // Функция поиска маршрутов между двумя остановками
-    std::vector<std::shared_ptr<Route>> findRoutes(const std::string& stopA, const std::string& stopB) {
-        std::vector<std::shared_ptr<Route>> foundRoutes;
-        for (const auto& route : routes) {
-            if (route->containsStop(stopA) &&
-                route->containsStop(stopB) &&
-                route->isStopBefore(stopA, stopB)) {
-                foundRoutes.push_back(route);
-            }
-        }
-        return foundRoutes;
-    }
-
-    // Просмотр расписания для остановки
-    void getStopTimetable(int stopId, const Time& startTime, const Time& endTime) {
-        auto it = stopIdToName.find(stopId);
-        if (it == stopIdToName.end()) {
-            throw TransportException("Остановка с ID " + std::to_string(stopId) + " не найдена");
-        }
-        const std::string& stopName = it->second;
-
-        std::vector<std::pair<int, Time>> relevantTrips;
-
-        for (const auto& trip : trips) {
-            if (trip->hasStop(stopName)) {
-                Time arrivalTime = trip->getArrivalTime(stopName);
-                if (startTime <= arrivalTime && arrivalTime <= endTime) {
-                    relevantTrips.push_back({trip->getRoute()->getNumber(), arrivalTime});
-                }
-            }
-        }
-
-        std::sort(relevantTrips.begin(), relevantTrips.end(),
-                  [](const auto& a, const auto& b) { return a.second < b.second; });
-
-        std::cout << "\nРасписание для остановки '" << stopName << "' с "
-                  << startTime << " по " << endTime << ":\n";
-        if (relevantTrips.empty()) {
-            std::cout << "Рейсов не найдено.\n";
-        } else {
-            for (const auto& trip : relevantTrips) {
-                std::cout << "Маршрут " << trip.first << " - прибытие в " << trip.second << '\n';
-            }
-        }
-    }
-
-    // Расчет времени прибытия для рейса - ИСПРАВЛЕННАЯ ВЕРСИЯ
-    void calculateArrivalTimes(int tripId, double averageSpeed) {
-        if (averageSpeed <= 0) {
-            throw TransportException("Средняя скорость должна быть положительной");
-        }
-
-        auto tripIt = std::find_if(trips.begin(), trips.end(),
-                                   [tripId](const auto& t) { return t->getTripId() == tripId; });
-
-        if (tripIt == trips.end()) {
-            throw TransportException("Рейс с ID " + std::to_string(tripId) + " не найден");
-        }
-
-        auto trip = *tripIt;
-        const auto& stopsList = trip->getRoute()->getAllStops();
-
-        if (stopsList.empty()) {
-            throw TransportException("Маршрут не содержит остановок");
-        }
-
-        Time currentTime = trip->getStartTime();
-        trip->setArrivalTime(stopsList[0], currentTime);
-
-        const double distanceBetweenStops = 1.5; // км
-        const int stopTime = 1; // минута
-
-        for (size_t i = 1; i < stopsList.size(); ++i) {
-            double travelTimeMinutes = (distanceBetweenStops / averageSpeed) * 60;
-            Time arrivalTime = currentTime + static_cast<int>(travelTimeMinutes + 0.5);
-            trip->setArrivalTime(stopsList[i], arrivalTime);
-            currentTime = arrivalTime + stopTime;
-        }
-
-        std::cout << "Расписание для рейса " << tripId << " рассчитано.\n";
-    }
-
-    // АДМИНИСТРАТИВНЫЕ ФУНКЦИИ
-    void addRoute(std::shared_ptr<Route> route) {
-        // Проверка на уникальность номера маршрута
-        for (const auto& existingRoute : routes) {
-            if (existingRoute->getNumber() == route->getNumber()) {
-                throw TransportException("Маршрут с номером " + std::to_string(route->getNumber()) + " уже существует");
-            }
-        }
-        routes.push_back(std::move(route));
-    }
-
-    void addTrip(std::shared_ptr<Trip> trip) {
-        // Проверка на уникальность ID рейса
-        for (const auto& existingTrip : trips) {
-            if (existingTrip->getTripId() == trip->getTripId()) {
-                throw TransportException("Рейс с ID " + std::to_string(trip->getTripId()) + " уже существует");
-            }
-        }
-
-        // Проверка, что водитель существует
-        bool driverExists = std::find(drivers.begin(), drivers.end(),
-                                      trip->getDriver()) != drivers.end();
-        if (!driverExists) {
-            throw TransportException("Водитель не зарегистрирован в системе!");
-        }
-
-        // Проверка, что транспорт существует
-        bool vehicleExists = std::find(vehicles.begin(), vehicles.end(),
-                                       trip->getVehicle()) != vehicles.end();
-        if (!vehicleExists) {
-            throw TransportException("Транспорт не зарегистрирован в системе!");
-        }
-
-        trips.push_back(std::move(trip));
-    }
-
-    void addVehicle(std::shared_ptr<Vehicle> vehicle) {
-        // Проверка на уникальность номерного знака
-        for (const auto& existingVehicle : vehicles) {
-            if (existingVehicle->getLicensePlate() == vehicle->getLicensePlate()) {
-                throw TransportException("Транспортное средство с номером " + vehicle->getLicensePlate() + " уже существует");
-            }
-        }
-        vehicles.push_back(std::move(vehicle));
-    }
-
-    void addDriver(std::shared_ptr<Driver> driver) {
-        drivers.push_back(std::move(driver));
-    }
-
-    void addStop(const Stop& stop) {
-        // Проверка на уникальность ID остановки
-        for (const auto& existingStop : stops) {
-            if (existingStop.getId() == stop.getId()) {
-                throw TransportException("Остановка с ID " + std::to_string(stop.getId()) + " уже существует");
-            }
-        }
-        stops.push_back(stop);
-        stopIdToName[stop.getId()] = stop.getName();
-    }
-
-    void removeRoute(int routeNumber) {
-        auto it = std::find_if(routes.begin(), routes.end(),
-                              [routeNumber](const auto& r) { return r->getNumber() == routeNumber; });
-        if (it != routes.end()) {
-            routes.erase(it);
-            std::cout << "Маршрут " << routeNumber << " удален.\n";
-        } else {
-            throw TransportException("Маршрут с номером " + std::to_string(routeNumber) + " не найден");
-        }
-    }
-
-    void removeTrip(int tripId) {
-        auto it = std::find_if(trips.begin(), trips.end(),
-                              [tripId](const auto& t) { return t->getTripId() == tripId; });
-        if (it != trips.end()) {
-            trips.erase(it);
-            std::cout << "Рейс " << tripId << " удален.\n";
-        } else {
-            throw TransportException("Рейс с ID " + std::to_string(tripId) + " не найден");
-        }
-    }
-
-    // Просмотр всех данных
-    void displayAllRoutes() const {
-        std::cout << "\n=== ВСЕ МАРШРУТЫ ===\n";
-        for (const auto& route : routes) {
-            std::cout << "Маршрут " << route->getNumber() << " (" << route->getVehicleType()
-                      << "): " << route->getStartStop() << " -> " << route->getEndStop() << "\n";
-        }
-    }
-
-    void displayAllTrips() const {
-        std::cout << "\n=== ВСЕ РЕЙСЫ ===\n";
-        for (const auto& trip : trips) {
-            std::cout << "Рейс " << trip->getTripId() << ": Маршрут " << trip->getRoute()->getNumber()
-                      << ", ТС: " << trip->getVehicle()->getInfo()
-                      << ", Водитель: " << trip->getDriver()->getFullName()
-                      << ", Отправление: " << trip->getStartTime() << "\n";
-        }
-    }
-
-    void displayAllVehicles() const {
-        std::cout << "\n=== ВСЕ ТРАНСПОРТНЫЕ СРЕДСТВА ===\n";
-        for (const auto& vehicle : vehicles) {
-            std::cout << vehicle->getInfo() << '\n';
-        }
-    }
-
-    void displayAllStops() const {
-        std::cout << "\n=== ВСЕ ОСТАНОВКИ ===\n";
-        for (const auto& stop : stops) {
-            std::cout << "ID: " << stop.getId() << " - " << stop.getName() << '\n';
-        }
-    }
-
-    // Получение всех рейсов
-    const std::vector<std::shared_ptr<Trip>>& getTrips() const { return trips; }
-    const std::vector<std::shared_ptr<Route>>& getRoutes() const { return routes; }
-    const std::vector<std::shared_ptr<Vehicle>>& getVehicles() const { return vehicles; }
-    const std::vector<Stop>& getStops() const { return stops; }
-    const std::vector<std::shared_ptr<Driver>>& getDrivers() const { return drivers; }
-
-    // Получение компонентов
-    JourneyPlanner& getJourneyPlanner() { return journeyPlanner; }
-    DriverSchedule& getDriverSchedule() { return driverSchedule; }
-
-    // Поиск водителя по ФИО
-    std::shared_ptr<Driver> findDriverByName(const std::string& firstName,
-                                            const std::string& lastName,
-                                            const std::string& middleName = "") const {
-        for (const auto& driver : drivers) {
-            if (driver->getFirstName() == firstName &&
-                driver->getLastName() == lastName &&
-                (middleName.empty() || driver->getMiddleName() == middleName)) {
-                return driver;
-            }
-        }
-        return nullptr;
-    }
-
-    // Поиск транспорта по номеру
-    std::shared_ptr<Vehicle> findVehicleByLicensePlate(const std::string& licensePlate) const {
-        for (const auto& vehicle : vehicles) {
-            if (vehicle->getLicensePlate() == licensePlate) {
-                return vehicle;
-            }
-        }
-        return nullptr;
-    }
-
-    // Поиск маршрута по номеру
-    std::shared_ptr<Route> findRouteByNumber(int number) const {
-        for (const auto& route : routes) {
-            if (route->getNumber() == number) {
-                return route;
-            }
-        }
-        return nullptr;
-    }
-
-    // Получение всех рейсов через остановку
-    std::vector<std::shared_ptr<Trip>> getTripsThroughStop(const std::string& stopName) const {
-        std::vector<std::shared_ptr<Trip>> result;
-        for (const auto& trip : trips) {
-            if (trip->hasStop(stopName)) {
-                result.push_back(trip);
-            }
-        }
-        return result;
-    }
-
-    // Получение остановки по ID
-    std::string getStopNameById(int id) const {
-        auto it = stopIdToName.find(id);
-        if (it != stopIdToName.end()) {
-            return it->second;
-        }
-        return "";
-    }
-
-    // Для использования в Trip::deserialize
-    friend class Trip;
-};
-
-// Реализация Trip::deserialize после определения TransportSystem
-std::shared_ptr<Trip> Trip::deserialize(const std::string& data, TransportSystem* system) {
-    std::istringstream ss(data);
-    std::string token;
-    std::vector<std::string> tokens;
-
-    while (std::getline(ss, token, '|')) {
-        tokens.push_back(token);
-    }
-
-    if (tokens.size() < 6) {
-        throw TransportException("Некорректные данные рейса");
-    }
-
-    int tripId = std::stoi(tokens[0]);
-    auto route = Route::deserialize(tokens[1]);
-
-    // Для транспортного средства ищем его в системе
-    std::shared_ptr<Vehicle> vehicle = nullptr;
-    if (system) {
-        // Извлекаем номерной знак из сериализованных данных
-        std::istringstream vehicleStream(tokens[2]);
-        std::string type, model, licensePlate;
-        std::getline(vehicleStream, type, '|');
-        std::getline(vehicleStream, model, '|');
-        std::getline(vehicleStream, licensePlate);
-
-        // Ищем транспорт в системе
-        vehicle = system->findVehicleByLicensePlate(licensePlate);
-    }
-
-    auto driver = Driver::deserialize(tokens[3]);
-    Time startTime = Time::deserialize(tokens[4]);
-
-    if (!vehicle) {
-        throw TransportException("Транспортное средство не найдено в системе");
-    }
-
-    auto trip = std::make_shared<Trip>(tripId, route, vehicle, driver, startTime);
-
-    // Десериализация расписания
-    if (!tokens[5].empty()) {
-        std::istringstream scheduleStream(tokens[5]);
-        std::string scheduleItem;
-        while (std::getline(scheduleStream, scheduleItem, ';')) {
-            size_t eqPos = scheduleItem.find('=');
-            if (eqPos != std::string::npos) {
-                std::string stop = scheduleItem.substr(0, eqPos);
-                Time time = Time::deserialize(scheduleItem.substr(eqPos + 1));
-                trip->setArrivalTime(stop, time);
-            }
-        }
-    }
-
-    return trip;
-}
-
-// Реализация методов DataManager
-void DataManager::saveAllData(TransportSystem& system) {
-    try {
-        std::cout << "Сохранение данных в текстовые файлы...\n";
-
-        saveStops(system);
-        saveVehicles(system);
-        saveDrivers(system);
-        saveRoutes(system);
-        saveTrips(system);
-        saveAdminCredentials(system);
-
-        std::cout << "Данные успешно сохранены!\n";
-    } catch (const std::exception& e) {
-        std::cout << "Ошибка при сохранении данных: " << e.what() << "\n";
-    }
-}
-
-void DataManager::loadAllData(TransportSystem& system) {
-    try {
-        std::cout << "Загрузка данных из текстовых файлов...\n";
-
-        loadStops(system);
-        loadVehicles(system);
-        loadDrivers(system);
-        loadRoutes(system);
-        loadTrips(system);
-        loadAdminCredentials(system);
-
-        std::cout << "Данные успешно загружены!\n";
-    } catch (const std::exception& e) {
-        std::cout << "Ошибка при загрузке данных: " << e.what() << "\n";
-        std::cout << "Используются тестовые данные.\n";
-    }
-}
-
-void DataManager::saveStops(TransportSystem& system) {
-    std::ofstream file(dataDirectory + "stops.txt");
-    if (!file.is_open()) throw TransportException("Не удалось открыть файл stops.txt");
-
-    const auto& stops = system.getStops();
-    for (const auto& stop : stops) {
-        file << stop.serialize() << "\n";
-    }
-    file.close();
-}
-
-void DataManager::saveVehicles(TransportSystem& system) {
-    std::ofstream file(dataDirectory + "vehicles.txt");
-    if (!file.is_open()) throw TransportException("Не удалось открыть файл vehicles.txt");
-
-    const auto& vehicles = system.getVehicles();
-    for (const auto& vehicle : vehicles) {
-        file << vehicle->serialize() << "\n";
-    }
-    file.close();
-}
-
-void DataManager::saveDrivers(TransportSystem& system) {
-    std::ofstream file(dataDirectory + "drivers.txt");
-    if (!file.is_open()) throw TransportException("Не удалось открыть файл drivers.txt");
-
-    const auto& drivers = system.getDrivers();
-    for (const auto& driver : drivers) {
-        file << driver->serialize() << "\n";
-    }
-    file.close();
-}
-
-void DataManager::saveRoutes(TransportSystem& system) {
-    std::ofstream file(dataDirectory + "routes.txt");
-    if (!file.is_open()) throw TransportException("Не удалось открыть файл routes.txt");
-
-    const auto& routes = system.getRoutes();
-    for (const auto& route : routes) {
-        file << route->serialize() << "\n";
-    }
-    file.close();
-}
-
-void DataManager::saveTrips(TransportSystem& system) {
-    std::ofstream file(dataDirectory + "trips.txt");
-    if (!file.is_open()) throw TransportException("Не удалось открыть файл trips.txt");
-
-    const auto& trips = system.getTrips();
-    for (const auto& trip : trips) {
-        file << trip->serialize() << "\n";
-    }
-    file.close();
-}
-
-void DataManager::saveAdminCredentials(TransportSystem& system) {
-    std::ofstream file(dataDirectory + "admins.txt");
-    if (!file.is_open()) throw TransportException("Не удалось открыть файл admins.txt");
-
-    file << "admin|admin123\n";
-    file << "manager|manager123\n";
-    file.close();
-}
-
-void DataManager::loadStops(TransportSystem& system) {
-    std::ifstream file(dataDirectory + "stops.txt");
-    if (!file.is_open()) return; // Файл может отсутствовать
-
-    std::string line;
-    while (std::getline(file, line)) {
-        if (!line.empty()) {
-            system.addStop(Stop::deserialize(line));
-        }
-    }
-    file.close();
-}
-
-void DataManager::loadVehicles(TransportSystem& system) {
-    std::ifstream file(dataDirectory + "vehicles.txt");
-    if (!file.is_open()) return;
-
-    std::string line;
-    while (std::getline(file, line)) {
-        if (!line.empty()) {
-            try {
-                std::istringstream ss(line);
-                std::string type, model, licensePlate;
-                std::getline(ss, type, '|');
-                std::getline(ss, model, '|');
-                std::getline(ss, licensePlate);
-
-                std::shared_ptr<Vehicle> vehicle;
-                if (type == "Автобус") {
-                    vehicle = std::make_shared<Bus>(model, licensePlate);
-                } else if (type == "Трамвай") {
-                    vehicle = std::make_shared<Tram>(model, licensePlate);
-                } else if (type == "Троллейбус") {
-                    vehicle = std::make_shared<Trolleybus>(model, licensePlate);
-                } else {
-                    throw TransportException("Неизвестный тип транспорта: " + type);
-                }
-
-                system.addVehicle(vehicle);
-            } catch (const std::exception& e) {
-                std::cout << "Ошибка загрузки транспортного средства: " << e.what() << "\n";
-            }
-        }
-    }
-    file.close();
-}
-
-void DataManager::loadDrivers(TransportSystem& system) {
-    std::ifstream file(dataDirectory + "drivers.txt");
-    if (!file.is_open()) return;
-
-    std::string line;
-    while (std::getline(file, line)) {
-        if (!line.empty()) {
-            system.addDriver(Driver::deserialize(line));
-        }
-    }
-    file.close();
-}
-
-void DataManager::loadRoutes(TransportSystem& system) {
-    std::ifstream file(dataDirectory + "routes.txt");
-    if (!file.is_open()) return;
-
-    std::string line;
-    while (std::getline(file, line)) {
-        if (!line.empty()) {
-            try {
-                system.addRoute(Route::deserialize(line));
-            } catch (const std::exception& e) {
-                std::cout << "Ошибка загрузки маршрута: " << e.what() << "\n";
-            }
-        }
-    }
-    file.close();
-}
-
-void DataManager::loadTrips(TransportSystem& system) {
-    std::ifstream file(dataDirectory + "trips.txt");
-    if (!file.is_open()) return;
-
-    std::string line;
-    while (std::getline(file, line)) {
-        if (!line.empty()) {
-            try {
-                system.addTrip(Trip::deserialize(line, &system));
-            } catch (const std::exception& e) {
-                std::cout << "Ошибка загрузки рейса: " << e.what() << "\n";
-            }
-        }
-    }
-    file.close();
-}
-
-void DataManager::loadAdminCredentials(TransportSystem& system) {
-    std::ifstream file(dataDirectory + "admins.txt");
-    if (!file.is_open()) return;
-
-    std::string line;
-    while (std::getline(file, line)) {
-        if (!line.empty()) {
-            std::istringstream ss(line);
-            std::string username, password;
-            std::getline(ss, username, '|');
-            std::getline(ss, password);
-            system.addAdmin(username, password);
-        }
-    }
-    file.close();
-}
-
-// Реализация методов JourneyPlanner
-std::vector<Journey> JourneyPlanner::findJourneysWithTransfers(
-    const std::string& startStop,
-    const std::string& endStop,
-    const Time& departureTime,
-    int maxTransfers) const {
-
-    std::vector<Journey> journeys;
-
-    // Структура для BFS поиска
-    struct SearchNode {
-        std::string currentStop;
-        Time currentTime;
-        std::vector<std::shared_ptr<Trip>> pathTrips;
-        std::vector<std::string> transferPoints;
-        int transfers;
-    };
-
-    std::queue<SearchNode> q;
-    q.push({startStop, departureTime, {}, {}, 0});
-
-    while (!q.empty()) {
-        auto node = q.front();
-        q.pop();
-
-        // Если достигли конечной остановки
-        if (node.currentStop == endStop) {
-            journeys.emplace_back(node.pathTrips, node.transferPoints,
-                                 departureTime, node.currentTime);
-            continue;
-        }
-
-        // Если превысили лимит пересадок
-        if (node.transfers >= maxTransfers) {
-            continue;
-        }
-
-        // Ищем все рейсы, проходящие через текущую остановку
-        auto trips = system->getTripsThroughStop(node.currentStop);
-
-        for (const auto& trip : trips) {
-            Time arrivalAtStop = trip->getArrivalTime(node.currentStop);
-
-            // Пропускаем, если рейс уже ушел
-            if (arrivalAtStop < node.currentTime) {
-                continue;
-            }
-
-            // Пропускаем, если этот рейс уже в пути
-            if (!node.pathTrips.empty() && node.pathTrips.back() == trip) {
-                continue;
-            }
-
-            // Получаем все остановки после текущей
-            const auto& routeStops = trip->getRoute()->getAllStops();
-            int currentPos = trip->getRoute()->getStopPosition(node.currentStop);
-
-            if (currentPos == -1) continue;
-
-            // Проверяем все возможные точки выхода
-            for (int i = currentPos + 1; i < routeStops.size(); ++i) {
-                std::string nextStop = routeStops[i];
-                Time arrivalAtNext = trip->getArrivalTime(nextStop);
-
-                // Создаем новый узел
-                SearchNode nextNode = node;
-                nextNode.currentStop = nextStop;
-                nextNode.currentTime = arrivalAtNext;
-                nextNode.pathTrips.push_back(trip);
-
-                // Если это пересадка (не первый рейс в пути)
-                if (!node.pathTrips.empty()) {
-                    nextNode.transferPoints.push_back(node.currentStop);
-                    nextNode.transfers++;
-                }
-
-                q.push(nextNode);
-            }
-        }
-    }
-
-    // Сортируем по времени в пути
-    std::sort(journeys.begin(), journeys.end(),
-              [](const Journey& a, const Journey& b) {
-                  return a.getTotalDuration() < b.getTotalDuration();
-              });
-
-    return journeys;
-}
-
-Journey JourneyPlanner::findFastestJourney(const std::string& startStop,
-                                          const std::string& endStop,
-                                          const Time& departureTime) {
-    auto journeys = findJourneysWithTransfers(startStop, endStop, departureTime, 2);
-
-    if (journeys.empty()) {
-        throw TransportException("Маршрут не найден");
-    }
-
-    // Первый в списке самый быстрый (после сортировки)
-    return journeys[0];
-}
-
-Journey JourneyPlanner::findJourneyWithLeastTransfers(const std::string& startStop,
-                                                     const std::string& endStop,
-                                                     const Time& departureTime) {
-    auto journeys = findJourneysWithTransfers(startStop, endStop, departureTime, 2);
-
-    if (journeys.empty()) {
-        throw TransportException("Маршрут не найден");
-    }
-
-    // Ищем с минимальным количеством пересадок
-    auto it = std::min_element(journeys.begin(), journeys.end(),
-                               [](const Journey& a, const Journey& b) {
-                                   return a.getTransferCount() < b.getTransferCount();
-                               });
-
-    return *it;
-}
+#include "TransportCore.h"
 
 // Функции для пользовательского интерфейса
 void displayGuestMenu() {
@@ -1261,7 +11,9 @@ void displayGuestMenu() {
     std::cout << "4. Поиск маршрута с пересадками\n";
     std::cout << "5. Показать все рейсы\n";
     std::cout << "6. Сохранить данные\n";
-    std::cout << "7. Выход\n";
+    std::cout << "7. Поиск остановки по названию\n";
+    std::cout << "8. Ближайшие остановки\n";
+    std::cout << "9. Выход\n";
     std::cout << "Выберите опцию: ";
 }
 
@@ -1282,7 +34,20 @@ void displayAdminMenu() {
     std::cout << "12. Удалить рейс\n";
     std::cout << "13. Просмотр всех данных\n";
     std::cout << "14. Сохранить данные\n";
-    std::cout << "15. Выход\n";
+    std::cout << "15. Отчет об использовании памяти\n";
+    std::cout << "16. Проверить графики водителей\n";
+    std::cout << "17. Проверить занятость транспорта\n";
+    std::cout << "18. Автоматическое распределение водителей\n";
+    std::cout << "19. Расчет минимального парка и выпусков\n";
+    std::cout << "20. Сообщить о задержке рейса\n";
+    std::cout << "21. Поток событий реального времени\n";
+    std::cout << "22. Добавить шаблон интервального движения\n";
+    std::cout << "23. Календари обслуживания\n";
+    std::cout << "24. Импорт ленты GTFS\n";
+    std::cout << "25. Экспорт в GTFS\n";
+    std::cout << "26. Загрузка рейсов по требованию\n";
+    std::cout << "27. Перезагрузка измененных файлов данных\n";
+    std::cout << "28. Выход\n";
     std::cout << "Выберите опцию: ";
 }
 
@@ -1303,6 +68,111 @@ void displayAllStopsForSelection(const TransportSystem& system) {
     std::cout << "=================================\n";
 }
 
+// Просмотр всех данных
+void displayAllRoutes(const TransportSystem& system) {
+    std::cout << "\n=== ВСЕ МАРШРУТЫ ===\n";
+    for (const auto& route : system.getRoutes()) {
+        std::cout << "Маршрут " << route->getNumber() << " (" << route->getVehicleType()
+                  << "): " << route->getStartStop() << " -> " << route->getEndStop() << "\n";
+    }
+}
+
+void displayAllTrips(TransportSystem& system) {
+    system.loadAllTrips();
+    std::cout << "\n=== ВСЕ РЕЙСЫ ===\n";
+    for (const auto& trip : system.getTrips()) {
+        std::cout << "Рейс " << trip->getTripId() << ": Маршрут " << trip->getRoute()->getNumber()
+                  << ", ТС: " << trip->getVehicle()->getInfo()
+                  << ", Водитель: " << trip->getDriver()->getFullName()
+                  << ", Отправление: " << trip->getStartTime() << "\n";
+    }
+}
+
+void displayAllTemplates(const TransportSystem& system) {
+    std::cout << "\n=== ШАБЛОНЫ ИНТЕРВАЛЬНОГО ДВИЖЕНИЯ ===\n";
+    for (const auto& pattern : system.getTripTemplates()) {
+        std::cout << "Шаблон " << pattern->getTemplateId() << ": Маршрут " << pattern->getRoute()->getNumber()
+                  << ", с " << pattern->getFirstDeparture() << " по " << pattern->getLastDeparture()
+                  << " каждые " << pattern->getHeadway() << " мин (" << pattern->getDepartureCount()
+                  << " отправлений), ТС: " << pattern->getVehicles().size()
+                  << ", водителей: " << pattern->getDrivers().size() << "\n";
+    }
+}
+
+void displayAllCalendars(const TransportSystem& system) {
+    std::cout << "\n=== КАЛЕНДАРИ ОБСЛУЖИВАНИЯ ===\n";
+    for (const auto& [id, calendar] : system.getCalendars()) {
+        std::cout << "Календарь " << id << " (" << calendar.getName() << "): дни недели "
+                  << calendar.formatWeekdayMask() << ", с " << ServiceCalendar::formatDate(calendar.getStartDate())
+                  << " по " << ServiceCalendar::formatDate(calendar.getEndDate())
+                  << ", исключений: " << calendar.getExceptionCount() << "\n";
+    }
+}
+
+void displayAllVehicles(const TransportSystem& system) {
+    std::cout << "\n=== ВСЕ ТРАНСПОРТНЫЕ СРЕДСТВА ===\n";
+    for (const auto& vehicle : system.getVehicles()) {
+        std::cout << vehicle->getInfo() << '\n';
+    }
+}
+
+void displayAllStops(const TransportSystem& system) {
+    std::cout << "\n=== ВСЕ ОСТАНОВКИ ===\n";
+    for (const auto& stop : system.getStops()) {
+        std::cout << "ID: " << stop.getId() << " - " << stop.getName() << '\n';
+    }
+}
+
+void displayStopTimetable(const StopTimetable& timetable) {
+    std::cout << "\nРасписание для остановки '" << timetable.stopName << "' с "
+              << timetable.from << " по " << timetable.to;
+    if (timetable.date) {
+        std::cout << " на " << ServiceCalendar::formatDate(*timetable.date);
+    }
+    std::cout << ":\n";
+    if (timetable.rows.empty()) {
+        std::cout << "Рейсов не найдено.\n";
+    } else {
+        for (const auto& row : timetable.rows) {
+            std::cout << "Маршрут " << row.routeNumber << " - прибытие в " << row.arrival << '\n';
+        }
+    }
+}
+
+void displayJourney(const Journey& journey) {
+    std::cout << "\nМаршрут поездки:\n";
+    std::cout << "Общее время: " << journey.getTotalDuration() << " минут\n";
+    std::cout << "Пересадок: " << journey.getTransferCount() << "\n";
+    std::cout << "Время отправления: " << journey.getStartTime() << "\n";
+    std::cout << "Время прибытия: " << journey.getEndTime() << "\n";
+
+    const auto& trips = journey.getTrips();
+    const auto& walkingLegs = journey.getWalkingLegs();
+    auto displayWalks = [&walkingLegs](std::size_t beforeTrip) {
+        for (const auto& walk : walkingLegs) {
+            if (walk.beforeTrip == beforeTrip) {
+                std::cout << "  Пешком: " << walk.from << " -> " << walk.to
+                          << " (" << walk.minutes << " мин)\n";
+            }
+        }
+    };
+
+    for (size_t i = 0; i < trips.size(); ++i) {
+        std::cout << "\nЭтап " << (i + 1) << ":\n";
+        displayWalks(i);
+        std::cout << "  Маршрут: " << trips[i]->getRoute()->getNumber() << "\n";
+        std::cout << "  Транспорт: " << trips[i]->getVehicle()->getInfo() << "\n";
+
+        if (i > 0) {
+            std::cout << "  Пересадка на: " << journey.getTransferPoints()[i - 1] << "\n";
+        }
+    }
+    if (!walkingLegs.empty() && walkingLegs.back().beforeTrip == trips.size()) {
+        std::cout << "\nЗавершение:\n";
+        displayWalks(trips.size());
+    }
+}
+
 // Функции для административных операций
 void adminAddRoute(TransportSystem& system) {
     try {
@@ -1326,7 +196,7 @@ void adminAddRoute(TransportSystem& system) {
             stops.push_back(stop);
         }
 
-        auto route = std::make_shared<Route>(number, vehicleType, stops);
+        auto route = makePooled<Route>(number, vehicleType, stops);
         system.addRoute(route);
         std::cout << "Маршрут успешно добавлен!\n";
 
@@ -1339,12 +209,12 @@ void adminAddTrip(TransportSystem& system) {
     try {
         // Покажем доступные маршруты
         std::cout << "\n=== ДОСТУПНЫЕ МАРШРУТЫ ===\n";
-        system.displayAllRoutes();
+        displayAllRoutes(system);
         std::cout << "==========================\n\n";
 
         // Покажем доступный транспорт
         std::cout << "=== ДОСТУПНЫЙ ТРАНСПОРТ ===\n";
-        system.displayAllVehicles();
+        displayAllVehicles(system);
         std::cout << "===========================\n\n";
 
         // Покажем доступных водителей
@@ -1395,7 +265,7 @@ void adminAddTrip(TransportSystem& system) {
         std::getline(std::cin, startTimeStr);
 
         Time startTime(startTimeStr);
-        auto trip = std::make_shared<Trip>(tripId, route, vehicle, driver, startTime);
+        auto trip = makePooled<Trip>(tripId, route, vehicle, driver, startTime);
         system.addTrip(trip);
         std::cout << "Рейс успешно добавлен!\n";
 
@@ -1404,6 +274,93 @@ void adminAddTrip(TransportSystem& system) {
     }
 }
 
+void adminAddTripTemplate(TransportSystem& system) {
+    try {
+        std::cout << "\n=== ДОСТУПНЫЕ МАРШРУТЫ ===\n";
+        displayAllRoutes(system);
+        std::cout << "==========================\n\n";
+
+        std::cout << "=== ДОСТУПНЫЙ ТРАНСПОРТ ===\n";
+        displayAllVehicles(system);
+        std::cout << "===========================\n\n";
+
+        std::cout << "=== ДОСТУПНЫЕ ВОДИТЕЛИ ===\n";
+        const auto& drivers = system.getDrivers();
+        for (size_t i = 0; i < drivers.size(); ++i) {
+            std::cout << (i+1) << ". " << drivers[i]->getFullName() << '\n';
+        }
+        std::cout << "==========================\n\n";
+
+        int templateId, routeNumber, headway;
+        double averageSpeed;
+        std::string firstStr, lastStr, platesStr, driversStr;
+
+        std::cout << "Введите ID шаблона: ";
+        std::cin >> templateId;
+        std::cout << "Введите номер маршрута: ";
+        std::cin >> routeNumber;
+        std::cin.ignore();
+
+        auto route = system.findRouteByNumber(routeNumber);
+        if (!route) {
+            throw TransportException("Маршрут не найден!");
+        }
+
+        std::cout << "Введите время первого отправления (HH:MM): ";
+        std::getline(std::cin, firstStr);
+        std::cout << "Введите время последнего отправления (HH:MM): ";
+        std::getline(std::cin, lastStr);
+        std::cout << "Введите интервал движения (мин): ";
+        std::cin >> headway;
+        std::cout << "Введите среднюю скорость (км/ч): ";
+        std::cin >> averageSpeed;
+        std::cin.ignore();
+
+        std::cout << "Введите номерные знаки транспорта через запятую: ";
+        std::getline(std::cin, platesStr);
+        std::vector<std::shared_ptr<Vehicle>> vehiclePool;
+        std::istringstream platesStream(platesStr);
+        std::string plate;
+        while (std::getline(platesStream, plate, ',')) {
+            plate.erase(0, plate.find_first_not_of(' '));
+            plate.erase(plate.find_last_not_of(' ') + 1);
+            if (plate.empty()) continue;
+            auto vehicle = system.findVehicleByLicensePlate(plate);
+            if (!vehicle) {
+                throw TransportException("Транспортное средство " + plate + " не найдено!");
+            }
+            vehiclePool.push_back(vehicle);
+        }
+
+        std::cout << "Введите номера водителей из списка через пробел: ";
+        std::getline(std::cin, driversStr);
+        std::vector<std::shared_ptr<Driver>> driverPool;
+        std::istringstream driversStream(driversStr);
+        std::size_t index;
+        while (driversStream >> index) {
+            if (index == 0 || index > drivers.size()) {
+                throw TransportException("Неверный номер водителя: " + std::to_string(index));
+            }
+            driverPool.push_back(drivers[index - 1]);
+        }
+
+        int calendarId;
+        std::cout << "Введите ID календаря обслуживания (0 - ежедневно): ";
+        std::cin >> calendarId;
+        std::cin.ignore();
+
+        auto pattern = makePooled<TripTemplate>(templateId, route, Time(firstStr), Time(lastStr), headway,
+                                                TripTemplate::makeOffsets(*route, averageSpeed),
+                                                std::move(vehiclePool), std::move(driverPool));
+        pattern->setCalendarId(calendarId);
+        system.addTripTemplate(pattern);
+        std::cout << "Шаблон добавлен: " << pattern->getDepartureCount() << " отправлений\n";
+
+    } catch (const std::exception& e) {
+        std::cout << "Ошибка: " << e.what() << '\n';
+    }
+}
+
 void adminAddVehicle(TransportSystem& system) {
     try {
         std::string type, model, licensePlate;
@@ -1419,11 +376,11 @@ void adminAddVehicle(TransportSystem& system) {
 
         std::shared_ptr<Vehicle> vehicle;
         if (type == "Автобус") {
-            vehicle = std::make_shared<Bus>(model, licensePlate);
+            vehicle = makePooled<Bus>(model, licensePlate);
         } else if (type == "Трамвай") {
-            vehicle = std::make_shared<Tram>(model, licensePlate);
+            vehicle = makePooled<Tram>(model, licensePlate);
         } else if (type == "Троллейбус") {
-            vehicle = std::make_shared<Trolleybus>(model, licensePlate);
+            vehicle = makePooled<Trolleybus>(model, licensePlate);
         }
 
         system.addVehicle(vehicle);
@@ -1446,7 +403,20 @@ void adminAddStop(TransportSystem& system) {
         std::cout << "Введите название остановки: ";
         std::getline(std::cin, name);
 
-        system.addStop(Stop(id, name));
+        std::string coordinates;
+        std::cout << "Введите широту и долготу через пробел (Enter - без координат): ";
+        std::getline(std::cin, coordinates);
+
+        Stop stop(id, name);
+        if (!coordinates.empty()) {
+            std::istringstream ss(coordinates);
+            double latitude, longitude;
+            if (!(ss >> latitude >> longitude)) {
+                throw TransportException("Неверный формат координат");
+            }
+            stop.setCoordinates(latitude, longitude);
+        }
+        system.addStop(stop);
         std::cout << "Остановка успешно добавлена!\n";
 
     } catch (const std::exception& e) {
@@ -1465,7 +435,7 @@ void adminAddDriver(TransportSystem& system) {
         std::cout << "Введите отчество водителя (если есть, иначе Enter): ";
         std::getline(std::cin, middleName);
 
-        auto driver = std::make_shared<Driver>(firstName, lastName, middleName);
+        auto driver = makePooled<Driver>(firstName, lastName, middleName);
         system.addDriver(driver);
         std::cout << "Водитель успешно добавлен!\n";
 
@@ -1476,38 +446,38 @@ void adminAddDriver(TransportSystem& system) {
 
 // Инициализация тестовых данных
 void initializeTestData(TransportSystem& system) {
-    system.addStop(Stop(1, "Центральный вокзал"));
-    system.addStop(Stop(2, "Площадь Ленина"));
-    system.addStop(Stop(3, "Улица Гагарина"));
-    system.addStop(Stop(4, "Парк Победы"));
-    system.addStop(Stop(5, "Стадион"));
-    system.addStop(Stop(6, "Больница"));
-    system.addStop(Stop(7, "Университет"));
-
-    auto bus1 = std::make_shared<Bus>("МАЗ-203", "АН 8669-7");
-    auto bus2 = std::make_shared<Bus>("ПАЗ-3205", "ВС 1234-5");
-    auto tram1 = std::make_shared<Tram>("71-931", "ТР 5678-9");
+    system.addStop(Stop(1, "Центральный вокзал", 53.8906, 27.5506));
+    system.addStop(Stop(2, "Площадь Ленина", 53.8962, 27.5477));
+    system.addStop(Stop(3, "Улица Гагарина", 53.9021, 27.5612));
+    system.addStop(Stop(4, "Парк Победы", 53.9124, 27.5395));
+    system.addStop(Stop(5, "Стадион", 53.9088, 27.5733));
+    system.addStop(Stop(6, "Больница", 53.9185, 27.5829));
+    system.addStop(Stop(7, "Университет", 53.9271, 27.5950));
+
+    auto bus1 = makePooled<Bus>("МАЗ-203", "АН 8669-7");
+    auto bus2 = makePooled<Bus>("ПАЗ-3205", "ВС 1234-5");
+    auto tram1 = makePooled<Tram>("71-931", "ТР 5678-9");
 
     system.addVehicle(bus1);
     system.addVehicle(bus2);
     system.addVehicle(tram1);
 
-    auto driver1 = std::make_shared<Driver>("Иван", "Петров", "Сергеевич");
-    auto driver2 = std::make_shared<Driver>("Мария", "Сидорова", "Ивановна");
-    auto driver3 = std::make_shared<Driver>("Алексей", "Козлов");
+    auto driver1 = makePooled<Driver>("Иван", "Петров", "Сергеевич");
+    auto driver2 = makePooled<Driver>("Мария", "Сидорова", "Ивановна");
+    auto driver3 = makePooled<Driver>("Алексей", "Козлов");
 
     system.addDriver(driver1);
     system.addDriver(driver2);
     system.addDriver(driver3);
 
     std::vector<std::string> route1Stops = {"Центральный вокзал", "Площадь Ленина", "Улица Гагарина", "Стадион"};
-    auto route1 = std::make_shared<Route>(101, "Автобус", route1Stops);
+    auto route1 = makePooled<Route>(101, "Автобус", route1Stops);
 
     std::vector<std::string> route2Stops = {"Центральный вокзал", "Площадь Ленина", "Больница", "Университет"};
-    auto route2 = std::make_shared<Route>(202, "Автобус", route2Stops);
+    auto route2 = makePooled<Route>(202, "Автобус", route2Stops);
 
     std::vector<std::string> route3Stops = {"Парк Победы", "Улица Гагарина", "Больница", "Университет"};
-    auto route3 = std::make_shared<Route>(5, "Трамвай", route3Stops);
+    auto route3 = makePooled<Route>(5, "Трамвай", route3Stops);
 
     system.addRoute(route1);
     system.addRoute(route2);
@@ -1515,9 +485,9 @@ void initializeTestData(TransportSystem& system) {
 
     // Создаем тестовые рейсы
     try {
-        auto trip1 = std::make_shared<Trip>(1, route1, bus1, driver1, Time("08:00"));
-        auto trip2 = std::make_shared<Trip>(2, route2, bus2, driver2, Time("09:00"));
-        auto trip3 = std::make_shared<Trip>(3, route3, tram1, driver3, Time("10:00"));
+        auto trip1 = makePooled<Trip>(1, route1, bus1, driver1, Time("08:00"));
+        auto trip2 = makePooled<Trip>(2, route2, bus2, driver2, Time("09:00"));
+        auto trip3 = makePooled<Trip>(3, route3, tram1, driver3, Time("10:00"));
 
         system.addTrip(trip1);
         system.addTrip(trip2);
@@ -1546,6 +516,10 @@ void searchRoutes(TransportSystem& system) {
         std::cout << "Введите конечную остановку: ";
         std::getline(std::cin, stopB);
 
+        stopA = system.resolveStopName(stopA);
+        stopB = system.resolveStopName(stopB);
+        std::cout << "Поиск: " << stopA << " → " << stopB << '\n';
+
         auto routes = system.findRoutes(stopA, stopB);
         std::cout << "\nНайдено маршрутов: " << routes.size() << '\n';
 
@@ -1567,23 +541,83 @@ void searchRoutes(TransportSystem& system) {
     }
 }
 
+void findStopByName(const TransportSystem& system) {
+    std::string query;
+    std::cout << "Введите название или его начало: ";
+    std::getline(std::cin, query);
+
+    const auto& index = system.getStopNameIndex();
+    auto matches = index.complete(query, 10);
+    if (matches.empty()) {
+        matches = index.findSimilar(query, 10);
+        if (!matches.empty()) {
+            std::cout << "Точных совпадений нет, похожие названия:\n";
+        }
+    }
+
+    if (matches.empty()) {
+        std::cout << "Остановки не найдены.\n";
+        return;
+    }
+    for (const auto& match : matches) {
+        std::cout << "• " << match.name << " (ID: " << match.stopId << ")\n";
+    }
+}
+
+void findNearestStops(const TransportSystem& system) {
+    double latitude, longitude, radius;
+    std::cout << "Введите широту и долготу через пробел: ";
+    std::cin >> latitude >> longitude;
+    std::cout << "Радиус поиска в метрах (0 - пять ближайших): ";
+    std::cin >> radius;
+    std::cin.ignore();
+
+    auto nearest = radius > 0 ? system.findStopsWithinRadius(latitude, longitude, radius)
+                              : system.findNearestStops(latitude, longitude, 5);
+    if (nearest.empty()) {
+        std::cout << "Остановки не найдены.\n";
+        return;
+    }
+
+    const auto& names = system.getStopIdToName();
+    for (const auto& neighbor : nearest) {
+        std::cout << "• " << names.at(neighbor.stopId) << " (ID: " << neighbor.stopId << ") - "
+                  << static_cast<int>(neighbor.distanceMeters + 0.5) << " м\n";
+    }
+}
+
+// Запрос даты поездки; пустой ввод - без учета календарей
+std::optional<ServiceDate> readServiceDate() {
+    std::string dateStr;
+    std::cout << "Введите дату (ГГГГ-ММ-ДД, Enter - любой день): ";
+    std::getline(std::cin, dateStr);
+    if (dateStr.empty()) {
+        return std::nullopt;
+    }
+    return ServiceCalendar::parseDate(dateStr);
+}
+
 void viewStopTimetable(TransportSystem& system) {
     try {
         // Показываем список остановок
         displayAllStopsForSelection(system);
 
-        int stopId;
+        std::string stopInput;
         Time startTime, endTime;
 
-        std::cout << "\nВведите ID остановки: ";
-        std::cin >> stopId;
+        std::cout << "\nВведите ID или название остановки: ";
+        std::getline(std::cin, stopInput);
+        int stopId = !stopInput.empty() && stopInput.find_first_not_of("0123456789") == std::string::npos
+                         ? std::stoi(stopInput)
+                         : system.resolveStop(stopInput).stopId;
         std::cout << "Введите начальное время (HH:MM): ";
         std::cin >> startTime;
         std::cout << "Введите конечное время (HH:MM): ";
         std::cin >> endTime;
         std::cin.ignore();
+        auto date = readServiceDate();
 
-        system.getStopTimetable(stopId, startTime, endTime);
+        displayStopTimetable(system.getStopTimetable(stopId, startTime, endTime, date));
     } catch (const std::exception& e) {
         std::cout << "Ошибка: " << e.what() << '\n';
     }
@@ -1593,6 +627,7 @@ void viewStopTimetable(TransportSystem& system) {
 void calculateArrivalTime(TransportSystem& system) {
     try {
         // Покажем доступные рейсы
+        system.loadAllTrips();
         const auto& trips = system.getTrips();
         if (trips.empty()) {
             std::cout << "В системе нет рейсов.\n";
@@ -1618,18 +653,13 @@ void calculateArrivalTime(TransportSystem& system) {
         std::cin >> speed;
         std::cin.ignore();
 
-        system.calculateArrivalTimes(tripId, speed);
+        auto schedule = system.calculateArrivalTimes(tripId, speed);
+        std::cout << "Расписание для рейса " << tripId << " рассчитано.\n";
 
         // Покажем обновленное расписание
-        auto tripIt = std::find_if(trips.begin(), trips.end(),
-                                  [tripId](const auto& t) { return t->getTripId() == tripId; });
-        if (tripIt != trips.end()) {
-            auto trip = *tripIt;
-            std::cout << "\nОбновленное расписание для рейса " << tripId << ":\n";
-            const auto& schedule = trip->getSchedule();
-            for (const auto& [stop, time] : schedule) {
-                std::cout << "  " << stop << " - " << time << '\n';
-            }
+        std::cout << "\nОбновленное расписание для рейса " << tripId << ":\n";
+        for (const auto& entry : schedule) {
+            std::cout << "  " << entry.stop << " - " << entry.arrival << '\n';
         }
     } catch (const std::exception& e) {
         std::cout << "Ошибка: " << e.what() << "\n";
@@ -1646,13 +676,17 @@ void searchRoutesWithTransfers(TransportSystem& system) {
 
         std::cout << "\nОткуда: ";
         std::getline(std::cin, start);
+        start = system.resolveStopName(start);
         std::cout << "Куда: ";
         std::getline(std::cin, end);
+        end = system.resolveStopName(end);
+        std::cout << "Поиск: " << start << " → " << end << '\n';
         std::cout << "Во сколько выезжаете (HH:MM): ";
         std::cin >> departure;
         std::cin.ignore();
+        auto date = readServiceDate();
 
-        auto journeys = system.getJourneyPlanner().findJourneysWithTransfers(start, end, departure, 2);
+        auto journeys = system.getJourneyPlanner().findJourneysWithTransfers(start, end, departure, 2, date);
         if (journeys.empty()) {
             std::cout << "Маршрутов не найдено!\n";
         } else {
@@ -1660,7 +694,7 @@ void searchRoutesWithTransfers(TransportSystem& system) {
             for (size_t i = 0; i < std::min(journeys.size(), size_t(3)); i++) {
                 std::cout << "\n════════════════════════════════════════\n";
                 std::cout << "Вариант " << (i+1) << ":\n";
-                system.getJourneyPlanner().displayJourney(journeys[i]);
+                displayJourney(journeys[i]);
             }
             std::cout << "════════════════════════════════════════\n";
         }
@@ -1669,7 +703,8 @@ void searchRoutesWithTransfers(TransportSystem& system) {
     }
 }
 
-void showAllTrips(const TransportSystem& system) {
+void showAllTrips(TransportSystem& system) {
+    system.loadAllTrips();
     const auto& trips = system.getTrips();
     std::cout << "\nВсе рейсы в системе:\n";
     for (const auto& trip : trips) {
@@ -1681,12 +716,445 @@ void showAllTrips(const TransportSystem& system) {
     }
 }
 
+void validateDriverSchedules(TransportSystem& system) {
+    system.loadAllTrips();
+    const auto& schedule = system.getDriverSchedule();
+    auto violations = schedule.validateAllDrivers();
+
+    std::cout << "\n=== ПРОВЕРКА ГРАФИКОВ ВОДИТЕЛЕЙ ===\n";
+    std::cout << "Проверено водителей: " << schedule.getDriverCount() << '\n';
+    if (violations.empty()) {
+        std::cout << "Нарушений не найдено.\n";
+        return;
+    }
+
+    for (const auto& violation : violations) {
+        const Driver* driver = system.getDriverByHandle(violation.driver);
+        std::cout << (driver ? driver->getFullName() : "Неизвестный водитель") << ": ";
+        if (violation.kind == DriverViolation::Kind::Overlap) {
+            std::cout << "рейсы " << violation.firstTripId << " и " << violation.secondTripId
+                      << " пересекаются по времени\n";
+        } else {
+            std::cout << "рабочее время " << violation.minutes << " мин превышает норму "
+                      << schedule.getMaxWorkingMinutes() << " мин\n";
+        }
+    }
+    std::cout << "Всего нарушений: " << violations.size() << '\n';
+}
+
+void validateVehicleAssignments(TransportSystem& system) {
+    system.loadAllTrips();
+    auto conflicts = system.findVehicleConflicts();
+
+    std::cout << "\n=== ПРОВЕРКА ЗАНЯТОСТИ ТРАНСПОРТА ===\n";
+    std::cout << "Проверено рейсов: " << system.getTrips().size() << '\n';
+    if (conflicts.empty()) {
+        std::cout << "Двойных назначений не найдено.\n";
+        return;
+    }
+
+    for (const auto& conflict : conflicts) {
+        std::cout << conflict.licensePlate << ": рейсы " << conflict.firstTripId << " и "
+                  << conflict.secondTripId << " пересекаются (" << conflict.overlapStart
+                  << " - " << conflict.overlapEnd << ")\n";
+    }
+    std::cout << "Всего конфликтов: " << conflicts.size() << '\n';
+}
+
+// Рейсы одного дня обслуживания: смены и выпуски строятся на сутки, а рейсы
+// разных календарей в одно время суток друг другу не мешают
+std::vector<std::shared_ptr<Trip>> readServiceDayTrips(TransportSystem& system) {
+    std::string dateStr;
+    std::cout << "Введите дату (ГГГГ-ММ-ДД): ";
+    std::getline(std::cin, dateStr);
+    ServiceDate date = ServiceCalendar::parseDate(dateStr);
+
+    system.loadAllTrips();
+    std::vector<std::shared_ptr<Trip>> trips;
+    for (const auto& trip : system.getTrips()) {
+        if (system.isServiceActive(trip->getCalendarId(), date)) {
+            trips.push_back(trip);
+        }
+    }
+    return trips;
+}
+
+void adminAutoRoster(TransportSystem& system) {
+    auto trips = readServiceDayTrips(system);
+    RosteringEngine engine(system.getDriverSchedule().getMaxWorkingMinutes());
+
+    auto started = std::chrono::steady_clock::now();
+    auto roster = engine.solve(trips, system.getDrivers());
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - started);
+
+    std::cout << "\n=== АВТОМАТИЧЕСКОЕ РАСПРЕДЕЛЕНИЕ ВОДИТЕЛЕЙ ===\n";
+    std::cout << "Рейсов: " << trips.size()
+              << ", доступно водителей: " << system.getDrivers().size() << '\n';
+    std::cout << "Жадное распределение: " << roster.greedyDriversUsed << " водителей\n";
+    std::cout << "После локального поиска: " << roster.driversUsed << " водителей ("
+              << roster.localSearchRounds << " раундов, " << elapsed.count() << " мс)\n";
+    if (!roster.unassignedTrips.empty()) {
+        std::cout << "Не удалось назначить рейсы:";
+        for (int tripId : roster.unassignedTrips) {
+            std::cout << ' ' << tripId;
+        }
+        std::cout << '\n';
+    }
+
+    std::string answer;
+    std::cout << "Применить распределение? (да/нет): ";
+    std::getline(std::cin, answer);
+    if (answer == "да") {
+        system.applyRoster(roster);
+        std::cout << "Распределение применено.\n";
+    }
+}
+
+void showVehicleBlocks(TransportSystem& system) {
+    int layover;
+    std::cout << "Минимальный отстой на конечной (мин): ";
+    std::cin >> layover;
+    std::cin.ignore();
+    auto trips = readServiceDayTrips(system);
+
+    auto result = VehicleBlockingOptimizer(layover).optimize(trips);
+
+    std::cout << "\n=== МИНИМАЛЬНЫЙ ПАРК ===\n";
+    std::cout << "Рейсов: " << trips.size()
+              << ", требуется транспорта: " << result.fleetSize << '\n';
+    for (const auto& [type, count] : result.fleetByType) {
+        std::cout << "  " << type << ": " << count << '\n';
+    }
+
+    std::cout << "\n=== ВЫПУСКИ ===\n";
+    for (size_t i = 0; i < result.blocks.size(); ++i) {
+        const auto& block = result.blocks[i];
+        std::cout << "Выпуск " << (i + 1) << " (" << block.vehicleType << ", "
+                  << block.startTime << " - " << block.endTime << "): рейсы";
+        for (int tripId : block.tripIds) {
+            std::cout << ' ' << tripId;
+        }
+        std::cout << '\n';
+    }
+}
+
+void adminReportDelay(TransportSystem& system) {
+    try {
+        int tripId, delay, slack;
+        std::string stopName;
+
+        std::cout << "Введите ID рейса: ";
+        std::cin >> tripId;
+        std::cin.ignore();
+        std::cout << "Введите остановку, на которой зафиксирована задержка: ";
+        std::getline(std::cin, stopName);
+        std::cout << "Введите задержку (мин, отрицательная - опережение): ";
+        std::cin >> delay;
+        std::cout << "Сколько минут можно сократить на каждой стоянке (0 - не сокращать): ";
+        std::cin >> slack;
+        std::cin.ignore();
+
+        int affected = system.reportDelay(tripId, stopName, delay, slack);
+        std::cout << "Расписание рейса " << tripId << " обновлено, затронуто остановок: "
+                  << affected << '\n';
+    } catch (const std::exception& e) {
+        std::cout << "Ошибка: " << e.what() << '\n';
+    }
+}
+
+void adminLiveEvents(TransportSystem& system) {
+    try {
+        int action;
+        std::cout << "1. Запустить прием событий\n";
+        std::cout << "2. Состояние приема\n";
+        std::cout << "3. Остановить прием\n";
+        std::cout << "Выберите действие: ";
+        std::cin >> action;
+        std::cin.ignore();
+
+        if (action == 1) {
+            std::string path;
+            std::cout << "Введите путь к файлу или каналу событий: ";
+            std::getline(std::cin, path);
+            system.startLiveIngestion(path);
+            std::cout << "Прием событий запущен\n";
+        } else if (action == 2) {
+            system.applyLiveUpdates();
+            const LiveEventIngestor* ingestor = system.getLiveIngestor();
+            if (!ingestor) {
+                std::cout << "Прием событий не запущен\n";
+                return;
+            }
+            LiveEventIngestor::Stats stats = ingestor->getStats();
+            std::cout << "Состояние: " << (stats.running ? "идет прием" : "источник исчерпан") << '\n';
+            std::cout << "Прочитано событий: " << stats.produced << '\n';
+            std::cout << "Обработано: " << stats.consumed << '\n';
+            std::cout << "Применено к рейсам: " << stats.applied << '\n';
+            std::cout << "Не сопоставлено: " << stats.unresolved << '\n';
+            std::cout << "Некорректных строк: " << stats.malformed << '\n';
+            std::cout << "В очереди: " << stats.backlog << '\n';
+            std::cout << "Отставание последнего события: " << stats.lagSeconds << " с\n";
+        } else if (action == 3) {
+            system.stopLiveIngestion();
+            std::cout << "Прием событий остановлен\n";
+        } else {
+            std::cout << "Неверный выбор.\n";
+        }
+    } catch (const std::exception& e) {
+        std::cout << "Ошибка: " << e.what() << '\n';
+    }
+}
+
+void adminServiceCalendars(TransportSystem& system) {
+    try {
+        int action;
+        std::cout << "1. Добавить календарь\n";
+        std::cout << "2. Добавить исключение (дополнительный или отмененный день)\n";
+        std::cout << "3. Назначить календарь рейсу\n";
+        std::cout << "4. Показать календари\n";
+        std::cout << "Выберите действие: ";
+        std::cin >> action;
+        std::cin.ignore();
+
+        if (action == 1) {
+            int calendarId;
+            std::string name, mask, startStr, endStr;
+            std::cout << "Введите ID календаря: ";
+            std::cin >> calendarId;
+            std::cin.ignore();
+            std::cout << "Введите название: ";
+            std::getline(std::cin, name);
+            std::cout << "Введите дни недели (7 символов 0/1 с понедельника, например 1111100): ";
+            std::getline(std::cin, mask);
+            std::cout << "Введите дату начала (ГГГГ-ММ-ДД): ";
+            std::getline(std::cin, startStr);
+            std::cout << "Введите дату окончания (ГГГГ-ММ-ДД): ";
+            std::getline(std::cin, endStr);
+
+            system.addServiceCalendar(ServiceCalendar(calendarId, name, ServiceCalendar::parseWeekdayMask(mask),
+                                                      ServiceCalendar::parseDate(startStr),
+                                                      ServiceCalendar::parseDate(endStr)));
+            std::cout << "Календарь добавлен!\n";
+        } else if (action == 2) {
+            int calendarId;
+            std::string dateStr, answer;
+            std::cout << "Введите ID календаря: ";
+            std::cin >> calendarId;
+            std::cin.ignore();
+            std::cout << "Введите дату (ГГГГ-ММ-ДД): ";
+            std::getline(std::cin, dateStr);
+            std::cout << "Рейсы в этот день выполняются? (да/нет): ";
+            std::getline(std::cin, answer);
+
+            system.addCalendarException(calendarId, ServiceCalendar::parseDate(dateStr), answer == "да");
+            std::cout << "Исключение добавлено!\n";
+        } else if (action == 3) {
+            int tripId, calendarId;
+            std::cout << "Введите ID рейса: ";
+            std::cin >> tripId;
+            std::cout << "Введите ID календаря (0 - ежедневно): ";
+            std::cin >> calendarId;
+            std::cin.ignore();
+
+            system.setTripCalendar(tripId, calendarId);
+            std::cout << "Календарь назначен!\n";
+        } else if (action == 4) {
+            displayAllCalendars(system);
+        } else {
+            std::cout << "Неверный выбор.\n";
+        }
+    } catch (const std::exception& e) {
+        std::cout << "Ошибка: " << e.what() << '\n';
+    }
+}
+
+void adminImportGtfs(TransportSystem& system) {
+    try {
+        std::string directory;
+        std::cout << "Введите каталог ленты GTFS: ";
+        std::getline(std::cin, directory);
+
+        system.loadAllTrips();
+        auto started = std::chrono::steady_clock::now();
+        GtfsImportStats stats = GtfsImporter(system, directory).run();
+        auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - started);
+
+        for (const auto& error : stats.errors) {
+            std::cout << "Ошибка импорта " << error << "\n";
+        }
+        std::cout << "Импорт завершен за " << elapsed.count() << " мс:\n";
+        std::cout << "  Остановок: " << stats.stops << "\n";
+        std::cout << "  Маршрутов (трасс): " << stats.routes << "\n";
+        std::cout << "  Рейсов: " << stats.trips << "\n";
+        std::cout << "  Записей расписания: " << stats.stopTimes << "\n";
+        std::cout << "  Календарей: " << stats.calendars << "\n";
+        if (stats.skipped > 0) {
+            std::cout << "  Пропущено из-за ошибок: " << stats.skipped << "\n";
+        }
+    } catch (const std::exception& e) {
+        std::cout << "Ошибка: " << e.what() << '\n';
+    }
+}
+
+void adminExportGtfs(TransportSystem& system) {
+    try {
+        std::string directory;
+        std::cout << "Введите каталог для ленты GTFS: ";
+        std::getline(std::cin, directory);
+
+        GtfsAgency agency;
+        std::string timezone;
+        std::cout << "Введите часовой пояс перевозчика (Enter - " << agency.timezone << "): ";
+        std::getline(std::cin, timezone);
+        if (!timezone.empty()) agency.timezone = timezone;
+
+        system.loadAllTrips();
+        auto started = std::chrono::steady_clock::now();
+        GtfsExportStats stats = GtfsExporter(system, directory, agency).run();
+        auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - started);
+
+        std::cout << "Экспорт завершен за " << elapsed.count() << " мс:\n";
+        std::cout << "  Остановок: " << stats.stops << "\n";
+        std::cout << "  Маршрутов: " << stats.routes << "\n";
+        std::cout << "  Рейсов: " << stats.trips << "\n";
+        std::cout << "  Записей расписания: " << stats.stopTimes << "\n";
+        std::cout << "  Календарей: " << stats.calendars << "\n";
+        if (stats.stopsSkipped > 0) {
+            std::cout << "  Пропущено остановок без координат: " << stats.stopsSkipped << "\n";
+        }
+        if (stats.tripsSkipped > 0) {
+            std::cout << "  Пропущено рейсов (меньше двух остановок с координатами): " << stats.tripsSkipped << "\n";
+        }
+    } catch (const std::exception& e) {
+        std::cout << "Ошибка: " << e.what() << '\n';
+    }
+}
+
+void adminTripLoading(TransportSystem& system) {
+    try {
+        TripLoadingOptions options = system.getTripLoadingOptions();
+        std::cout << "Режим: " << (options.onDemand ? "рейсы загружаются по требованию" : "все рейсы загружаются при запуске")
+                  << ", лимит памяти: " << options.memoryLimit / (1024 * 1024) << " МБ\n";
+        if (const LazyTripStore* lazyTrips = system.getLazyTrips()) {
+            std::cout << "Загружено маршрутов: " << lazyTrips->getLoadedRouteCount() << " из "
+                      << lazyTrips->getRouteCount() << ", вытесняемые рейсы занимают около "
+                      << lazyTrips->getLoadedBytes() / 1024 << " КБ\n";
+        }
+
+        int onDemand = 0, limitMegabytes = 0;
+        std::cout << "Загружать рейсы по требованию? (1 - да, 0 - нет): ";
+        std::cin >> onDemand;
+        std::cout << "Лимит памяти загруженных рейсов (МБ): ";
+        std::cin >> limitMegabytes;
+        std::cin.ignore();
+        if (limitMegabytes <= 0) {
+            throw TransportException("Лимит памяти должен быть положительным");
+        }
+
+        options.onDemand = onDemand == 1;
+        options.memoryLimit = static_cast<std::size_t>(limitMegabytes) * 1024 * 1024;
+        system.setTripLoadingOptions(options);
+        std::cout << "Настройки сохранены. Режим загрузки вступит в силу после сохранения данных и перезапуска.\n";
+    } catch (const std::exception& e) {
+        std::cout << "Ошибка: " << e.what() << '\n';
+    }
+}
+
+void printDataReload(TransportSystem& system, const DataReloadStats& stats) {
+    std::cout << stats.messages;
+    if (stats.files.empty()) {
+        std::cout << "Файлы данных не изменялись.\n";
+        return;
+    }
+
+    std::cout << "Изменены файлы:";
+    for (const auto& file : stats.files) {
+        std::cout << " " << file;
+    }
+    std::cout << "\n";
+    if (!stats.succeeded) {
+        std::cout << "Перезагрузка не выполнена, используются прежние данные.\n";
+        return;
+    }
+    if (stats.fullReload) {
+        std::cout << "Данные собраны заново за " << stats.elapsed.count() << " мс: маршрутов "
+                  << system.getRoutes().size() << ", рейсов " << system.getTrips().size() << "\n";
+    } else {
+        std::cout << "Рейсы перечитаны за " << stats.elapsed.count() << " мс: без изменений " << stats.tripsKept
+                  << ", удалено " << stats.tripsRemoved << ", добавлено " << stats.tripsAdded << "\n";
+    }
+    if (stats.liveIngestionStopped) {
+        std::cout << "Прием событий реального времени остановлен, запустите его заново.\n";
+    }
+}
+
+// Изменения, найденные наблюдением за файлами, применяются перед очередной командой
+void pollDataReload(TransportSystem& system) {
+    try {
+        if (auto stats = system.applyDataReload()) {
+            printDataReload(system, *stats);
+        }
+    } catch (const std::exception& e) {
+        std::cout << "Ошибка перезагрузки данных: " << e.what() << '\n';
+    }
+}
+
+void adminDataReload(TransportSystem& system) {
+    try {
+        std::cout << "Наблюдение за файлами: " << (system.isDataWatchActive() ? "включено" : "выключено");
+        if (system.isReloadPending()) {
+            std::cout << ", идет фоновая сборка данных";
+        }
+        std::cout << "\n";
+        auto changed = system.getChangedDataFiles();
+        std::cout << "Изменены после загрузки или сохранения:";
+        for (const auto& file : changed) {
+            std::cout << " " << file;
+        }
+        std::cout << (changed.empty() ? " нет\n" : "\n");
+
+        int action;
+        std::cout << "1. Перечитать измененные файлы\n";
+        std::cout << "2. Включить наблюдение за файлами\n";
+        std::cout << "3. Выключить наблюдение\n";
+        std::cout << "Выберите действие: ";
+        std::cin >> action;
+        std::cin.ignore();
+
+        if (action == 1) {
+            printDataReload(system, system.reloadChangedData());
+        } else if (action == 2) {
+            int seconds;
+            std::cout << "Интервал проверки (с): ";
+            std::cin >> seconds;
+            std::cin.ignore();
+            if (seconds <= 0) {
+                throw TransportException("Интервал должен быть положительным");
+            }
+            system.startDataWatch(std::chrono::seconds(seconds));
+            std::cout << "Наблюдение включено: изменения применяются перед очередной командой\n";
+        } else if (action == 3) {
+            system.stopDataWatch();
+            std::cout << "Наблюдение выключено\n";
+        } else {
+            std::cout << "Неверный выбор.\n";
+        }
+    } catch (const std::exception& e) {
+        std::cout << "Ошибка: " << e.what() << '\n';
+    }
+}
+
 // Основные функции режимов работы
 void runGuestMode(TransportSystem& system) {
     int choice;
     bool running = true;
 
     while (running) {
+        system.applyLiveUpdates();
+        pollDataReload(system);
         displayGuestMenu();
         std::cin >> choice;
         std::cin.ignore();
@@ -1699,7 +1167,9 @@ void runGuestMode(TransportSystem& system) {
                 case 4: searchRoutesWithTransfers(system); break;
                 case 5: showAllTrips(system); break;
                 case 6: system.saveData(); break;
-                case 7: running = false; break;
+                case 7: findStopByName(system); break;
+                case 8: findNearestStops(system); break;
+                case 9: running = false; break;
                 default: std::cout << "Неверный выбор.\n";
             }
         } catch (const std::exception& e) {
@@ -1727,6 +1197,8 @@ void runAdminMode(TransportSystem& system) {
     bool running = true;
 
     while (running) {
+        system.applyLiveUpdates();
+        pollDataReload(system);
         displayAdminMenu();
         std::cin >> choice;
         std::cin.ignore();
@@ -1748,7 +1220,12 @@ void runAdminMode(TransportSystem& system) {
                     std::cout << "Введите номер маршрута для удаления: ";
                     std::cin >> routeNumber;
                     std::cin.ignore();
-                    system.removeRoute(routeNumber);
+                    std::size_t removedTrips = system.removeRoute(routeNumber);
+                    std::cout << "Маршрут " << routeNumber << " удален";
+                    if (removedTrips > 0) {
+                        std::cout << " вместе с рейсами (" << removedTrips << ")";
+                    }
+                    std::cout << ".\n";
                     break;
                 }
                 case 12: {
@@ -1757,17 +1234,33 @@ void runAdminMode(TransportSystem& system) {
                     std::cin >> tripId;
                     std::cin.ignore();
                     system.removeTrip(tripId);
+                    std::cout << "Рейс " << tripId << " удален.\n";
                     break;
                 }
                 case 13: {
-                    system.displayAllRoutes();
-                    system.displayAllTrips();
-                    system.displayAllVehicles();
-                    system.displayAllStops();
+                    displayAllRoutes(system);
+                    displayAllTrips(system);
+                    displayAllTemplates(system);
+                    displayAllCalendars(system);
+                    displayAllVehicles(system);
+                    displayAllStops(system);
                     break;
                 }
                 case 14: system.saveData(); break;
-                case 15: running = false; break;
+                case 15: MemoryProfiler::printReport(system, std::cout); break;
+                case 16: validateDriverSchedules(system); break;
+                case 17: validateVehicleAssignments(system); break;
+                case 18: adminAutoRoster(system); break;
+                case 19: showVehicleBlocks(system); break;
+                case 20: adminReportDelay(system); break;
+                case 21: adminLiveEvents(system); break;
+                case 22: adminAddTripTemplate(system); break;
+                case 23: adminServiceCalendars(system); break;
+                case 24: adminImportGtfs(system); break;
+                case 25: adminExportGtfs(system); break;
+                case 26: adminTripLoading(system); break;
+                case 27: adminDataReload(system); break;
+                case 28: running = false; break;
                 default: std::cout << "Неверный выбор.\n";
             }
         } catch (const std::exception& e) {
@@ -1782,6 +1275,7 @@ int main() {
 
     try {
         TransportSystem system;
+        system.setDataOutput(std::cout);
 
         // Пытаемся загрузить данные из файлов
         system.loadData();